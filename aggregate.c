@@ -0,0 +1,227 @@
+/**
+ * @file aggregate.c
+ * @brief 按时间窗口合并重复的DNS事件
+ * @note 以(UID, 进程名, 域名, 排序后的IP列表)为键，窗口内重复的事件只计数，
+ *       窗口结束时输出第一次出现的事件和真实的重复次数
+ * @version 0.1
+ * @date 2025-08-22
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "aggregate.h"
+
+#define FNV64_OFFSET 14695981039346656037ULL
+#define FNV64_PRIME 1099511628211ULL
+
+// 统计在agg->mutex内更新，不加锁读取
+#define aggregate_stat_add(counter, n) __atomic_store_n(&(counter), (counter) + (n), __ATOMIC_RELAXED)
+
+static uint64 fnv64(uint64 hash, const void *data, size_t len)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash = (hash ^ p[i]) * FNV64_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * @brief 计算事件的合并键
+ *
+ * @param uid
+ * @param process_name 可以为NULL
+ * @param domain
+ * @param ips 匹配策略的IP，顺序不影响结果
+ * @param ip_count
+ * @return uint64 非0
+ */
+uint64 aggregate_key(int uid, const char *process_name, const char *domain, const uint32 *ips, int ip_count)
+{
+    uint32 sorted[ip_count > 0 ? ip_count : 1];
+    uint64 hash = FNV64_OFFSET;
+
+    hash = fnv64(hash, &uid, sizeof(uid));
+    if (process_name != NULL)
+    {
+        hash = fnv64(hash, process_name, strlen(process_name));
+    }
+    hash = fnv64(hash, "", 1);
+    hash = fnv64(hash, domain, strlen(domain) + 1);
+    // IP个数很少，插入排序
+    for (int i = 0; i < ip_count; i++)
+    {
+        int j = i;
+        while (j > 0 && sorted[j - 1] > ips[i])
+        {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = ips[i];
+    }
+    hash = fnv64(hash, sorted, ip_count * sizeof(uint32));
+    return hash != 0 ? hash : 1;
+}
+
+aggregator_t *aggregator_create(int window_ms, aggregate_emit_fn emit)
+{
+    aggregator_t *agg = (aggregator_t *)calloc(1, sizeof(aggregator_t));
+    if (agg == NULL)
+    {
+        return NULL;
+    }
+    pthread_mutex_init(&agg->mutex, NULL);
+    agg->window_ms = window_ms;
+    agg->emit = emit;
+    return agg;
+}
+
+/**
+ * @brief 输出并删除前n个表项
+ * @note 调用者持有agg->mutex
+ */
+static void aggregator_emit_prefix(aggregator_t *agg, uint32 n)
+{
+    for (uint32 i = 0; i < n; i++)
+    {
+        agg->emit(agg->events[i], agg->repeats[i]);
+        free(agg->events[i]);
+    }
+    aggregate_stat_add(agg->stats.emitted, n);
+    agg->count -= n;
+    memmove(agg->keys, agg->keys + n, agg->count * sizeof(agg->keys[0]));
+    memmove(agg->first_ms, agg->first_ms + n, agg->count * sizeof(agg->first_ms[0]));
+    memmove(agg->repeats, agg->repeats + n, agg->count * sizeof(agg->repeats[0]));
+    memmove(agg->events, agg->events + n, agg->count * sizeof(agg->events[0]));
+}
+
+/**
+ * @brief 加入一个事件
+ *
+ * @param agg
+ * @param key aggregate_key的结果
+ * @param event 事件文本，第一次出现时复制一份，重复的事件不分配内存
+ * @param len 事件长度
+ * @param now_ms 当前时间，不能早于之前的调用
+ */
+void aggregator_add(aggregator_t *agg, uint64 key, const char *event, size_t len, long long now_ms)
+{
+    char *copy;
+
+    pthread_mutex_lock(&agg->mutex);
+    for (uint32 i = 0; i < agg->count; i++)
+    {
+        if (agg->keys[i] == key && now_ms - agg->first_ms[i] < agg->window_ms)
+        {
+            if (agg->repeats[i] < AGGREGATE_MAX_COUNT)
+            {
+                agg->repeats[i]++;
+            }
+            aggregate_stat_add(agg->stats.collapsed, 1);
+            pthread_mutex_unlock(&agg->mutex);
+            return;
+        }
+    }
+    copy = (char *)malloc(len + 1);
+    if (copy == NULL)
+    {
+        // 内存不足时不合并，直接输出
+        aggregate_stat_add(agg->stats.emitted, 1);
+        pthread_mutex_unlock(&agg->mutex);
+        agg->emit(event, 1);
+        return;
+    }
+    memcpy(copy, event, len);
+    copy[len] = '\0';
+    if (agg->count == AGGREGATE_MAX_ENTRIES)
+    {
+        // 表满时提前输出最早的事件
+        aggregator_emit_prefix(agg, 1);
+        aggregate_stat_add(agg->stats.evicted, 1);
+    }
+    agg->keys[agg->count] = key;
+    agg->first_ms[agg->count] = now_ms;
+    agg->repeats[agg->count] = 1;
+    agg->events[agg->count] = copy;
+    agg->count++;
+    pthread_mutex_unlock(&agg->mutex);
+}
+
+/**
+ * @brief 输出窗口已结束的事件
+ */
+void aggregator_flush(aggregator_t *agg, long long now_ms)
+{
+    uint32 n = 0;
+    pthread_mutex_lock(&agg->mutex);
+    while (n < agg->count && now_ms - agg->first_ms[n] >= agg->window_ms)
+    {
+        n++;
+    }
+    if (n > 0)
+    {
+        aggregator_emit_prefix(agg, n);
+    }
+    pthread_mutex_unlock(&agg->mutex);
+}
+
+/**
+ * @brief 退出前输出所有事件
+ * @note 可能在信号处理中调用，拿不到锁时放弃，避免与被打断的处理线程死锁
+ * @return int 0成功
+ */
+int aggregator_flush_all(aggregator_t *agg)
+{
+    if (pthread_mutex_trylock(&agg->mutex) != 0)
+    {
+        return -1;
+    }
+    aggregator_emit_prefix(agg, agg->count);
+    pthread_mutex_unlock(&agg->mutex);
+    return 0;
+}
+
+void aggregator_destroy(aggregator_t *agg)
+{
+    if (agg == NULL)
+    {
+        return;
+    }
+    aggregator_flush_all(agg);
+    pthread_mutex_destroy(&agg->mutex);
+    free(agg);
+}
+
+/**
+ * @brief 计算处理线程最多可以等待多久，保证窗口结束的事件及时输出
+ *
+ * @param agg
+ * @param now_ms
+ * @param max_timeout_ms 没有待输出的事件时的等待时间
+ * @return int 毫秒
+ */
+int aggregator_timeout(aggregator_t *agg, long long now_ms, int max_timeout_ms)
+{
+    long long timeout = max_timeout_ms;
+    pthread_mutex_lock(&agg->mutex);
+    if (agg->count > 0)
+    {
+        long long left = agg->first_ms[0] + agg->window_ms - now_ms;
+        if (left < timeout)
+        {
+            timeout = left > 0 ? left : 0;
+        }
+    }
+    pthread_mutex_unlock(&agg->mutex);
+    return (int)timeout;
+}
+
+void aggregator_get_stats(aggregator_t *agg, aggregate_stats_t *stats)
+{
+    stats->collapsed = __atomic_load_n(&agg->stats.collapsed, __ATOMIC_RELAXED);
+    stats->emitted = __atomic_load_n(&agg->stats.emitted, __ATOMIC_RELAXED);
+    stats->evicted = __atomic_load_n(&agg->stats.evicted, __ATOMIC_RELAXED);
+}
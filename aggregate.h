@@ -0,0 +1,59 @@
+/**
+ * @file aggregate.h
+ * @brief 按时间窗口合并重复的DNS事件
+ * @version 0.1
+ * @date 2025-08-22
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <pthread.h>
+#include <stddef.h>
+#include "queue.h"
+
+#define AGGREGATE_MAX_ENTRIES 256 // 每个处理线程同时合并的最大事件数
+#define AGGREGATE_MAX_COUNT 65535 // Selog aggregation_count的上限
+
+// 输出合并后的事件，event在回调返回后释放
+typedef void (*aggregate_emit_fn)(const char *event, uint32 count);
+
+typedef struct aggregate_stats
+{
+    uint64 collapsed; // 被合并的重复事件数
+    uint64 emitted;   // 输出的记录数
+    uint64 evicted;   // 因表满提前输出的记录数
+} aggregate_stats_t;
+
+// 每个处理线程一份；表项按首次出现的时间排列，过期的总在前面
+typedef struct aggregator
+{
+    pthread_mutex_t mutex; // 只在退出时与其他线程竞争
+    int window_ms;
+    aggregate_emit_fn emit;
+    uint32 count;
+    uint64 keys[AGGREGATE_MAX_ENTRIES];
+    long long first_ms[AGGREGATE_MAX_ENTRIES];
+    uint32 repeats[AGGREGATE_MAX_ENTRIES];
+    char *events[AGGREGATE_MAX_ENTRIES];
+    aggregate_stats_t stats;
+} aggregator_t;
+
+uint64 aggregate_key(int uid, const char *process_name, const char *domain, const uint32 *ips, int ip_count);
+aggregator_t *aggregator_create(int window_ms, aggregate_emit_fn emit);
+void aggregator_destroy(aggregator_t *agg);
+void aggregator_add(aggregator_t *agg, uint64 key, const char *event, size_t len, long long now_ms);
+void aggregator_flush(aggregator_t *agg, long long now_ms);
+int aggregator_flush_all(aggregator_t *agg);
+int aggregator_timeout(aggregator_t *agg, long long now_ms, int max_timeout_ms);
+void aggregator_get_stats(aggregator_t *agg, aggregate_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,92 @@
+// benchmarks/json_event_benchmark.cpp
+//
+// Compares encoding one DNS event the old way (cJSON tree, cJSON_Print, then
+// vsnprintf into the Selog buffer) with the streaming json_writer that encodes
+// straight into the Selog buffer.
+//
+// Usage:
+// - In AOSP: `mm` in benchmarks/ and run ioemnetd_json_benchmark on the device or host.
+// - On host: g++ -O2 -I.. json_event_benchmark.cpp ../json_writer.c ../cJSON.c -lbenchmark -lpthread -o json_event_benchmark
+
+#include <benchmark/benchmark.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cJSON.h"
+#include "json_writer.h"
+
+#define LOG_BUFFER_SIZE 5000 // 与SELOG_SINGLE_LOG_SIZE相同
+#define EVENT_LOG_PREFIX "Event logged: "
+
+static const char *ips[] = {"1.2.3.4", "8.8.8.8", "114.114.114.114", "223.5.5.5",
+                            "180.101.49.11", "36.152.44.95", "39.156.66.10", "110.242.68.66"};
+
+static void format_log(char *buf, const char *format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    vsnprintf(buf, LOG_BUFFER_SIZE, format, ap);
+    va_end(ap);
+}
+
+static void BM_CjsonEvent(benchmark::State &state)
+{
+    const int ip_count = state.range(0);
+    char logbuf[LOG_BUFFER_SIZE];
+    for (auto _ : state)
+    {
+        cJSON *event = cJSON_CreateObject();
+        cJSON_AddStringToObject(event, "DnsRet", "success");
+        cJSON_AddStringToObject(event, "Domain", "www.example.com");
+        cJSON_AddNumberToObject(event, "UID", 10086);
+        cJSON_AddNumberToObject(event, "PID", 2345);
+        cJSON_AddStringToObject(event, "ProcessName", "com.example.app:remote");
+        cJSON_AddStringToObject(event, "PackageName", "com.example.app");
+        cJSON *ip_array = cJSON_CreateArray();
+        for (int i = 0; i < ip_count; i++)
+        {
+            cJSON_AddItemToArray(ip_array, cJSON_CreateString(ips[i]));
+        }
+        cJSON_AddItemToObject(event, "IPAddresses", ip_array);
+        char *event_str = cJSON_Print(event);
+        format_log(logbuf, "Event logged: %s", event_str);
+        benchmark::DoNotOptimize(logbuf);
+        free(event_str);
+        cJSON_Delete(event);
+    }
+}
+BENCHMARK(BM_CjsonEvent)->Arg(1)->Arg(3)->Arg(8);
+
+static void BM_JsonWriterEvent(benchmark::State &state)
+{
+    const int ip_count = state.range(0);
+    char logbuf[LOG_BUFFER_SIZE];
+    const size_t prefix_len = sizeof(EVENT_LOG_PREFIX) - 1;
+    for (auto _ : state)
+    {
+        json_writer_t w;
+        memcpy(logbuf, EVENT_LOG_PREFIX, prefix_len);
+        json_writer_init(&w, logbuf + prefix_len, sizeof(logbuf) - prefix_len);
+        json_begin_object(&w, NULL);
+        json_add_string(&w, "DnsRet", "success");
+        json_add_string(&w, "Domain", "www.example.com");
+        json_add_int(&w, "UID", 10086);
+        json_add_int(&w, "PID", 2345);
+        json_add_string(&w, "ProcessName", "com.example.app:remote");
+        json_add_string(&w, "PackageName", "com.example.app");
+        json_begin_array(&w, "IPAddresses");
+        for (int i = 0; i < ip_count; i++)
+        {
+            json_add_string(&w, NULL, ips[i]);
+        }
+        json_end_array(&w);
+        json_end_object(&w);
+        benchmark::DoNotOptimize(json_writer_finish(&w));
+        benchmark::DoNotOptimize(logbuf);
+    }
+}
+BENCHMARK(BM_JsonWriterEvent)->Arg(1)->Arg(3)->Arg(8);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,347 @@
+// benchmarks/pipeline_benchmark.cpp
+//
+// Per-report CPU costs on the receive path: BufferInQueue with several
+// producers contending for slots while a consumer thread drains the queue,
+// a single-threaded push/pop round trip, found_ip_addresses() on reports
+// with 1-32 IPs, PraseMessage() on short to maximum-length domains, and the
+// whole dispatch stage with 1-8 worker threads.
+// Most benchmarks time every operation and report p50/p90/p99 in ns (with
+// several threads, the per-thread percentiles are averaged). The queue
+// benchmark runs at 1-8 producer threads. A producer whose push is rejected
+// because the queue is full yields to the consumer before trying again. The
+// latency percentiles and items_per_second cover accepted pushes only, and
+// full/op is the share of attempts that were rejected. Across thread counts
+// these give the scaling curve for each capacity.
+// BM_Dispatch feeds the ingress queue from the benchmark thread without
+// dropping. A dispatcher thread routes each report by UID to per-worker
+// rings, as main_loop does, and the workers parse the report and its IPs.
+// items_per_second across worker counts is the scaling curve of the pool.
+//
+// Usage:
+// - In AOSP: `mm` in benchmarks/ and run ioemnetd_pipeline_benchmark on the device or host.
+// - On host: compile the ioemnetd_daemon_srcs files and ../tools/selog_stub.c with `gcc -O2 -I.. -c`, then
+//            g++ -O2 -I.. pipeline_benchmark.cpp *.o -lbenchmark -lpthread -lm -o pipeline_benchmark
+
+#include <benchmark/benchmark.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "dlog.h"
+#include "dns_client.h"
+#include "ip_resolver.h"
+#include "queue.h"
+
+#define MAX_SAMPLES (1 << 20) // 每个线程最多保留的耗时样本数
+#define MAX_WORKERS 8         // BM_Dispatch的最大处理线程数
+#define DISPATCH_UIDS 64      // BM_Dispatch轮流使用的UID个数
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// 记录每次操作的耗时，结束时把百分位写入counters
+class LatencySamples
+{
+public:
+    LatencySamples() { samples_.reserve(MAX_SAMPLES); }
+    void add(uint64_t ns)
+    {
+        if (samples_.size() < MAX_SAMPLES)
+        {
+            samples_.push_back((uint32_t)std::min<uint64_t>(ns, UINT32_MAX));
+        }
+    }
+    void report(benchmark::State &state)
+    {
+        if (samples_.empty())
+        {
+            return;
+        }
+        std::sort(samples_.begin(), samples_.end());
+        state.counters["p50_ns"] = benchmark::Counter(percentile(50), benchmark::Counter::kAvgThreads);
+        state.counters["p90_ns"] = benchmark::Counter(percentile(90), benchmark::Counter::kAvgThreads);
+        state.counters["p99_ns"] = benchmark::Counter(percentile(99), benchmark::Counter::kAvgThreads);
+    }
+
+private:
+    double percentile(int pct) const
+    {
+        size_t index = (samples_.size() * (size_t)pct + 99) / 100;
+        return samples_[index > 0 ? index - 1 : 0];
+    }
+    std::vector<uint32_t> samples_;
+};
+
+/**
+ * @brief 生成一条上报，domain_len为域名长度，IP依次取不同网段
+ */
+static std::string make_message(int domain_len, int ip_count, int uid = 10086)
+{
+    std::string domain = "cdn-edge";
+    while ((int)domain.size() < domain_len - 12)
+    {
+        domain += ".region-node";
+    }
+    domain = domain.substr(0, std::max(0, domain_len - 12)) + ".example.com";
+    std::string message = "DnsRet:success,domain:" + domain + ",UID:" + std::to_string(uid) + ",PID:2345;";
+    for (int i = 0; i < ip_count; i++)
+    {
+        message += (i ? "," : "") + std::to_string(36 + i * 7) + "." + std::to_string(152 + i) + "." +
+                   std::to_string((i * 37) & 0xFF) + "." + std::to_string(10 + i);
+    }
+    message += ";";
+    return message;
+}
+
+static int consumer_stop;
+
+static void *consumer_loop(void *arg)
+{
+    (void)arg;
+    while (!__atomic_load_n(&consumer_stop, __ATOMIC_ACQUIRE))
+    {
+        struct List_Node *node;
+        if (BufferOutQueueWait(&node, 10) == SUCCESS)
+        {
+            BufferReleaseNode(node);
+        }
+    }
+    return NULL;
+}
+
+// 多个生产者同时入队，一个消费线程出队，与udp_server_loop/main_loop相同
+static void BM_QueueMultiProducer(benchmark::State &state)
+{
+    static pthread_t consumer;
+    const std::string message = make_message(24, 4);
+    LatencySamples latency;
+    uint64_t full = 0;
+
+    if (state.thread_index() == 0)
+    {
+        QueueInit((uint32)state.range(0));
+        consumer_stop = 0;
+        pthread_create(&consumer, NULL, consumer_loop, NULL);
+    }
+    for (auto _ : state)
+    {
+        uint64_t start = now_ns();
+        ERROR_MESSAGE_T ret = BufferInQueue((const uint8 *)message.data(), (uint32)message.size());
+        uint64_t end = now_ns();
+        if (ret == SUCCESS)
+        {
+            latency.add(end - start);
+        }
+        else
+        {
+            // 队列满时让出CPU给消费线程，被拒绝的尝试不计入耗时
+            full++;
+            sched_yield();
+        }
+    }
+    // 只计入成功入队的条数，各线程数下的items_per_second即为扩展曲线
+    state.SetItemsProcessed((int64_t)(state.iterations() - full));
+    state.counters["full/op"] = benchmark::Counter((double)full, benchmark::Counter::kAvgIterations);
+    latency.report(state);
+    if (state.thread_index() == 0)
+    {
+        __atomic_store_n(&consumer_stop, 1, __ATOMIC_RELEASE);
+        pthread_join(consumer, NULL);
+        bufferDestroy();
+    }
+}
+BENCHMARK(BM_QueueMultiProducer)->Arg(256)->Arg(1024)->Arg(4096)->ThreadRange(1, 8)->UseRealTime();
+
+// 单线程入队后立即出队，不含线程间交接
+static void BM_QueueRoundTrip(benchmark::State &state)
+{
+    const std::string message = make_message(24, 4);
+    LatencySamples latency;
+
+    QueueInit(QUEUE_DEFAULT_CAPACITY);
+    for (auto _ : state)
+    {
+        struct List_Node *node;
+        uint64_t start = now_ns();
+        BufferInQueue((const uint8 *)message.data(), (uint32)message.size());
+        if (BufferOutQueue(&node) == SUCCESS)
+        {
+            BufferReleaseNode(node);
+        }
+        latency.add(now_ns() - start);
+    }
+    state.SetItemsProcessed(state.iterations());
+    latency.report(state);
+    bufferDestroy();
+}
+BENCHMARK(BM_QueueRoundTrip);
+
+static void BM_FoundIpAddresses(benchmark::State &state)
+{
+    const std::string message = make_message(24, (int)state.range(0));
+    uint32 ips[MAX_IP_ADDRESSES];
+    LatencySamples latency;
+
+    for (auto _ : state)
+    {
+        uint64_t start = now_ns();
+        benchmark::DoNotOptimize(found_ip_addresses(message.c_str(), ips, MAX_IP_ADDRESSES));
+        latency.add(now_ns() - start);
+    }
+    state.SetItemsProcessed(state.iterations());
+    latency.report(state);
+}
+BENCHMARK(BM_FoundIpAddresses)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Arg(16)->Arg(32);
+
+// 域名最长127个字符，超出部分被sscanf截断
+static void BM_PraseMessage(benchmark::State &state)
+{
+    const std::string message = make_message((int)state.range(0), 8);
+    char dnsRet[64];
+    char domain[128];
+    int uid;
+    int pid;
+    LatencySamples latency;
+
+    for (auto _ : state)
+    {
+        uint64_t start = now_ns();
+        benchmark::DoNotOptimize(PraseMessage(message.c_str(), dnsRet, domain, &uid, &pid));
+        latency.add(now_ns() - start);
+    }
+    state.SetItemsProcessed(state.iterations());
+    latency.report(state);
+}
+BENCHMARK(BM_PraseMessage)->Arg(16)->Arg(48)->Arg(127);
+
+static struct
+{
+    int ring_count; // 0表示只有一个处理线程，由分发线程直接处理
+    RING_QUEUE_T *rings[MAX_WORKERS];
+    uint64_t processed; // 各处理线程处理完的条数
+} pool;
+
+static unsigned int message_uid(const char *message)
+{
+    const char *p = strstr(message, ",UID:");
+    return (p != NULL) ? (unsigned int)strtoul(p + 5, NULL, 10) : 0;
+}
+
+// 与process_message开头相同：解析上报头和IP列表
+static void parse_report(const char *message)
+{
+    char dnsRet[64];
+    char domain[128];
+    int uid;
+    int pid;
+    uint32 ips[MAX_IP_ADDRESSES];
+
+    benchmark::DoNotOptimize(PraseMessage(message, dnsRet, domain, &uid, &pid));
+    benchmark::DoNotOptimize(found_ip_addresses(message, ips, MAX_IP_ADDRESSES));
+    __atomic_fetch_add(&pool.processed, 1, __ATOMIC_RELAXED);
+}
+
+static void *pool_worker_loop(void *arg)
+{
+    RING_QUEUE_T *ring = (RING_QUEUE_T *)arg;
+    struct List_Node *node;
+    while (RingQueuePopWait(ring, &node, -1) == SUCCESS)
+    {
+        parse_report((const char *)node->data);
+        RingQueueRelease(ring, node);
+    }
+    return NULL;
+}
+
+// 与main_loop相同：一个处理线程时直接处理，否则按UID分发，入口队列关闭并取完后关闭各处理队列
+static void *pool_dispatch_loop(void *arg)
+{
+    (void)arg;
+    struct List_Node *node;
+    while (BufferOutQueueWait(&node, -1) == SUCCESS)
+    {
+        if (pool.ring_count == 0)
+        {
+            parse_report((const char *)node->data);
+        }
+        else
+        {
+            RING_QUEUE_T *ring = pool.rings[message_uid((const char *)node->data) % (unsigned int)pool.ring_count];
+            RingQueuePushWait(ring, node->data, node->len, -1);
+        }
+        BufferReleaseNode(node);
+    }
+    for (int i = 0; i < pool.ring_count; i++)
+    {
+        RingQueueClose(pool.rings[i]);
+    }
+    return NULL;
+}
+
+// 入口队列经分发线程到各处理线程，参数为处理线程数
+static void BM_Dispatch(benchmark::State &state)
+{
+    std::vector<std::string> messages;
+    pthread_t dispatcher;
+    pthread_t workers[MAX_WORKERS];
+    uint64_t pushed = 0;
+
+    for (int i = 0; i < DISPATCH_UIDS; i++)
+    {
+        messages.push_back(make_message(24, 4, 10000 + i));
+    }
+    pool.ring_count = (state.range(0) > 1) ? (int)state.range(0) : 0;
+    pool.processed = 0;
+    QueueInit(QUEUE_DEFAULT_CAPACITY);
+    for (int i = 0; i < pool.ring_count; i++)
+    {
+        pool.rings[i] = RingQueueCreate(QUEUE_DEFAULT_CAPACITY / pool.ring_count);
+        pthread_create(&workers[i], NULL, pool_worker_loop, pool.rings[i]);
+    }
+    pthread_create(&dispatcher, NULL, pool_dispatch_loop, NULL);
+
+    for (auto _ : state)
+    {
+        const std::string &message = messages[pushed++ % DISPATCH_UIDS];
+        // 不丢包：队列满时等分发线程取走
+        while (BufferInQueue((const uint8 *)message.data(), (uint32)message.size()) != SUCCESS)
+        {
+            sched_yield();
+        }
+    }
+    // 计时包括取完积压的上报
+    BufferCloseQueue();
+    pthread_join(dispatcher, NULL);
+    for (int i = 0; i < pool.ring_count; i++)
+    {
+        pthread_join(workers[i], NULL);
+        RingQueueDestroy(pool.rings[i]);
+    }
+    if (__atomic_load_n(&pool.processed, __ATOMIC_RELAXED) != pushed)
+    {
+        state.SkipWithError("reports lost in dispatch");
+    }
+    state.SetItemsProcessed((int64_t)pushed);
+    bufferDestroy();
+}
+BENCHMARK(BM_Dispatch)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+
+int main(int argc, char **argv)
+{
+    benchmark::Initialize(&argc, argv);
+    dlog_set_level(DLOG_LEVEL_ERROR); // 队列满时的告警会干扰计时
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
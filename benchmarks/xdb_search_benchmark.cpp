@@ -0,0 +1,284 @@
+// benchmarks/xdb_search_benchmark.cpp
+//
+// Measures xdb_search() in every search mode (file, vector, buffer, mmap) and
+// the precompiled region_table lookup that classifies most IPs, each against
+// uniform-random, skewed (Zipf over a few thousand hot /24s, like real DNS
+// answers) and sequential IPv4 workloads. Besides ns/lookup it reports
+// io/lookup (xdb_get_io_count) and, where perf events are available,
+// user-space cache_misses/lookup.
+//
+// Usage:
+// - In AOSP: `mm` in benchmarks/ and run ioemnetd_xdb_benchmark [db_path] on the device or host.
+// - On host: gcc -O2 -I.. -c ../xdb_searcher.c ../region_table.c ../file_watch.c ../dlog.c &&
+//            g++ -O2 -I.. xdb_search_benchmark.cpp *.o -lbenchmark -lpthread -o xdb_search_benchmark
+//   db_path defaults to /system/etc/ip2region.xdb.
+
+#include <benchmark/benchmark.h>
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "dlog.h"
+#include "region_table.h"
+extern "C" {
+#include "xdb_searcher.h" // 上游头文件没有C++保护
+}
+
+#define DEFAULT_DB_PATH "/system/etc/ip2region.xdb" // 与dns_client默认路径相同
+#define WORKLOAD_SIZE (1 << 16)                     // 每种负载预先生成的IP数，2的幂
+#define HOT_NETWORKS 4096                           // 偏斜负载中热点/24网段数
+
+enum SearchMode
+{
+    MODE_FILE,
+    MODE_VECTOR,
+    MODE_BUFFER,
+    MODE_MMAP,
+};
+
+enum Workload
+{
+    WORKLOAD_UNIFORM,
+    WORKLOAD_SKEWED,
+    WORKLOAD_SEQUENTIAL,
+};
+
+static const char *mode_names[] = {"file", "vector", "buffer", "mmap"};
+static const char *workload_names[] = {"uniform", "skewed", "sequential"};
+
+static const char *db_path = DEFAULT_DB_PATH;
+
+static std::vector<uint32_t> make_workload(Workload workload)
+{
+    std::vector<uint32_t> ips(WORKLOAD_SIZE);
+    std::mt19937 rng(20250715); // 固定种子，各次运行的负载相同
+
+    switch (workload)
+    {
+    case WORKLOAD_UNIFORM:
+        for (auto &ip : ips)
+        {
+            ip = rng();
+        }
+        break;
+    case WORKLOAD_SKEWED:
+    {
+        // 第k个热点网段的访问概率正比于1/k
+        std::vector<uint32_t> networks(HOT_NETWORKS);
+        std::vector<double> weights(HOT_NETWORKS);
+        for (int k = 0; k < HOT_NETWORKS; k++)
+        {
+            networks[k] = rng() & 0xFFFFFF00u;
+            weights[k] = 1.0 / (k + 1);
+        }
+        std::discrete_distribution<int> pick(weights.begin(), weights.end());
+        for (auto &ip : ips)
+        {
+            ip = networks[pick(rng)] | (rng() & 0xFF);
+        }
+        break;
+    }
+    case WORKLOAD_SEQUENTIAL:
+    {
+        // 每个/24取一个地址，依次经过相邻的区间
+        uint32_t ip = rng() & 0xFFFFFF00u;
+        for (auto &next : ips)
+        {
+            next = ip;
+            ip += 256;
+        }
+        break;
+    }
+    }
+    return ips;
+}
+
+static const std::vector<uint32_t> &workload_ips(Workload workload)
+{
+    static std::vector<uint32_t> cache[3];
+    if (cache[workload].empty())
+    {
+        cache[workload] = make_workload(workload);
+    }
+    return cache[workload];
+}
+
+// 统计一段代码的用户态缓存未命中次数，没有perf权限时不可用
+class CacheMissCounter
+{
+public:
+    CacheMissCounter()
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd_ = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    ~CacheMissCounter()
+    {
+        if (fd_ >= 0)
+        {
+            close(fd_);
+        }
+    }
+    bool available() const { return fd_ >= 0; }
+    void start()
+    {
+        if (fd_ >= 0)
+        {
+            ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+    uint64_t stop()
+    {
+        uint64_t value = 0;
+        if (fd_ >= 0)
+        {
+            ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fd_, &value, sizeof(value)) != (ssize_t)sizeof(value))
+            {
+                value = 0;
+            }
+        }
+        return value;
+    }
+
+private:
+    int fd_;
+};
+
+static void report_cache_misses(benchmark::State &state, const CacheMissCounter &counter, uint64_t misses)
+{
+    if (counter.available())
+    {
+        state.counters["cache_misses/lookup"] =
+            benchmark::Counter((double)misses, benchmark::Counter::kAvgIterations);
+    }
+}
+
+static void close_searcher(xdb_searcher_t *searcher, xdb_vector_index_t *v_index, xdb_content_t *content)
+{
+    if (searcher != NULL)
+    {
+        xdb_close(searcher);
+    }
+    if (v_index != NULL)
+    {
+        xdb_close_vector_index(v_index);
+    }
+    if (content != NULL)
+    {
+        xdb_close_content(content);
+    }
+}
+
+static void BM_XdbSearch(benchmark::State &state, SearchMode mode, Workload workload)
+{
+    const std::vector<uint32_t> &ips = workload_ips(workload);
+    xdb_searcher_t searcher;
+    xdb_vector_index_t *v_index = NULL;
+    xdb_content_t *content = NULL;
+    char region_buffer[256];
+    int err = -1;
+
+    switch (mode)
+    {
+    case MODE_FILE:
+        err = xdb_new_with_file_only(&searcher, db_path);
+        break;
+    case MODE_VECTOR:
+        v_index = xdb_load_vector_index_from_file(db_path);
+        err = (v_index != NULL) ? xdb_new_with_vector_index(&searcher, db_path, v_index) : -1;
+        break;
+    case MODE_BUFFER:
+        content = xdb_load_content_from_file(db_path);
+        err = (content != NULL) ? xdb_new_with_buffer(&searcher, content) : -1;
+        break;
+    case MODE_MMAP:
+        err = xdb_new_with_mmap(&searcher, db_path);
+        break;
+    }
+    if (err != 0)
+    {
+        state.SkipWithError(("failed to open " + std::string(db_path)).c_str());
+        close_searcher(NULL, v_index, content);
+        return;
+    }
+
+    CacheMissCounter counter;
+    uint64_t io_count = 0;
+    size_t i = 0;
+    counter.start();
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(xdb_search(&searcher, ips[i++ & (WORKLOAD_SIZE - 1)], region_buffer,
+                                            sizeof(region_buffer)));
+        io_count += xdb_get_io_count(&searcher);
+    }
+    report_cache_misses(state, counter, counter.stop());
+    state.counters["io/lookup"] = benchmark::Counter((double)io_count, benchmark::Counter::kAvgIterations);
+
+    close_searcher(&searcher, v_index, content);
+}
+
+// search_ip先查预编译的区间表，只有区间表不可用时才走xdb_search
+static void BM_RegionTableLookup(benchmark::State &state, Workload workload)
+{
+    const std::vector<uint32_t> &ips = workload_ips(workload);
+    char is_china = 0;
+
+    if (region_table_init(db_path) != 0)
+    {
+        state.SkipWithError(("failed to build region table from " + std::string(db_path)).c_str());
+        return;
+    }
+
+    CacheMissCounter counter;
+    size_t i = 0;
+    counter.start();
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(region_table_lookup(ips[i++ & (WORKLOAD_SIZE - 1)], &is_china));
+        benchmark::DoNotOptimize(is_china);
+    }
+    report_cache_misses(state, counter, counter.stop());
+    state.counters["io/lookup"] = 0;
+
+    region_table_deinit();
+}
+
+int main(int argc, char **argv)
+{
+    benchmark::Initialize(&argc, argv);
+    dlog_set_level(DLOG_LEVEL_WARN); // 每次运行都会重建区间表，不打印构建日志
+    if (argc > 1)
+    {
+        db_path = argv[1];
+    }
+    for (int w = WORKLOAD_UNIFORM; w <= WORKLOAD_SEQUENTIAL; w++)
+    {
+        for (int m = MODE_FILE; m <= MODE_MMAP; m++)
+        {
+            std::string name = std::string("BM_XdbSearch/") + mode_names[m] + "/" + workload_names[w];
+            benchmark::RegisterBenchmark(name.c_str(), BM_XdbSearch, (SearchMode)m, (Workload)w);
+        }
+        std::string name = std::string("BM_RegionTableLookup/") + workload_names[w];
+        benchmark::RegisterBenchmark(name.c_str(), BM_RegionTableLookup, (Workload)w);
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
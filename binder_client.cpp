@@ -14,6 +14,7 @@
  * </table>
  */
 
+#include <algorithm>
 #include <cerrno>
 #include <chrono>
 #include <cinttypes>
@@ -50,11 +51,17 @@
 #include <binder/IPCThreadState.h>
 #include <com/android/internal/net/BnOemNetdUnsolicitedEventListener.h>
 #include <com/android/internal/net/IOemNetd.h>
+#include <com/android/internal/net/IptablesRuleEntry.h>
 #include "android/net/INetd.h"
 #include "binder/IServiceManager.h"
 
 #include "selog.h"
 #include "dns_client.h"
+#include "control.h"
+#include "dlog.h"
+#include "ip_resolver.h"
+#include "rule_ipset.h"
+#include "rule_reconcile.h"
 #define LOG_PATH "/data/system/oemnetd_firewall/"
 
 namespace binder = android::binder;
@@ -68,11 +75,14 @@ using android::base::Join;
 using android::base::make_scope_guard;
 using android::base::ReadFdToString;
 using android::base::ReadFileToString;
+using android::base::Split;
 using android::base::StartsWith;
 using android::base::StringPrintf;
 using android::base::Trim;
 using android::base::unique_fd;
 using android::net::INetd;
+using com::android::internal::net::IOemNetd;
+using com::android::internal::net::IptablesRuleEntry;
 
 sp<INetd> mNetd;
 sp<com::android::internal::net::IOemNetd> oemNetd;
@@ -80,6 +90,8 @@ static char* config_path;
 static char* log_path;
 static char* db_path;
 static char region;
+static bool reconcile_mode = false;  // 只下发规则文件与内核当前规则的差量
+static size_t ipset_min_run = IPSET_DEFAULT_MIN_RUN;  // 编译成ipset的最少连续规则数，0表示不编译
 
 #define uint8 unsigned char
 #define uint16 unsigned short
@@ -117,85 +129,323 @@ int NetdBinderInit() {
 }
 
 
+#define RULE_TYPE_FILTER 0
+#define RULE_TYPE_NAT 1
+#define RULE_TYPE_MANGLE 2
+#define RULE_BATCH_MAX_BYTES (128 * 1024)  // 单次binder调用的规则长度上限，远小于binder事务缓冲区
+#define RULE_BATCH_RETRY 3                 // 整批加载失败时的重试次数
+
+// 同一张表中连续的一段规则，作为一个iptables-restore事务加载
+struct RuleBatch {
+    int type;
+    bool is_delete;  // -D 规则允许失败(规则可能本就不存在)，不重试
+    int round;       // 在该表中的序号
+    std::string rules;
+    std::vector<std::string> lines;
+};
+
+static const char* rule_type_name(int type) {
+    return (type == RULE_TYPE_FILTER) ? "filter" : (type == RULE_TYPE_NAT) ? "nat" : "mangle";
+}
+
+/**
+ * @brief 判断是否为表名行，返回表类型，规则行返回-1
+ */
+static int rule_table_type(const std::string& line) {
+    if (line[0] == '-' || line[0] == ':') {
+        return -1;
+    }
+    if (line.find("mangle") != std::string::npos) {
+        return RULE_TYPE_MANGLE;
+    } else if (line.find("filter") != std::string::npos) {
+        return RULE_TYPE_FILTER;
+    } else if (line.find("nat") != std::string::npos) {
+        return RULE_TYPE_NAT;
+    }
+    return -1;
+}
+
+/**
+ * @brief 把规则文件按表分组，同一张表中连续的添加规则或删除规则合并为一批
+ */
+static std::vector<RuleBatch> split_rule_batches(const std::string& content) {
+    std::vector<RuleBatch> batches;
+    int type = RULE_TYPE_FILTER;
+    // 每张表当前正在追加的批次下标，表内规则保持文件中的顺序
+    int open_batch[3] = {-1, -1, -1};
+    int round[3] = {0, 0, 0};
+    for (const std::string& raw : Split(content, "\n")) {
+        std::string line = Trim(raw);
+        if (line.empty() || line[0] == '#' || line == "COMMIT") {
+            continue;
+        }
+        int table = rule_table_type(line);
+        if (table >= 0) {
+            type = table;
+            continue;
+        }
+        bool is_delete = StartsWith(line, "-D ");
+        int index = open_batch[type];
+        if (index < 0 || batches[index].is_delete != is_delete ||
+            batches[index].rules.size() + line.size() + 1 > RULE_BATCH_MAX_BYTES) {
+            batches.push_back(RuleBatch{type, is_delete, round[type]++, "", {}});
+            index = open_batch[type] = batches.size() - 1;
+        }
+        batches[index].rules += line + "\n";
+        batches[index].lines.push_back(line);
+    }
+    return batches;
+}
+
+/**
+ * @brief 一次binder调用加载多批规则
+ *
+ * @return std::vector<int32_t> 每批规则的IPTABLES_RULES_*状态
+ */
+static std::vector<int32_t> apply_rule_entries(const std::vector<IptablesRuleEntry>& entries,
+                                               std::string* err) {
+    std::vector<int32_t> statuses;
+    binder::Status status = oemNetd->set_iptables_rules_batch(entries, &statuses);
+    if (!status.isOk() || statuses.size() != entries.size()) {
+        *err = status.isOk() ? "status count mismatch" : status.toString8().c_str();
+        statuses.assign(entries.size(), IOemNetd::IPTABLES_RULES_RESTORE_FAILED);
+    }
+    return statuses;
+}
+
+static IptablesRuleEntry make_rule_entry(int type, const std::string& rules) {
+    IptablesRuleEntry entry;
+    entry.family = 0;
+    entry.table = type;
+    entry.rules = rules;
+    return entry;
+}
+
+/**
+ * @brief 加载同一轮的规则批次，每张表至多一批
+ * @note 失败的批次整体重试，仍失败时逐条加载，保证有效的规则仍然生效
+ */
+static void apply_rule_round(std::vector<const RuleBatch*> pending) {
+    std::vector<const RuleBatch*> failed;
+    std::string err;
+    for (int retry = 0; retry < RULE_BATCH_RETRY && !pending.empty(); retry++) {
+        if (retry > 0) {
+            std::cerr << "Retrying " << pending.size() << " batches, current count is " << retry
+                      << std::endl;
+            sleep(1);
+        }
+        std::vector<IptablesRuleEntry> entries;
+        for (const RuleBatch* batch : pending) {
+            entries.push_back(make_rule_entry(batch->type, batch->rules));
+        }
+        std::vector<int32_t> statuses = apply_rule_entries(entries, &err);
+        std::vector<const RuleBatch*> next;
+        for (size_t i = 0; i < pending.size(); i++) {
+            const RuleBatch* batch = pending[i];
+            if (statuses[i] == IOemNetd::IPTABLES_RULES_OK) {
+                std::cout << "Loaded " << batch->lines.size() << " " << rule_type_name(batch->type)
+                          << (batch->is_delete ? " delete" : "") << " rules" << std::endl;
+            } else if (batch->is_delete) {
+                failed.push_back(batch);  // -D 规则可能本就不存在，不重试
+            } else {
+                next.push_back(batch);
+            }
+        }
+        pending.swap(next);
+    }
+    failed.insert(failed.end(), pending.begin(), pending.end());
+    if (failed.empty()) {
+        return;
+    }
+
+    std::cerr << "Failed to load " << failed.size() << " batches, falling back to one rule per entry"
+              << std::endl;
+    std::vector<IptablesRuleEntry> entries;
+    std::vector<std::pair<const RuleBatch*, const std::string*>> lines;
+    for (const RuleBatch* batch : failed) {
+        for (const std::string& line : batch->lines) {
+            entries.push_back(make_rule_entry(batch->type, line));
+            lines.emplace_back(batch, &line);
+        }
+    }
+    std::vector<int32_t> statuses = apply_rule_entries(entries, &err);
+    for (size_t i = 0; i < lines.size(); i++) {
+        if (statuses[i] != IOemNetd::IPTABLES_RULES_OK && !lines[i].first->is_delete) {  // 忽略 -D 操作的失败
+            std::string reason = err.empty() ? StringPrintf("status %d", statuses[i]) : err;
+            std::cerr << "Failed to set iptables rule: " << *lines[i].second << ", " << reason
+                      << std::endl;
+            //记录加载失败的日志
+            log_write(SELOG_LOG_TYPE_SYSTEM, 1, 1, SELOG_LOG_LEVEL_HIGH, false,
+                      "rules:%s Failed Reason:%s", lines[i].second->c_str(), reason.c_str());
+        }
+    }
+}
+
+/**
+ * @brief 把只有地址不同的连续规则编译成一个ipset和一条匹配规则
+ * @note ipset不可用或创建失败时保留原规则
+ */
+static void compile_ipsets(std::vector<RuleBatch>* batches) {
+    bool unsupported = false;
+    size_t ordinals[3] = {0, 0, 0};  // 每张表已经找到的段数，各批的集合名不会重复
+    for (RuleBatch& batch : *batches) {
+        if (ipset_min_run == 0 || unsupported || batch.is_delete) {
+            continue;
+        }
+        std::vector<IpsetRun> runs = find_ipset_runs(batch.lines, rule_type_name(batch.type),
+                                                     ipset_min_run, ordinals[batch.type]);
+        ordinals[batch.type] += runs.size();
+        if (runs.empty()) {
+            continue;
+        }
+        std::vector<std::string> lines;
+        size_t next = 0;
+        for (const IpsetRun& run : runs) {
+            lines.insert(lines.end(), batch.lines.begin() + next, batch.lines.begin() + run.first);
+            next = run.first;
+            int32_t result = IOemNetd::IPTABLES_RULES_RESTORE_FAILED;
+            binder::Status status = oemNetd->set_ipset(run.name, 0, run.members, &result);
+            if (!status.isOk() || result != IOemNetd::IPTABLES_RULES_OK) {
+                std::cerr << "Failed to set ipset " << run.name << ", status " << result
+                          << ", keeping " << run.count << " rules" << std::endl;
+                unsupported = (result == IOemNetd::IPTABLES_RULES_UNSUPPORTED);
+                continue;
+            }
+            std::cout << "Compiled " << run.count << " rules into ipset " << run.name << std::endl;
+            lines.push_back(run.rule);
+            next = run.first + run.count;
+        }
+        lines.insert(lines.end(), batch.lines.begin() + next, batch.lines.end());
+        batch.lines.swap(lines);
+        batch.rules = Join(batch.lines, '\n') + "\n";
+    }
+}
+
+/**
+ * @brief 按轮次完整加载规则批次
+ */
+static void load_rule_batches(const std::vector<RuleBatch>& batches) {
+    // 第n轮加载每张表的第n批规则，表内的删除和添加仍按文件中的顺序生效
+    for (int round = 0;; round++) {
+        std::vector<const RuleBatch*> pending;
+        for (const RuleBatch& batch : batches) {
+            if (batch.round == round) {
+                pending.push_back(&batch);
+            }
+        }
+        if (pending.empty()) {
+            break;
+        }
+        apply_rule_round(pending);
+    }
+}
+
+/**
+ * @brief 与内核当前规则比较，每张表只在一个事务中下发差量
+ *
+ * @return std::vector<RuleBatch> 无法比较或差量下发失败、需要完整加载的批次
+ */
+static std::vector<RuleBatch> reconcile_rule_batches(const std::vector<RuleBatch>& batches) {
+    std::vector<RuleBatch> remaining;
+    std::vector<IptablesRuleEntry> entries;
+    bool full_load[3] = {false, false, false};
+    for (int type = RULE_TYPE_FILTER; type <= RULE_TYPE_MANGLE; type++) {
+        std::vector<std::string> desired;
+        for (int round = 0;; round++) {
+            auto it = std::find_if(batches.begin(), batches.end(), [&](const RuleBatch& batch) {
+                return batch.type == type && batch.round == round;
+            });
+            if (it == batches.end()) {
+                break;
+            }
+            desired.insert(desired.end(), it->lines.begin(), it->lines.end());
+        }
+        if (desired.empty()) {
+            continue;
+        }
+        std::string live;
+        std::string delta;
+        binder::Status status = oemNetd->dump_iptables_rules(0, type, &live);
+        if (!status.isOk()) {
+            std::cerr << "Failed to dump " << rule_type_name(type)
+                      << " rules: " << status.toString8().c_str() << std::endl;
+            full_load[type] = true;
+        } else if (!reconcile_table(desired, live, &delta)) {
+            std::cerr << "Can not reconcile " << rule_type_name(type) << " rules" << std::endl;
+            full_load[type] = true;
+        } else if (delta.empty()) {
+            std::cout << rule_type_name(type) << " rules are up to date" << std::endl;
+        } else {
+            std::cout << "Reconciling " << rule_type_name(type) << " rules:\n" << delta;
+            entries.push_back(make_rule_entry(type, delta));
+        }
+    }
+    if (!entries.empty()) {
+        std::string err;
+        std::vector<int32_t> statuses = apply_rule_entries(entries, &err);
+        for (size_t i = 0; i < entries.size(); i++) {
+            if (statuses[i] != IOemNetd::IPTABLES_RULES_OK) {
+                std::cerr << "Failed to reconcile " << rule_type_name(entries[i].table)
+                          << " rules, status " << statuses[i] << std::endl;
+                full_load[entries[i].table] = true;
+            }
+        }
+    }
+    for (const RuleBatch& batch : batches) {
+        if (full_load[batch.type]) {
+            remaining.push_back(batch);
+        }
+    }
+    return remaining;
+}
+
 void read_file_line(const char* path) {
-    FILE* fp = fopen(path, "r");
-    if (fp == nullptr) {
+    std::string content;
+    if (!ReadFileToString(path, &content)) {
         std::cerr << "Failed to open file: " << path << ", error: " << strerror(errno) << std::endl;
         log_write(SELOG_LOG_TYPE_SYSTEM, 1, 1, SELOG_LOG_LEVEL_HIGH, false,
                   "Failed to open file: %s, error: %s ", path, strerror(errno));
         return;
     }
-    int type = 0;
-    char line[1024] = {0};
-    while (fgets(line, sizeof(line), fp) != nullptr) {
-        // Remove newline character
-        std::cout << "Read line: " << line << std::endl;
-        if (strstr(line, "mangle") != nullptr) {
-            type = 2;  // Mangle
-            std::cout << "Found mangle type, setting type to 2" << std::endl;
-            memset(line, 0, sizeof(line));  // Clear the line buffer
-            continue;                       // Skip
-        } else if (strstr(line, "filter") != nullptr) {
-            type = 0;  // Filter
-            std::cout << "Found filter type, setting type to 0" << std::endl;
-            memset(line, 0, sizeof(line));  // Clear the line buffer
-            continue;                       // Skip
-        } else if (strstr(line, "nat") != nullptr) {
-            type = 1;  // Nat
-            std::cout << "Found nat type, setting type to 1" << std::endl;
-            memset(line, 0, sizeof(line));  // Clear the line buffer
-            continue;                       // Skip
-        }
-
-        line[strlen(line) - 1] = '\0';  // Remove newline character
-        line[strlen(line)] = '\0';
-        char tmp[1024] = {0};
-        memcpy(tmp, line, strlen(line) - 1);
-        String16 rules = String16(tmp);
-        std::cout << "Processed line: " << tmp << std::endl;
-        std::cout << "#Setting iptables rules for type: " << type << ", rules: " << rules << "#"
-                  << std::endl;
-        // 判断加载结果 失败至多重试三次
-        int retryCount = 0;
-        bool success = false;
-        do {
-            String16* res = new String16();
-            oemNetd->set_iptables_rules(0, type, rules, res);
-            memset(line, 0, sizeof(line));  // Clear the line buffer
-            std::cout << "Iptables rule set: " << *res << std::endl;
-            String8 resStr = String8(*res);
-            std::string resStrC = resStr.string();
-            if(strstr(tmp,"-D") == NULL)  // 忽略 -D 操作
-            {
-                if (resStrC.find("ERROR") != std::string::npos) {
-                    std::cerr << "Failed to set iptables rule: " << resStrC << std::endl;
-                    success = false;
-                    std::cerr << "After 1 s for retrying to set iptables rule... current count is " << retryCount << std::endl;
-                    retryCount++;
-                    sleep(1);
-                    if(retryCount == 3)
-                    {
-                        //记录加载失败的日志
-                        log_write(SELOG_LOG_TYPE_SYSTEM, 1, 1, SELOG_LOG_LEVEL_HIGH, false, "rules:%s Failed Reason:%s",tmp,resStrC.c_str());
-                    }
-                }else
-                {
-                    success = true;
-                }
-            }else
-            {
-                success = true;  // -D 操作不需要验证成功
-            }
-            delete res;
-        } while (success == false && retryCount++ < 3);
+    std::vector<RuleBatch> batches = split_rule_batches(content);
+    compile_ipsets(&batches);
+    if (reconcile_mode) {
+        batches = reconcile_rule_batches(batches);
+    }
+    std::cout << "Loading " << path << " in " << batches.size() << " batches" << std::endl;
+    load_rule_batches(batches);
+}
 
-        usleep(10 * 1000);  // Sleep for 10ms to avoid overwhelming the service
+/**
+ * @brief 把下发线程攒好的一批IP通过oemnetd加入ipset，过期由ipset的timeout完成
+ */
+static int binder_enforce_add(void* ctx, const uint32* ips, int count, uint32 ttl) {
+    (void)ctx;
+    std::vector<std::string> members;
+    char ip_str[IPV4_STRING_SIZE];
+    for (int i = 0; i < count; i++) {
+        format_ipv4(ips[i], ip_str);
+        members.push_back(ip_str);
     }
-    if (ferror(fp)) {
-        std::cerr << "Error reading file: " << path << ", error: " << strerror(errno) << std::endl;
+    int32_t result = IOemNetd::IPTABLES_RULES_RESTORE_FAILED;
+    binder::Status status = oemNetd->add_ipset_members(ENFORCE_SET_NAME, 0, members, ttl, &result);
+    if (!status.isOk() || result != IOemNetd::IPTABLES_RULES_OK) {
+        std::cerr << "Failed to enforce " << count << " ips, status " << result << std::endl;
+        return -1;
     }
+    return 0;
 }
 
+/**
+ * @brief 启动时创建空的ipset，规则文件中引用它的规则才能加载
+ */
+static int binder_enforce_create(void* ctx, uint32 ttl) {
+    return binder_enforce_add(ctx, nullptr, 0, ttl);
+}
+
+static const enforce_backend_t binder_enforce_backend = {"binder", binder_enforce_add, nullptr,
+                                                         binder_enforce_create, nullptr};
+
 void PrintHelpInfo()
 {
     printf("Usage:");
@@ -203,6 +453,20 @@ void PrintHelpInfo()
     printf(" -d <file_path> : Specify the path to the file containing DNS database.\n");
     printf(" -l <path> : Specify the path to the log file.\n");
     printf(" -r <region> : Specify the region to filter IP addresses. (0 for china; 1 for other country)\n");
+    printf(" -b <count> : Specify the max number of DNS reports received per syscall. (default 32)\n");
+    printf(" -s <bytes> : Specify the receive buffer size of the DNS report socket. (default: system)\n");
+    printf(" -q <count> : Specify the capacity of the DNS report queue, rounded up to a power of 2. (default 1024)\n");
+    printf(" -w <count> : Specify the number of DNS report worker threads. (default 1, max 16)\n");
+    printf(" -m <mode> : Specify the DNS database search mode: file, vector, buffer or mmap. (default vector)\n");
+    printf(" -R : Compare the rules file with the current iptables rules and apply only the difference.\n");
+    printf(" -i <count> : Compile runs of at least <count> rules differing only in address into an ipset, 0 to disable. (default 8)\n");
+    printf(" -e <backend> : Push matched IPs into the " ENFORCE_SET_NAME " ipset: binder, or local for testing. (default off)\n");
+    printf(" -t <seconds> : Specify how long pushed IPs stay in the set. (default 300)\n");
+    printf(" -g <ms> : Collapse identical DNS events within <ms> milliseconds into one record, 0 to disable. (default 0)\n");
+    printf(" -o <policy> : Specify what to do when the log queue is full: drop-oldest, drop-newest or block. (default drop-oldest)\n");
+    printf(" -p <file_path> : Specify the path to the package list used to resolve UIDs. (default /data/system/packages.list)\n");
+    printf(" -u <path> : Specify the control socket answering stats, histograms and cache, off to disable. (default " CONTROL_SOCKET_PATH ")\n");
+    printf(" -v <level> : Specify the diagnostic log level: verbose, debug, info, warn, error or none. (default info)\n");
     printf(" -h : Show this help message.\n");
 }
 
@@ -226,6 +490,49 @@ void PraseCommandLine(int argc, char** argv) {
         } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
             region = atoi(argv[++i]);
             std::cout << "Region set to: " << region << std::endl;
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            set_recv_batch(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            set_recv_buffer_size(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc) {
+            set_queue_capacity(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            set_worker_count(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            set_xdb_mode(argv[++i]);
+        } else if (strcmp(argv[i], "-R") == 0) {
+            reconcile_mode = true;
+            std::cout << "Reconcile mode enabled" << std::endl;
+        } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            ipset_min_run = strtoul(argv[++i], nullptr, 10);
+            std::cout << "Ipset min run set to: " << ipset_min_run << std::endl;
+        } else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "binder") == 0) {
+                set_enforce_backend(&binder_enforce_backend);
+            } else if (strcmp(argv[i], "local") == 0) {
+                set_enforce_backend(enforce_local_backend());
+            } else {
+                PrintHelpInfo();
+                exit(EXIT_FAILURE);
+            }
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            set_enforce_ttl(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+            set_aggregate_window(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            set_log_overflow_policy(argv[++i]);
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            set_package_list_path(argv[++i]);
+        } else if (strcmp(argv[i], "-u") == 0 && i + 1 < argc) {
+            set_control_socket_path(argv[++i]);
+        } else if (strcmp(argv[i], "-v") == 0 && i + 1 < argc) {
+            int level;
+            if (dlog_level_parse(argv[++i], &level) != 0) {
+                PrintHelpInfo();
+                exit(EXIT_FAILURE);
+            }
+            dlog_set_level(level);
         } else if (strcmp(argv[i], "-h") == 0) {
             PrintHelpInfo();
             exit(EXIT_SUCCESS);
@@ -267,23 +574,23 @@ int main(int argc, char** argv) {
     set_log_path(log_path);
     set_db_path(db_path);
     set_region(region);
+    // 开启下发时在这里创建oemfw_dns集合，必须在防火墙线程加载规则文件之前
     dns_client_init();
+    // 信号处理函数只通知主线程，退出流程在主线程中执行
     signal(SIGINT, Stop_And_Exit);
     signal(SIGTERM, Stop_And_Exit);
 
     pthread_t firewallThread;
-    pthread_t mainThread;
-    pthread_t udpThread;
     // 创建防火墙线程
     pthread_create(&firewallThread, nullptr, firewall_thread, nullptr);
-    // 创建主线程
-    pthread_create(&mainThread, nullptr, main_loop, nullptr);
-    pthread_create(&udpThread, nullptr, udp_server_loop, nullptr);
-
-    while (1)
-    {
-        sleep(10);
+    // 创建收包、分发和处理线程
+    if (dns_client_start() != 0) {
+        std::cerr << "Failed to start DNS client" << std::endl;
+        dns_client_shutdown();
+        return EXIT_FAILURE;
     }
-    
+
+    dns_client_wait_stop();
+    dns_client_shutdown();
     return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -0,0 +1,428 @@
+/**
+ * @file control.c
+ * @brief 本地Unix socket控制端口，按请求返回运行统计
+ * @note 每个连接发送一行请求，如"stats"或"stats json"，收到响应后连接关闭。
+ *       响应只读各模块不加锁的统计，不影响处理线程；只接受root、system和shell的连接。
+ *       设备上默认的socket由init按ioemnetd.rc创建，权限对所有用户开放，由这里按对端UID过滤
+ * @version 0.1
+ * @date 2025-08-29
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // SO_PEERCRED, accept4
+#endif
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifdef __ANDROID__
+#include <cutils/sockets.h>
+#endif
+#include "dlog.h"
+#include "control.h"
+
+#define CONTROL_UID_ROOT 0
+#define CONTROL_UID_SYSTEM 1000 // AID_SYSTEM
+#define CONTROL_UID_SHELL 2000  // AID_SHELL
+
+static int listen_fd = -1;
+static int running = 0;
+static pthread_t control_thread;
+static char socket_path[sizeof(((struct sockaddr_un *)0)->sun_path)]; // 自己创建的socket文件，退出时删除
+static const control_command_t *command_table = NULL;
+static int command_count = 0;
+
+static void control_put(control_output_t *out, const char *data, size_t len)
+{
+    if (out->overflow || out->len + len >= out->cap)
+    {
+        out->overflow = 1;
+        return;
+    }
+    memcpy(out->buf + out->len, data, len);
+    out->len += len;
+}
+
+/**
+ * @brief 写入文本格式的键前缀和键
+ */
+static void control_put_key(control_output_t *out, const char *key)
+{
+    control_put(out, out->prefix, out->prefix_len);
+    control_put(out, key, strlen(key));
+}
+
+/**
+ * @brief 开始一个分组，JSON中是一个对象，文本中是键的前缀
+ */
+void control_section_begin(control_output_t *out, const char *name)
+{
+    if (out->json)
+    {
+        json_begin_object(&out->writer, name);
+        return;
+    }
+    size_t len = strlen(name);
+    if (out->prefix_len + len + 1 >= sizeof(out->prefix))
+    {
+        out->overflow = 1;
+        return;
+    }
+    memcpy(out->prefix + out->prefix_len, name, len);
+    out->prefix_len += len;
+    out->prefix[out->prefix_len++] = '.';
+    out->prefix[out->prefix_len] = '\0';
+}
+
+void control_section_end(control_output_t *out)
+{
+    if (out->json)
+    {
+        json_end_object(&out->writer);
+        return;
+    }
+    // 去掉最后一段前缀
+    if (out->prefix_len > 0)
+    {
+        out->prefix_len--;
+    }
+    while (out->prefix_len > 0 && out->prefix[out->prefix_len - 1] != '.')
+    {
+        out->prefix_len--;
+    }
+    out->prefix[out->prefix_len] = '\0';
+}
+
+void control_add_uint(control_output_t *out, const char *key, uint64 value)
+{
+    char line[32];
+    if (out->json)
+    {
+        json_add_int(&out->writer, key, (long long)value);
+        return;
+    }
+    control_put_key(out, key);
+    control_put(out, line, (size_t)snprintf(line, sizeof(line), " %llu\n", value));
+}
+
+void control_add_string(control_output_t *out, const char *key, const char *value)
+{
+    if (out->json)
+    {
+        json_add_string(&out->writer, key, value);
+        return;
+    }
+    control_put_key(out, key);
+    control_put(out, " ", 1);
+    control_put(out, value, strlen(value));
+    control_put(out, "\n", 1);
+}
+
+/**
+ * @brief 写入整数数组，文本中以空格分隔
+ */
+void control_add_uint_array(control_output_t *out, const char *key, const uint64 *values, int count)
+{
+    char item[24];
+    if (out->json)
+    {
+        json_begin_array(&out->writer, key);
+        for (int i = 0; i < count; i++)
+        {
+            json_add_int(&out->writer, NULL, (long long)values[i]);
+        }
+        json_end_array(&out->writer);
+        return;
+    }
+    control_put_key(out, key);
+    for (int i = 0; i < count; i++)
+    {
+        control_put(out, item, (size_t)snprintf(item, sizeof(item), " %llu", values[i]));
+    }
+    control_put(out, "\n", 1);
+}
+
+static void control_help(const control_command_t *commands, int count, control_output_t *out)
+{
+    for (int i = 0; i < count; i++)
+    {
+        control_add_string(out, commands[i].name, commands[i].help);
+    }
+}
+
+/**
+ * @brief 处理一行请求
+ *
+ * @param commands 命令表
+ * @param count 命令个数
+ * @param request "命令"或"命令 json"，末尾的空白被忽略
+ * @param response 输出，以'\0'结尾
+ * @param cap response大小
+ * @return int 响应长度；命令不存在时输出帮助并返回-1，响应过长时返回-2
+ */
+int control_handle_request(const control_command_t *commands, int count, const char *request, char *response,
+                           size_t cap)
+{
+    char name[CONTROL_MAX_REQUEST];
+    char format[CONTROL_MAX_REQUEST];
+    control_output_t out;
+    const control_command_t *command = NULL;
+    int fields;
+
+    memset(&out, 0, sizeof(out));
+    fields = sscanf(request, "%127s %127s", name, format);
+    out.json = (fields == 2 && strcmp(format, "json") == 0);
+    for (int i = 0; fields >= 1 && i < count; i++)
+    {
+        if (strcmp(name, commands[i].name) == 0)
+        {
+            command = &commands[i];
+            break;
+        }
+    }
+    if (out.json)
+    {
+        json_writer_init(&out.writer, response, cap);
+        json_begin_object(&out.writer, NULL);
+    }
+    else
+    {
+        out.buf = response;
+        out.cap = cap;
+    }
+    if (command != NULL)
+    {
+        command->handler(&out);
+    }
+    else
+    {
+        control_help(commands, count, &out);
+    }
+    if (out.json)
+    {
+        json_end_object(&out.writer);
+        int len = json_writer_finish(&out.writer);
+        if (len >= 0 && (size_t)len + 1 < cap)
+        {
+            response[len++] = '\n';
+            response[len] = '\0';
+        }
+        out.len = (len >= 0) ? (size_t)len : 0;
+        out.overflow = (len < 0 || out.overflow);
+    }
+    if (out.overflow)
+    {
+        snprintf(response, cap, "response too large\n");
+        return -2;
+    }
+    response[out.len] = '\0';
+    return command != NULL ? (int)out.len : -1;
+}
+
+/**
+ * @brief 只接受root、system、shell以及与本进程相同用户的连接
+ */
+static int control_peer_allowed(int fd)
+{
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0)
+    {
+        return 0;
+    }
+    return cred.uid == CONTROL_UID_ROOT || cred.uid == CONTROL_UID_SYSTEM || cred.uid == CONTROL_UID_SHELL ||
+           cred.uid == getuid();
+}
+
+/**
+ * @brief 读一行请求，处理后写回响应
+ */
+static void control_serve(int fd)
+{
+    char request[CONTROL_MAX_REQUEST];
+    char response[CONTROL_MAX_RESPONSE];
+    struct timeval timeout = {CONTROL_IO_TIMEOUT / 1000, (CONTROL_IO_TIMEOUT % 1000) * 1000};
+    size_t got = 0;
+    size_t len;
+
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    if (!control_peer_allowed(fd))
+    {
+        DLOGW("Rejected control connection");
+        return;
+    }
+    while (got < sizeof(request) - 1)
+    {
+        ssize_t n = read(fd, request + got, sizeof(request) - 1 - got);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            break;
+        }
+        got += (size_t)n;
+        if (memchr(request, '\n', got) != NULL)
+        {
+            break;
+        }
+    }
+    request[got] = '\0';
+    // 命令不存在或响应过长时response中是帮助或错误信息，同样写回
+    control_handle_request(command_table, command_count, request, response, sizeof(response));
+    len = strlen(response);
+    for (size_t sent = 0; sent < len;)
+    {
+        // 对端不读就关闭时返回EPIPE，不能让SIGPIPE杀掉进程
+        ssize_t n = send(fd, response + sent, len - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            break;
+        }
+        sent += (size_t)n;
+    }
+}
+
+static void *control_loop(void *arg)
+{
+    (void)arg;
+    prctl(PR_SET_NAME, "Control");
+    while (__atomic_load_n(&running, __ATOMIC_ACQUIRE))
+    {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno != EINTR && __atomic_load_n(&running, __ATOMIC_ACQUIRE))
+            {
+                DLOGE("control accept error: %s(errno: %d)", strerror(errno), errno);
+                usleep(100000); // 避免fd耗尽时空转
+            }
+            continue;
+        }
+        control_serve(fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+/**
+ * @brief 绑定并监听路径上的socket，已存在的socket文件先删除
+ *
+ * @param path
+ * @return int 监听的描述符，失败返回-1
+ */
+static int control_bind(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        DLOGE("control socket error: %s(errno: %d)", strerror(errno), errno);
+        return -1;
+    }
+    unlink(path); // 上次退出时留下的socket文件
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || chmod(path, 0660) != 0 || listen(fd, 8) != 0)
+    {
+        DLOGE("control bind %s error: %s(errno: %d)", path, strerror(errno), errno);
+        close(fd);
+        return -1;
+    }
+    strcpy(socket_path, path);
+    return fd;
+}
+
+/**
+ * @brief 创建控制socket并启动处理线程
+ * @note 设备上使用默认路径时取init按ioemnetd.rc创建的socket，
+ *       其余情况(主机、-u指定的路径、未经init启动)自己绑定
+ * @param path socket路径，已存在时先删除
+ * @param commands 命令表，需要一直有效
+ * @param count 命令个数
+ * @return int 0成功
+ */
+int control_start(const char *path, const control_command_t *commands, int count)
+{
+    if (path == NULL || strlen(path) >= sizeof(socket_path))
+    {
+        DLOGE("Invalid control socket path");
+        return -1;
+    }
+    socket_path[0] = '\0';
+    listen_fd = -1;
+#ifdef __ANDROID__
+    if (strcmp(path, CONTROL_SOCKET_PATH) == 0)
+    {
+        listen_fd = android_get_control_socket(CONTROL_SOCKET_NAME);
+        if (listen_fd >= 0 && listen(listen_fd, 8) != 0)
+        {
+            DLOGE("control listen error: %s(errno: %d)", strerror(errno), errno);
+            close(listen_fd);
+            return -1;
+        }
+    }
+#endif
+    if (listen_fd < 0)
+    {
+        listen_fd = control_bind(path);
+        if (listen_fd < 0)
+        {
+            return -1;
+        }
+    }
+    command_table = commands;
+    command_count = count;
+    __atomic_store_n(&running, 1, __ATOMIC_RELEASE);
+    if (pthread_create(&control_thread, NULL, control_loop, NULL) != 0)
+    {
+        DLOGE("Failed to create control thread");
+        __atomic_store_n(&running, 0, __ATOMIC_RELEASE);
+        close(listen_fd);
+        listen_fd = -1;
+        if (socket_path[0] != '\0')
+        {
+            unlink(socket_path);
+        }
+        return -1;
+    }
+    DLOGI("Control socket listening on %s", path);
+    return 0;
+}
+
+/**
+ * @brief 停止处理线程，删除自己创建的socket文件
+ */
+void control_stop(void)
+{
+    if (!__atomic_exchange_n(&running, 0, __ATOMIC_ACQ_REL))
+    {
+        return;
+    }
+    shutdown(listen_fd, SHUT_RDWR); // 唤醒阻塞在accept中的线程
+    pthread_join(control_thread, NULL);
+    close(listen_fd);
+    listen_fd = -1;
+    if (socket_path[0] != '\0')
+    {
+        unlink(socket_path);
+    }
+}
@@ -0,0 +1,62 @@
+/**
+ * @file control.h
+ * @brief 本地Unix socket控制端口，按请求返回运行统计
+ * @version 0.1
+ * @date 2025-08-29
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#ifndef CONTROL_H
+#define CONTROL_H
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include "queue.h"
+#include "json_writer.h"
+
+#define CONTROL_SOCKET_NAME "ioemnetd_ctl"                   // ioemnetd.rc中声明的socket名
+#define CONTROL_SOCKET_PATH "/dev/socket/" CONTROL_SOCKET_NAME // 默认socket路径，由init创建
+#define CONTROL_MAX_REQUEST 128                         // 请求行最大长度
+#define CONTROL_MAX_RESPONSE 16384                      // 单个响应最大长度
+#define CONTROL_IO_TIMEOUT 1000                         // 读写超时，单位毫秒
+#define CONTROL_MAX_PREFIX 64                           // 文本格式中键前缀的最大长度
+
+// 处理函数写入的输出，同一套调用可以生成文本或JSON
+typedef struct control_output
+{
+    int json; // 1输出JSON，0输出每行一个"键 值"的文本
+    json_writer_t writer;
+    char *buf;
+    size_t cap;
+    size_t len;
+    int overflow;
+    char prefix[CONTROL_MAX_PREFIX]; // 文本格式下当前分组的键前缀，如"ingress_queue."
+    size_t prefix_len;
+} control_output_t;
+
+typedef void (*control_handler_fn)(control_output_t *out);
+
+typedef struct control_command
+{
+    const char *name;
+    const char *help;
+    control_handler_fn handler;
+} control_command_t;
+
+void control_section_begin(control_output_t *out, const char *name);
+void control_section_end(control_output_t *out);
+void control_add_uint(control_output_t *out, const char *key, uint64 value);
+void control_add_string(control_output_t *out, const char *key, const char *value);
+void control_add_uint_array(control_output_t *out, const char *key, const uint64 *values, int count);
+
+int control_handle_request(const control_command_t *commands, int count, const char *request, char *response,
+                           size_t cap);
+int control_start(const char *path, const control_command_t *commands, int count);
+void control_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,98 @@
+/**
+ * @file dlog.c
+ * @brief 分级诊断日志
+ * @version 0.1
+ * @date 2025-08-27
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __ANDROID__
+#include <android/log.h>
+#endif
+#include "dlog.h"
+
+int dlog_level = DLOG_DEFAULT_LEVEL;
+
+static const char *dlog_level_names[] = {"verbose", "debug", "info", "warn", "error", "none"};
+
+#ifdef __ANDROID__
+static const int dlog_android_priorities[] = {ANDROID_LOG_VERBOSE, ANDROID_LOG_DEBUG, ANDROID_LOG_INFO,
+                                              ANDROID_LOG_WARN, ANDROID_LOG_ERROR};
+#else
+static const char dlog_level_chars[] = "VDIWE";
+#endif
+
+/**
+ * @brief 输出一条日志，由DLOG宏在级别检查之后调用
+ *
+ * @param level DLOG_LEVEL_VERBOSE到DLOG_LEVEL_ERROR
+ * @param format 不需要换行
+ */
+void dlog_print(int level, const char *format, ...)
+{
+    va_list ap;
+
+    if (level < DLOG_LEVEL_VERBOSE || level > DLOG_LEVEL_ERROR)
+    {
+        level = DLOG_LEVEL_ERROR;
+    }
+    va_start(ap, format);
+#ifdef __ANDROID__
+    __android_log_vprint(dlog_android_priorities[level], DLOG_TAG, format, ap);
+#else
+    char line[1024];
+    vsnprintf(line, sizeof(line), format, ap);
+    // 一次写出整行，多个线程的输出不会交错
+    printf("%c/%s: %s\n", dlog_level_chars[level], DLOG_TAG, line);
+#endif
+    va_end(ap);
+}
+
+void dlog_set_level(int level)
+{
+    if (level < DLOG_LEVEL_VERBOSE || level > DLOG_LEVEL_NONE)
+    {
+        DLOGW("Invalid log level %d", level);
+        return;
+    }
+    dlog_level = level;
+    if (level < DLOG_MIN_LEVEL)
+    {
+        DLOGW("Log level %s is below the compiled minimum %s", dlog_level_names[level],
+              dlog_level_names[DLOG_MIN_LEVEL]);
+    }
+}
+
+/**
+ * @brief 解析级别名称或数字
+ *
+ * @param name verbose, debug, info, warn, error, none或0-5
+ * @param level 输出
+ * @return int 0成功
+ */
+int dlog_level_parse(const char *name, int *level)
+{
+    if (name == NULL)
+    {
+        return -1;
+    }
+    for (int i = 0; i <= DLOG_LEVEL_NONE; i++)
+    {
+        if (strcmp(name, dlog_level_names[i]) == 0)
+        {
+            *level = i;
+            return 0;
+        }
+    }
+    if (name[0] >= '0' && name[0] <= '0' + DLOG_LEVEL_NONE && name[1] == '\0')
+    {
+        *level = name[0] - '0';
+        return 0;
+    }
+    return -1;
+}
@@ -0,0 +1,65 @@
+/**
+ * @file dlog.h
+ * @brief 分级诊断日志，低于编译期级别的调用编译后不存在，其余再按运行期级别过滤
+ * @note Android上写入logcat，主机上写到标准输出
+ * @version 0.1
+ * @date 2025-08-27
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#ifndef DLOG_H
+#define DLOG_H
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define DLOG_LEVEL_VERBOSE 0 // 每个包都会打印，只用于调试
+#define DLOG_LEVEL_DEBUG 1
+#define DLOG_LEVEL_INFO 2
+#define DLOG_LEVEL_WARN 3
+#define DLOG_LEVEL_ERROR 4
+#define DLOG_LEVEL_NONE 5
+
+#define DLOG_TAG "ioemnetd"
+
+// 编译期最低级别，发布版本中VERBOSE的调用连同参数计算一起被去掉
+#ifndef DLOG_MIN_LEVEL
+#ifdef NDEBUG
+#define DLOG_MIN_LEVEL DLOG_LEVEL_DEBUG
+#else
+#define DLOG_MIN_LEVEL DLOG_LEVEL_VERBOSE
+#endif
+#endif
+
+#define DLOG_DEFAULT_LEVEL DLOG_LEVEL_INFO // 默认运行期级别
+
+extern int dlog_level; // 运行期级别，只在启动时修改
+
+void dlog_print(int level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+void dlog_set_level(int level);
+int dlog_level_parse(const char *name, int *level);
+
+// 只为打印日志才需要的计算可以先用DLOG_ON判断
+#define DLOG_ON(level) ((level) >= DLOG_MIN_LEVEL && (level) >= dlog_level)
+
+#define DLOG(level, ...)                                              \
+    do                                                                \
+    {                                                                 \
+        if (DLOG_ON(level))                                           \
+        {                                                             \
+            dlog_print((level), __VA_ARGS__);                         \
+        }                                                             \
+    } while (0)
+
+#define DLOGV(...) DLOG(DLOG_LEVEL_VERBOSE, __VA_ARGS__)
+#define DLOGD(...) DLOG(DLOG_LEVEL_DEBUG, __VA_ARGS__)
+#define DLOGI(...) DLOG(DLOG_LEVEL_INFO, __VA_ARGS__)
+#define DLOGW(...) DLOG(DLOG_LEVEL_WARN, __VA_ARGS__)
+#define DLOGE(...) DLOG(DLOG_LEVEL_ERROR, __VA_ARGS__)
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -8,6 +8,10 @@
  * @copyright Copyright (c) 2025
  *
  */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // recvmmsg
+#endif
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -16,44 +20,96 @@
 #include <arpa/inet.h>
 #include <errno.h>
 #include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
-#include <pcre2.h>
+#include <sys/uio.h>
 #include "xdb_searcher.h"
+#include "region_table.h"
+#include "pid_cache.h"
+#include "package_table.h"
+#include "enforce.h"
+#include "log_writer.h"
+#include "aggregate.h"
+#include "file_watch.h"
 #include "queue.h"
 #include "ip_resolver.h"
-#include "cJSON.h"
+#include "json_writer.h"
+#include "dlog.h"
+#include "metrics.h"
+#include "control.h"
 #include "selog.h"
 #include "dns_client.h"
 #include <signal.h>
 
 #define MAX_LEN 1024
-#define MAX_PCK 1000 // 最大包数
+#define MAX_PCK 1024 // 默认队列容量（包数）
 #define LISTEN_IP "127.0.0.1"
 #define LISTEN_PORT 19330 // 监听端口
-#define MAIN_FUNC_CYCLE 10*1000 // 主循环周期，单位毫秒
+#define DEFAULT_RECV_BATCH 32 // 默认单次收包数
+#define MAX_RECV_BATCH 1024 // 单次收包数上限
+#define MAX_WORKERS 16 // 处理线程数上限
+#define XDB_MODE_FILE_ONLY 0 // 只用文件查询
+#define XDB_MODE_VECTOR_INDEX 1 // 缓存VectorIndex
+#define XDB_MODE_BUFFER 2 // 整个xdb读入内存
+#define XDB_MODE_MMAP 3 // 整个xdb只读映射
 #define FOREIGN 1 
 #define DOMESTIC 0 
 #define LOG_PATH "/data/system/dns_client" // 日志路径
+#define EVENT_LOG_PREFIX "Event logged: " // DNS事件日志的前缀
+#define EVENT_LOG_PREFIX_LEN (sizeof(EVENT_LOG_PREFIX) - 1)
 
 
 // 示例消息 DnsRet:success,domain:域名,UID:UID,PID:pid;114.114.114.114,8.8.8.8,1.1.1.1;
 
 static char *db_path = "/system/etc/ip2region.xdb"; // 数据库路径
 static char* log_path = LOG_PATH; // 日志路径
+static char *package_list_path = PACKAGES_LIST_PATH; // 包列表路径
 static xdb_vector_index_t *v_index;
-static xdb_searcher_t searcher;
+static xdb_content_t *c_buffer;
+static int xdb_mode = XDB_MODE_VECTOR_INDEX; // xdb查询方式
+static const char *xdb_mode_names[] = {"file", "vector", "buffer", "mmap"};
 static selog_handle hselog = NULL;
+static log_overflow_policy_t log_overflow_policy = LOG_OVERFLOW_DROP_OLDEST; // 日志队列满时的处理方式
 static char region = DOMESTIC;
+static int recv_batch = DEFAULT_RECV_BATCH; // recvmmsg单次最大收包数
+static int recv_buffer_size = 0; // socket接收缓冲区大小，0表示使用系统默认值
+static uint32 queue_capacity = MAX_PCK; // 队列容量
+static int worker_count = 1; // 处理线程数
+static const enforce_backend_t *enforce_backend = NULL; // 下发后端，NULL表示只记录不下发
+static int enforce_ttl = ENFORCE_DEFAULT_TTL; // 下发的IP多久后过期，单位秒
+static int aggregate_window = 0; // 重复事件的合并窗口，单位毫秒，0表示不合并
+static const char *control_socket_path = CONTROL_SOCKET_PATH; // 控制socket路径，NULL表示不开启
+
+// 处理线程，每个线程有自己的队列和xdb查询对象
+typedef struct dns_worker
+{
+    int id;
+    pthread_t thread;
+    RING_QUEUE_T *ring;
+    xdb_searcher_t searcher;
+    pid_cache_t *pid_cache;
+    aggregator_t *aggregator; // 不合并时为NULL
+} dns_worker_t;
+static dns_worker_t workers[MAX_WORKERS];
+static int workers_started = 0; // 已启动的处理线程数
+static int udp_server_fd = -1;
+static pthread_t udp_thread;
+static pthread_t main_thread;
+static int udp_thread_started = 0;
+static int main_thread_started = 0;
+static int stop_requested = 0; // 信号处理函数中置位，udp_server_loop每批检查一次
+static int stop_event_fd = -1; // 收到停止请求后一直可读，dns_client_wait_stop在上面等待
 /**
  * @brief 初始化队列
  * 
  */
 void Queue_Init(void)
 {
-    ERROR_MESSAGE_T ret = QueueInit();
+    ERROR_MESSAGE_T ret = QueueInit(queue_capacity);
     if (ret != SUCCESS)
     {
-        printf("Queue initialization failed with error code: %d\n", ret);
+        DLOGE("Queue initialization failed with error code: %d", ret);
         exit(EXIT_FAILURE);
     }
 }
@@ -73,15 +129,16 @@ int log_init(const char *log_path)
     Selog_SetConfCommon(hselog, SELOG_CFG_CAPACITY, 1024 * 1024);
     Selog_SetConfCommon(hselog, SELOG_CFG_PATH, log_path);
     Selog_Init(hselog);
-    printf("Log initialized successfully with path: %s\n", log_path);
-    if (hselog != 0)
-        return 0;
-
-    return -1;
+    DLOGI("Log initialized successfully with path: %s", log_path);
+    if (hselog == 0)
+        return -1;
+    // Selog_Write由写入线程调用，存储慢时不阻塞处理线程
+    return log_writer_start(hselog, LOG_WRITER_DEFAULT_CAPACITY, log_overflow_policy);
 }
 
 void log_deinit()
 {
+    log_writer_stop(); // 写完队列中剩余的日志
     if (hselog != NULL)
     {
         Selog_Deinit(hselog);
@@ -89,150 +146,269 @@ void log_deinit()
     }
 }
 
-uint8 log_write(Selog_LogType type, uint16 eventid, uint16 user_eventid, Selog_LogLevelType level, boolean urgent_flag,
-                const char *format, ...)
+/**
+ * @brief 把已经格式化好的日志交给写入线程
+ *
+ * @param aggregation_count 窗口内相同事件出现的次数，0表示未合并
+ * @param data 日志内容
+ * @param len 日志长度，不包含结束符
+ * @return uint8 0成功
+ */
+static uint8 log_write_buffer(uint32 aggregation_count, Selog_LogType type, uint16 eventid, uint16 user_eventid,
+                              Selog_LogLevelType level, boolean urgent_flag, const char *data, uint32 len)
 {
     uint8 ret = 0;
     Selog_WriteStructType w_st;
-    va_list ap;
-    char logbuf[SELOG_SINGLE_LOG_SIZE] = {0};
-    uint32 log_len;
 
     memset(&w_st, 0, sizeof(Selog_WriteStructType));
 
-    va_start(ap, format);
-    vsnprintf(logbuf, SELOG_SINGLE_LOG_SIZE, format, ap);
-    va_end(ap);
-    logbuf[SELOG_SINGLE_LOG_SIZE - 1] = '\0';
-    log_len = strlen(logbuf);
-
     w_st.log_type = type;
     w_st.eventid = eventid;
     w_st.user_eventid = user_eventid;
     w_st.level = level;
     w_st.urgent_flag = urgent_flag;
-    w_st.aggregation_count = 0;
+    w_st.aggregation_count = aggregation_count;
     memset(w_st.app_tags, 0, sizeof(w_st.app_tags));
     strncpy(w_st.app_tags, "dns_client", SELOG_APP_TAGS_SIZE);
-    ret = Selog_Write(hselog, w_st, logbuf, log_len);
+    ret = (log_submit(&w_st, data, len) == 0) ? 0 : 1;
     if (ret != 0) {
-        printf("Failed to write log: %s, error code: %d\n", logbuf, ret);
-    } else {
-        printf("Log written successfully: %s\n", logbuf);
+        DLOGW("Failed to submit log, dropped");
     }
 
     return ret;
 }
 
+uint8 log_write(Selog_LogType type, uint16 eventid, uint16 user_eventid, Selog_LogLevelType level, boolean urgent_flag,
+                const char *format, ...)
+{
+    va_list ap;
+    char logbuf[SELOG_SINGLE_LOG_SIZE] = {0};
+
+    va_start(ap, format);
+    vsnprintf(logbuf, SELOG_SINGLE_LOG_SIZE, format, ap);
+    va_end(ap);
+    logbuf[SELOG_SINGLE_LOG_SIZE - 1] = '\0';
+    return log_write_buffer(0, type, eventid, user_eventid, level, urgent_flag, logbuf, strlen(logbuf));
+}
+
 /**
- * @brief udp服务器循环函数
- * 
- * @param arg 
- * @return void* 
+ * @brief 记录一条已经带EVENT_LOG_PREFIX前缀的DNS事件
+ *
+ * @param count 窗口内出现的次数，0表示未合并
  */
-void *udp_server_loop(void *arg)
+static uint8 log_write_event(uint32 count, const char *data, uint32 len)
+{
+    uint8 ret = log_write_buffer(count, SELOG_LOG_TYPE_SYSTEM, 1, 1, SELOG_LOG_LEVEL_MIDDLE, FALSE, data, len);
+    metrics_count(ret == 0 ? METRICS_EVENTS_LOGGED : METRICS_EVENTS_DROPPED, 1);
+    return ret;
+}
+
+/**
+ * @brief 记录一条合并后的DNS事件，合并窗口结束时由aggregator回调
+ *
+ * @param event 事件JSON
+ * @param count 窗口内出现的次数
+ */
+static void log_event(const char *event, uint32 count)
+{
+    char logbuf[SELOG_SINGLE_LOG_SIZE];
+    size_t len = strlen(event);
+
+    if (len > sizeof(logbuf) - 1 - EVENT_LOG_PREFIX_LEN)
+    {
+        len = sizeof(logbuf) - 1 - EVENT_LOG_PREFIX_LEN;
+    }
+    memcpy(logbuf, EVENT_LOG_PREFIX, EVENT_LOG_PREFIX_LEN);
+    memcpy(logbuf + EVENT_LOG_PREFIX_LEN, event, len);
+    log_write_event(count, logbuf, (uint32)(EVENT_LOG_PREFIX_LEN + len));
+}
+
+/**
+ * @brief 设置udp socket，绑定监听地址并按配置调整接收缓冲区
+ *
+ * @return int socket描述符，失败返回-1
+ */
+static int udp_server_socket(void)
 {
-    (void)arg;
-    pthread_detach(pthread_self());   // 设置线程为分离状态
-    prctl(PR_SET_NAME, "Udp_Server"); // 设置线程名称为Udp_Server
     int server_fd;
     struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
     server_addr.sin_addr.s_addr = inet_addr(LISTEN_IP);
     server_addr.sin_port = htons(LISTEN_PORT);
-    struct sockaddr_in client_addr;
-    uint8_t buffer[MAX_LEN] = {0};
-    server_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    server_fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
     if (server_fd < 0)
     {
-        printf("socket error: %s(errno: %d)\n", strerror(errno), errno);
-        return NULL;
+        DLOGE("socket error: %s(errno: %d)", strerror(errno), errno);
+        return -1;
+    }
+    if (recv_buffer_size > 0)
+    {
+        // root下用SO_RCVBUFFORCE突破rmem_max限制，失败再退回SO_RCVBUF
+        if (setsockopt(server_fd, SOL_SOCKET, SO_RCVBUFFORCE, &recv_buffer_size, sizeof(recv_buffer_size)) < 0 &&
+            setsockopt(server_fd, SOL_SOCKET, SO_RCVBUF, &recv_buffer_size, sizeof(recv_buffer_size)) < 0)
+        {
+            DLOGE("setsockopt SO_RCVBUF error: %s(errno: %d)", strerror(errno), errno);
+        }
+    }
+    // 让内核在控制消息中带上socket的累计丢包数
+    int on = 1;
+    if (setsockopt(server_fd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on)) < 0)
+    {
+        DLOGW("setsockopt SO_RXQ_OVFL error: %s(errno: %d)", strerror(errno), errno);
     }
     if (bind(server_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
     {
-        printf("bind error: %s(errno: %d)\n", strerror(errno), errno);
-        return NULL;
+        DLOGE("bind error: %s(errno: %d)", strerror(errno), errno);
+        close(server_fd);
+        return -1;
     }
-    printf("UDP server is running...\n");
-    while (1)
+    return server_fd;
+}
+
+/**
+ * @brief 从控制消息中取出内核丢包计数
+ *
+ * @param msg
+ * @param drops 输出，内核累计丢包数
+ * @return int 1表示取到，0表示没有
+ */
+static int udp_get_kernel_drops(struct msghdr *msg, uint32_t *drops)
+{
+    struct cmsghdr *cmsg;
+    for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+        {
+            memcpy(drops, CMSG_DATA(cmsg), sizeof(*drops));
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief udp服务器循环函数
+ * @note 使用recvmmsg一次收取至多recv_batch个报文并整批入队，
+ *       阻塞在socket上等待数据，不再固定休眠；
+ *       收到停止请求后由dns_client_shutdown关闭socket的读端唤醒
+ * @param arg
+ * @return void*
+ */
+static void *udp_server_loop(void *arg)
+{
+    (void)arg;
+    prctl(PR_SET_NAME, "Udp_Server"); // 设置线程名称为Udp_Server
+    int batch = recv_batch;
+    int server_fd = udp_server_fd;
+
+    // 每个报文多留一个字节放结束符，超长报文由MSG_TRUNC识别后丢弃
+    uint8_t *buffers = (uint8_t *)malloc((size_t)batch * (MAX_LEN + 1));
+    struct mmsghdr *msgs = (struct mmsghdr *)calloc(batch, sizeof(struct mmsghdr));
+    struct iovec *iovecs = (struct iovec *)calloc(batch, sizeof(struct iovec));
+    char *controls = (char *)calloc(batch, CMSG_SPACE(sizeof(uint32_t)));
+    const uint8 **datas = (const uint8 **)calloc(batch, sizeof(uint8 *));
+    uint32 *lens = (uint32 *)calloc(batch, sizeof(uint32));
+    if (buffers == NULL || msgs == NULL || iovecs == NULL || controls == NULL || datas == NULL || lens == NULL)
+    {
+        DLOGE("Memory allocation failed for receive batch of %d", batch);
+        goto out;
+    }
+
+    DLOGI("UDP server is running, batch size %d...", batch);
+    uint32_t last_kernel_drops = 0;
+    while (!__atomic_load_n(&stop_requested, __ATOMIC_ACQUIRE))
     {
-        socklen_t len = sizeof(client_addr);
-        int n = recvfrom(server_fd, buffer, MAX_LEN, 0, (struct sockaddr *)&client_addr, &len);
+        for (int i = 0; i < batch; i++)
+        {
+            iovecs[i].iov_base = buffers + (size_t)i * (MAX_LEN + 1);
+            iovecs[i].iov_len = MAX_LEN;
+            msgs[i].msg_hdr.msg_iov = &iovecs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = NULL;
+            msgs[i].msg_hdr.msg_namelen = 0;
+            msgs[i].msg_hdr.msg_control = controls + (size_t)i * CMSG_SPACE(sizeof(uint32_t));
+            msgs[i].msg_hdr.msg_controllen = CMSG_SPACE(sizeof(uint32_t));
+            msgs[i].msg_hdr.msg_flags = 0;
+        }
+        // MSG_WAITFORONE: 阻塞等到第一个报文，之后把socket中已有的报文一次取完
+        int n = recvmmsg(server_fd, msgs, batch, MSG_WAITFORONE, NULL);
         if (n < 0)
         {
-            printf("recvfrom error: %s(errno: %d)\n", strerror(errno), errno);
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            DLOGE("recvmmsg error: %s(errno: %d)", strerror(errno), errno);
             break;
         }
-        buffer[n] = '\0'; // 确保字符串以null结尾
-        printf("Received data: %s\n", buffer);
-        if (GetQueueSize() > MAX_PCK)
+        if (n == 0)
         {
-            printf("Queue is full, dropping packet\n");
-            continue; // 队列已满，丢弃数据包
+            continue; // 读端已关闭，回到循环开头检查停止请求
         }
-        else
+
+        uint64 batch_start_ns = metrics_now_ns();
+        metrics_count(METRICS_PACKETS_RECEIVED, (uint64)n);
+        uint32 count = 0;
+        for (int i = 0; i < n; i++)
         {
-            ERROR_MESSAGE_T ret = BufferInQueue(buffer, n);
-            if (ret != SUCCESS)
+            uint32_t kernel_drops = 0;
+            if (udp_get_kernel_drops(&msgs[i].msg_hdr, &kernel_drops) && kernel_drops != last_kernel_drops)
             {
-                printf("Failed to enqueue data with error code: %d\n", ret);
+                DLOGW("Socket buffer overflow, %u packets dropped by kernel", kernel_drops - last_kernel_drops);
+                metrics_count(METRICS_PACKETS_KERNEL_DROPPED, kernel_drops - last_kernel_drops);
+                last_kernel_drops = kernel_drops;
             }
-            else
+            if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC)
             {
-                printf("Data enqueued successfully, current queue size: %d\n", GetQueueSize());
+                DLOGW("Packet too long, dropping packet");
+                metrics_count(METRICS_PACKETS_TOO_LONG, 1);
+                continue;
             }
+            if (msgs[i].msg_len < QUEUE_MIN_DATA_LEN)
+            {
+                // 队列也会拒绝，在这里过滤掉以免算作队列满
+                metrics_count(METRICS_MESSAGES_MALFORMED, 1);
+                continue;
+            }
+            uint8_t *buffer = (uint8_t *)iovecs[i].iov_base;
+            buffer[msgs[i].msg_len] = '\0'; // 确保字符串以null结尾
+            DLOGV("Received data: %s", buffer);
+            datas[count] = buffer;
+            lens[count] = msgs[i].msg_len;
+            count++;
         }
-        usleep(MAIN_FUNC_CYCLE);
-    }
-    close(server_fd);
-    printf("UDP server stopped.\n");
-    return NULL;
-}
-
 
-/**
- * @brief Get the pid name object 
- * @note if return NULL, means the pid is not exist or error,else return the process name. ptr need to be freed by caller.
- * @param pid 
- * @return char* 
- */
-char *get_pid_name(int pid)
-{
-    FILE *fp = NULL;
-    char pid_path[64] = {0};
-    snprintf(pid_path, sizeof(pid_path), "/proc/%d/cmdline", pid);
-    fp = fopen(pid_path, "r");
-    if (fp == NULL)
-    {
-        printf("Failed to open file %s: %s\n", pid_path, strerror(errno));
-        return NULL;
-    }
-    char *pid_name = (char *)malloc(256);
-    if (pid_name == NULL)
-    {
-        printf("Memory allocation failed\n");
-        fclose(fp);
-        return NULL;
-    }
-    size_t n = fread(pid_name, 1, 255, fp);
-    if (n < 1)
-    {
-        printf("Failed to read from file %s: %s\n", pid_path, strerror(errno));
-        free(pid_name);
-        fclose(fp);
-        return NULL;
+        if (count > 0)
+        {
+            uint32 enqueued = BufferInQueueBatch(datas, lens, count);
+            if (enqueued < count)
+            {
+                DLOGW("Queue is full, dropping %u packets", count - enqueued); // 队列已满，丢弃数据包
+                metrics_count(METRICS_PACKETS_QUEUE_FULL, count - enqueued);
+            }
+            DLOGV("%u of %u packets enqueued, current queue size: %d", enqueued, count, GetQueueSize());
+        }
+        METRICS_RECORD_SINCE(METRICS_STAGE_RECEIVE, batch_start_ns);
     }
-    pid_name[n] = '\0'; // 确保字符串以null结尾
-    fclose(fp);
-    return pid_name;
+
+out:
+    free(buffers);
+    free(msgs);
+    free(iovecs);
+    free(controls);
+    free(datas);
+    free(lens);
+    DLOGI("UDP server stopped.");
+    return NULL;
 }
 
 /**
  * @brief 解析消息
  * 
  * @param message 
- * @param dnsRet 
- * @param domain 
+ * @param dnsRet 至少64字节
+ * @param domain 至少128字节
  * @param uid 
  * @param pid 
  * @return int 
@@ -241,42 +417,73 @@ int PraseMessage(const char *message, char *dnsRet, char *domain, int *uid, int
 {
     // 使用sscanf提取内容，忽略分号后面的IP部分
     int result = sscanf(message, 
-                       "DnsRet:%[^,],domain:%[^,],UID:%d,PID:%d;",
+                       "DnsRet:%63[^,],domain:%127[^,],UID:%d,PID:%d;",
                        dnsRet, domain, uid, pid);
     int ret = 0;
     if (result != 4)
     {
-        printf("Failed to parse message: %s ret is %d\n", message,result);
+        DLOGD("Failed to parse message: %s ret is %d", message,result);
         ret =  1; // 返回-1表示解析失败
     }
     else
     {
-        printf("DnsRet: %s, Domain: %s, UID: %d, PID: %d\n", dnsRet, domain, *uid, *pid);
+        DLOGV("DnsRet: %s, Domain: %s, UID: %d, PID: %d", dnsRet, domain, *uid, *pid);
     }
     return ret; // 返回0表示解析成功
 }
 
 /**
- * @brief ip2region初始化函数
+ * @brief ip2region初始化函数，每个处理线程持有独立的查询对象
  * 
  * @return int 
  */
 int ip2region_init()
 {
-    // 初始化ip2region
-    v_index = xdb_load_vector_index_from_file(db_path);
-    if (v_index == NULL) {
-        printf("failed to load vector index from `%s`\n", db_path);
-        return 1;
+    // 1、按查询方式加载共享的只读缓存
+    if (xdb_mode == XDB_MODE_VECTOR_INDEX) {
+        v_index = xdb_load_vector_index_from_file(db_path);
+        if (v_index == NULL) {
+            DLOGE("failed to load vector index from `%s`", db_path);
+            return 1;
+        }
+    } else if (xdb_mode == XDB_MODE_BUFFER) {
+        c_buffer = xdb_load_content_from_file(db_path);
+        if (c_buffer == NULL) {
+            DLOGE("failed to load xdb content from `%s`", db_path);
+            return 1;
+        }
     }
 
-    // 2、使用全局的 VectorIndex 变量创建带 VectorIndex 缓存的 xdb 查询对象
-    int err = xdb_new_with_vector_index(&searcher, db_path, v_index);
-    if (err != 0) {
-        printf("failed to create vector index cached searcher with errcode=%d\n", err);
-        return 2;
+    // 2、创建 xdb 查询对象
+    // 查询对象内部有文件句柄和io计数，不能跨线程共享，VectorIndex 和内容缓存只读可以共享
+    for (int i = 0; i < worker_count; i++)
+    {
+        int err;
+        switch (xdb_mode)
+        {
+        case XDB_MODE_FILE_ONLY:
+            err = xdb_new_with_file_only(&workers[i].searcher, db_path);
+            break;
+        case XDB_MODE_BUFFER:
+            err = xdb_new_with_buffer(&workers[i].searcher, c_buffer);
+            break;
+        case XDB_MODE_MMAP:
+            err = xdb_new_with_mmap(&workers[i].searcher, db_path);
+            break;
+        default:
+            err = xdb_new_with_vector_index(&workers[i].searcher, db_path, v_index);
+            break;
+        }
+        if (err != 0) {
+            DLOGE("failed to create %s searcher with errcode=%d", xdb_mode_names[xdb_mode], err);
+            return 2;
+        }
     }
-    printf("ip2region initialized successfully with database: %s\n", db_path);
+    // 3、编译国内/国外区间表，失败时退回按归属地字符串判断
+    if (region_table_init(db_path) != 0) {
+        DLOGW("failed to build region table from `%s`, fall back to region string matching", db_path);
+    }
+    DLOGI("ip2region initialized successfully with database: %s, mode: %s", db_path, xdb_mode_names[xdb_mode]);
     return 0; // 返回0表示初始化成功
 }
 
@@ -286,31 +493,55 @@ int ip2region_init()
  */
 void ip2region_deinit()
 {
-    xdb_close(&searcher);
-    xdb_close_vector_index(v_index);
+    region_table_deinit();
+    for (int i = 0; i < worker_count; i++)
+    {
+        xdb_close(&workers[i].searcher);
+    }
+    if (v_index != NULL)
+    {
+        xdb_close_vector_index(v_index);
+        v_index = NULL;
+    }
+    if (c_buffer != NULL)
+    {
+        xdb_close_content(c_buffer);
+        c_buffer = NULL;
+    }
 }
 
 /**
- * @brief 通过ip字符串查询IP归属地(是否为中国IP)
+ * @brief 查询IP归属地(是否为中国IP)
 
- * @param ip char* IP地址字符串
+ * @param searcher 调用线程自己的查询对象
+ * @param ip 主机字节序IPv4地址
  * @param is_china char* 返回值指针，设置为1表示是中国IP，0表示不是中国IP
  * @return int 
  */
-int search_ip_string(char* ip,char* is_china)
+int search_ip(xdb_searcher_t *searcher, uint32 ip, char* is_china)
 {
-    long s_time;
     char region_buffer[256] = {0};
-    s_time = xdb_now();
-    int err = xdb_search_by_string(&searcher, ip, region_buffer, sizeof(region_buffer));
+    char ip_str[IPV4_STRING_SIZE];
+    // 优先查预编译的区间表
+    if (region_table_lookup(ip, is_china) == 0)
+    {
+        if (DLOG_ON(DLOG_LEVEL_VERBOSE))
+        {
+            format_ipv4(ip, ip_str);
+            DLOGV("ip: %s, china: %d", ip_str, *is_china);
+        }
+        return 0;
+    }
+    int err = xdb_search(searcher, ip, region_buffer, sizeof(region_buffer));
+    format_ipv4(ip, ip_str);
     if(err != 0)
     {
-        printf("failed to search ip `%s` with errcode=%d\n", ip, err);
+        DLOGW("failed to search ip `%s` with errcode=%d", ip_str, err);
         return 1; // 返回1表示查询失败
     }
     else
     {
-        printf("ip: %s, region: %s, cost: %ld μs\n", ip, region_buffer, xdb_now() - s_time);
+        DLOGV("ip: %s, region: %s", ip_str, region_buffer);
         // 检查是否为中国IP
         if (strstr(region_buffer, "中国") != NULL)
         {
@@ -325,194 +556,892 @@ int search_ip_string(char* ip,char* is_china)
 }
 
 /**
- * @brief 处理数据的循环
+ * @brief 处理一条DNS上报
  * 
- * @param arg 
+ * @param worker 当前处理线程
+ * @param message 以null结尾的上报内容
  */
-void* main_loop(void *arg)
+static void process_message(dns_worker_t *worker, const char *message)
 {
-    (void)arg;
-    pthread_detach(pthread_self());   // 设置线程为分离状态
-    prctl(PR_SET_NAME, "Main_Loop"); // 设置线程名称为Main_Loop
-    while (1)
+    DLOGV("Worker %d processing data: %s", worker->id, message);
+    // 处理数据
+    char dnsRet[64] = {0};
+    char domain[128] = {0};
+    int uid = 0;
+    int pid = 0;
+    // 各阶段首尾相接，每个阶段只多读一次时钟
+    uint64 stage_start_ns = metrics_now_ns();
+    uint64 stage_end_ns;
+    int parse_ret = PraseMessage(message, dnsRet, domain, &uid, &pid);
+    stage_end_ns = metrics_now_ns();
+    metrics_record(METRICS_STAGE_PARSE, stage_end_ns - stage_start_ns);
+    metrics_count(METRICS_MESSAGES_PROCESSED, 1);
+    if (parse_ret != 0)
     {
-        struct List_Node *node = NULL;
-        ERROR_MESSAGE_T ret = BufferOutQueue(&node);
-        if (ret == BUF_EMPTY)
-        {
-            usleep(MAIN_FUNC_CYCLE); // 队列为空，等待100毫秒
-            continue;
-        }
-        else if (ret != SUCCESS)
+        metrics_count(METRICS_MESSAGES_MALFORMED, 1);
+    }
+    if(0 == parse_ret)
+    {
+        // 获取进程名称 
+        stage_start_ns = stage_end_ns;
+        const char *pid_name = pid_cache_lookup(worker->pid_cache, pid);
+        stage_end_ns = metrics_now_ns();
+        metrics_record(METRICS_STAGE_PID_LOOKUP, stage_end_ns - stage_start_ns);
+        DLOGV("Process name for PID %d: %s", pid, pid_name ? pid_name : "Unknown");
+        // 获取包名，进程已退出时也能得到
+        const char *package_name = package_table_lookup((uint32)uid);
+        // 提取IP
+        uint32 match_results[MAX_IP_ADDRESSES];
+        char ip_str[IPV4_STRING_SIZE];
+        stage_start_ns = metrics_now_ns();
+        int match_count = found_ip_addresses(message, match_results, MAX_IP_ADDRESSES);
+        stage_end_ns = metrics_now_ns();
+        metrics_record(METRICS_STAGE_IP_EXTRACT, stage_end_ns - stage_start_ns);
+        DLOGV("Found %d IP addresses:", match_count);
+        uint8 found_addr_count = 0;
+        uint8 found_index_array[MAX_IP_ADDRESSES] = {0}; // 用于记录找到的IP地址索引
+        // 查询归属地
+        for (int i = 0; i < match_count; i++)
         {
-            printf("Failed to dequeue data with error code: %d\n", ret);
-            continue;
-        }
-        printf("Dequeued data: %s\n", node->data);
-        // 处理数据
-        char dnsRet[64] = {0};
-        char domain[128] = {0};
-        int uid = 0;
-        int pid = 0;
-        if(0 == PraseMessage((const char *)node->data, dnsRet, domain, &uid, &pid))
-        {
-            // 获取进程名称 
-            char *pid_name = get_pid_name(pid);
-            printf("Process name for PID %d: %s\n", pid, pid_name ? pid_name : "Unknown");
-            // 提取IP
-            int match_count = 0;
-            char *match_results[32] = {0};
-            found_ip_addresses((const char *)node->data, &match_count, match_results);
-            printf("Found %d IP addresses:\n", match_count);
-            uint8 found_addr_count = 0;
-            uint8 found_index_array[32] = {0}; // 用于记录找到的IP地址索引
-            // 查询归属地
-            for (int i = 0; i < match_count; i++)
+            if (DLOG_ON(DLOG_LEVEL_DEBUG))
+            {
+                format_ipv4(match_results[i], ip_str); // 只有下面的日志用到
+            }
+            DLOGV("IP %d: %s", i + 1, ip_str);
+            char is_china = 0;
+            stage_start_ns = stage_end_ns;
+            int search_ret = search_ip(&worker->searcher, match_results[i], &is_china);
+            stage_end_ns = metrics_now_ns();
+            metrics_record(METRICS_STAGE_XDB_LOOKUP, stage_end_ns - stage_start_ns);
+            if( 0 == search_ret)
             {
-                printf("IP %d: %s\n", i + 1, match_results[i]);
-                char is_china = 0;
-                if( 0 == search_ip_string(match_results[i], &is_china))
+                if(is_china)
+                {
+                    DLOGV("IP %s is a China IP", ip_str);
+                    if(region == FOREIGN)
+                    {
+                        found_index_array[found_addr_count] = i; // 记录找到的IP地址索引
+                        found_addr_count++; 
+                    }   
+                }
+                else
                 {
-                    if(is_china)
+                    DLOGV("IP %s is not a China IP", ip_str);
+                    if(region != DOMESTIC)
                     {
-                        printf("IP %s is a China IP\n", match_results[i]);
-                        if(region == FOREIGN)
-                        {
-                            found_index_array[found_addr_count] = i; // 记录找到的IP地址索引
-                            found_addr_count++; 
-                        }   
+                        DLOGV("Skipping foreign IP %s as region is set to foreign", ip_str);
                     }
                     else
                     {
-                        printf("IP %s is not a China IP\n", match_results[i]);
-                        if(region != DOMESTIC)
-                        {
-                            printf("Skipping foreign IP %s as region is set to foreign\n", match_results[i]);
-                        }
-                        else
-                        {
-                            printf("IP %s is a domestic IP\n", match_results[i]);
-                            found_index_array[found_addr_count] = i; // 记录找到的IP地址索引
-                            found_addr_count++;
-                        }
+                        DLOGV("IP %s is a domestic IP", ip_str);
+                        found_index_array[found_addr_count] = i; // 记录找到的IP地址索引
+                        found_addr_count++;
                     }
                 }
-                else
-                {
-                    found_index_array[found_addr_count] = i; // 记录找到的IP地址索引
-                    found_addr_count++; 
-                    printf("Failed to search IP %s\n", match_results[i]);
-                }
             }
-            // 记录事件
-            if(found_addr_count > 0)
+            else
             {
-                printf("Found %d IP addresses matching the criteria:\n", found_addr_count);
-                cJSON* event = cJSON_CreateObject();
-                cJSON_AddStringToObject(event, "DnsRet", dnsRet);
-                cJSON_AddStringToObject(event, "Domain", domain);
-                cJSON_AddNumberToObject(event, "UID", uid);
-                cJSON_AddNumberToObject(event, "PID", pid);
-                cJSON_AddStringToObject(event, "ProcessName", pid_name ? pid_name : "Unknown");
-                cJSON* ip_array = cJSON_CreateArray();
-                for (int i = 0; i < found_addr_count; i++)
-                {
-                    int index = found_index_array[i];
-                    cJSON_AddItemToArray(ip_array, cJSON_CreateString(match_results[index]));
-                }
-                cJSON_AddItemToObject(event, "IPAddresses", ip_array);
-                char *event_str = cJSON_Print(event);
-                if (event_str)
+                found_index_array[found_addr_count] = i; // 记录找到的IP地址索引
+                found_addr_count++; 
+                DLOGD("Failed to search IP %s", ip_str);
+                metrics_count(METRICS_XDB_ERRORS, 1);
+            }
+        }
+        // 记录事件
+        if(found_addr_count > 0)
+        {
+            DLOGV("Found %d IP addresses matching the criteria:", found_addr_count);
+            // 事件直接编码到日志缓冲区中前缀之后，不分配内存也不再复制
+            char logbuf[SELOG_SINGLE_LOG_SIZE];
+            json_writer_t writer;
+            uint32 found_ips[MAX_IP_ADDRESSES];
+            stage_start_ns = metrics_now_ns();
+            memcpy(logbuf, EVENT_LOG_PREFIX, EVENT_LOG_PREFIX_LEN);
+            json_writer_init(&writer, logbuf + EVENT_LOG_PREFIX_LEN, sizeof(logbuf) - EVENT_LOG_PREFIX_LEN);
+            json_begin_object(&writer, NULL);
+            json_add_string(&writer, "DnsRet", dnsRet);
+            json_add_string(&writer, "Domain", domain);
+            json_add_int(&writer, "UID", uid);
+            json_add_int(&writer, "PID", pid);
+            json_add_string(&writer, "ProcessName", pid_name ? pid_name : "Unknown");
+            json_add_string(&writer, "PackageName", package_name ? package_name : "Unknown");
+            json_begin_array(&writer, "IPAddresses");
+            for (int i = 0; i < found_addr_count; i++)
+            {
+                int index = found_index_array[i];
+                found_ips[i] = match_results[index];
+                enforce_submit(match_results[index]); // 开启下发时交给下发线程攒批
+                format_ipv4(match_results[index], ip_str);
+                json_add_string(&writer, NULL, ip_str);
+            }
+            json_end_array(&writer);
+            json_end_object(&writer);
+            int event_len = json_writer_finish(&writer);
+            METRICS_RECORD_SINCE(METRICS_STAGE_JSON_ENCODE, stage_start_ns);
+            if (event_len >= 0)
+            {
+                const char *event_str = logbuf + EVENT_LOG_PREFIX_LEN;
+                DLOGV("Event JSON: %s", event_str);
+                if (worker->aggregator != NULL)
                 {
-                    printf("Event JSON: %s\n", event_str);
-                    log_write(SELOG_LOG_TYPE_SYSTEM, 1, 1, SELOG_LOG_LEVEL_MIDDLE, FALSE,
-                                "Event logged: %s", event_str); // 写入日志
-                    free(event_str); // 释放JSON字符串内存
+                    // 窗口内的重复事件只计数，窗口结束时输出一条
+                    uint64 key = aggregate_key(uid, pid_name, domain, found_ips, found_addr_count);
+                    aggregator_add(worker->aggregator, key, event_str, event_len, file_watch_now_ms());
                 }
                 else
                 {
-                    printf("Failed to create JSON string for event\n");
+                    log_write_event(0, logbuf, (uint32)(EVENT_LOG_PREFIX_LEN + event_len)); // 写入日志
                 }
             }
             else
             {
-                printf("No IP addresses matching the criteria were found\n");
+                DLOGW("Event too large for log buffer, dropped");
+                metrics_count(METRICS_EVENTS_DROPPED, 1);
             }
-            if (pid_name != NULL)
+        }
+        else
+        {
+            DLOGV("No IP addresses matching the criteria were found");
+        }
+    }
+}
+
+/**
+ * @brief 快速取出上报中的UID，用于把同一应用的事件分给同一个处理线程
+ * 
+ * @param message 
+ * @return unsigned int 解析失败返回0
+ */
+static unsigned int message_uid(const char *message)
+{
+    const char *p = strstr(message, ",UID:");
+    if (p == NULL)
+    {
+        return 0;
+    }
+    return (unsigned int)strtoul(p + 5, NULL, 10);
+}
+
+/**
+ * @brief 输出窗口已结束的合并事件，并计算下一次最多等待多久
+ *
+ * @param worker
+ * @param max_timeout_ms 没有合并中的事件时的等待时间
+ * @return int 毫秒
+ */
+static int worker_flush_events(dns_worker_t *worker, int max_timeout_ms)
+{
+    long long now_ms;
+
+    if (worker->aggregator == NULL)
+    {
+        return max_timeout_ms;
+    }
+    now_ms = file_watch_now_ms();
+    aggregator_flush(worker->aggregator, now_ms);
+    return aggregator_timeout(worker->aggregator, now_ms, max_timeout_ms);
+}
+
+/**
+ * @brief 处理线程循环，按顺序处理分发到自己队列中的上报
+ * @note 队列关闭后处理完剩余的上报再退出
+ * @param arg dns_worker_t*
+ */
+static void *worker_loop(void *arg)
+{
+    dns_worker_t *worker = (dns_worker_t *)arg;
+    char name[16] = {0};
+    snprintf(name, sizeof(name), "Dns_Worker_%d", worker->id);
+    prctl(PR_SET_NAME, name);
+    int timeout_ms = PID_CACHE_SWEEP_INTERVAL;
+    while (1)
+    {
+        struct List_Node *node = NULL;
+        if (RingQueuePopWait(worker->ring, &node, timeout_ms) != SUCCESS)
+        {
+            if (RingQueueIsClosed(worker->ring))
             {
-                free(pid_name); // 释放进程名称的内存
+                break; // 队列已关闭且已取完
             }
-            // 释放匹配结果的内存
-            for (int i = 0; i < match_count; i++)
+            pid_cache_sweep(worker->pid_cache); // 空闲时清理已退出的进程
+            timeout_ms = worker_flush_events(worker, PID_CACHE_SWEEP_INTERVAL);
+            continue;
+        }
+        METRICS_RECORD_SINCE(METRICS_STAGE_DISPATCH_WAIT, node->enqueue_ns);
+        process_message(worker, (const char *)node->data);
+        RingQueueRelease(worker->ring, node);
+        timeout_ms = worker_flush_events(worker, PID_CACHE_SWEEP_INTERVAL);
+    }
+    return NULL;
+}
+
+/**
+ * @brief 启动处理线程池，只有一个处理线程时由main_loop直接处理
+ * 
+ * @return int 
+ */
+static int worker_pool_start(void)
+{
+    // 总容量平分给各处理线程，容量小于线程数时每个至少1个槽位，不能传0退回默认容量
+    uint32 per_worker = queue_capacity / (uint32)worker_count;
+    if (worker_count <= 1)
+    {
+        return 0;
+    }
+    if (per_worker == 0)
+    {
+        per_worker = 1;
+    }
+    for (int i = 0; i < worker_count; i++)
+    {
+        RING_QUEUE_T *ring = RingQueueCreate(per_worker);
+        if (ring == NULL)
+        {
+            DLOGE("Failed to create queue for worker %d", i);
+            return 1;
+        }
+        // 控制线程可能同时在读队列统计
+        __atomic_store_n(&workers[i].ring, ring, __ATOMIC_RELEASE);
+        if (pthread_create(&workers[i].thread, NULL, worker_loop, &workers[i]) != 0)
+        {
+            DLOGE("Failed to create worker thread %d", i);
+            return 1;
+        }
+        workers_started = i + 1;
+    }
+    DLOGI("Started %d worker threads, queue capacity %u each", worker_count, workers[0].ring->capacity);
+    return 0;
+}
+
+/**
+ * @brief 把上报分发给处理线程，同一UID总是分到同一个线程以保证顺序
+ * 
+ * @param node 
+ */
+static void dispatch_message(const struct List_Node *node)
+{
+    dns_worker_t *worker = &workers[message_uid((const char *)node->data) % (unsigned int)worker_count];
+    // 队列满时睡眠到处理线程归还槽位，积压会反映到入口队列并在那里计入丢包
+    if (RingQueuePushWait(worker->ring, node->data, node->len, -1) != SUCCESS)
+    {
+        DLOGE("Failed to dispatch data to worker %d", worker->id);
+    }
+}
+
+/**
+ * @brief 处理数据的循环
+ * @note 只有一个处理线程时直接处理，否则按UID分发给处理线程池；
+ *       入口队列关闭后处理完剩余的上报再退出
+ * @param arg 
+ */
+static void *main_loop(void *arg)
+{
+    (void)arg;
+    prctl(PR_SET_NAME, "Main_Loop"); // 设置线程名称为Main_Loop
+    int timeout_ms = REGION_TABLE_CHECK_INTERVAL;
+    while (1)
+    {
+        struct List_Node *node = NULL;
+        // 队列中有数据时依次取完，只有队列为空时才阻塞等待生产者唤醒，
+        // 空闲时也定期醒来检查db文件是否更新，输出窗口已结束的合并事件
+        ERROR_MESSAGE_T ret = BufferOutQueueWait(&node, timeout_ms);
+        region_table_check_reload();
+        package_table_check_reload();
+        if (ret == BUF_EMPTY)
+        {
+            if (IsClosedQueue())
+            {
+                break; // 收包线程已停止且队列已取完
+            }
+            if (worker_count <= 1)
             {
-                free(match_results[i]); // 释放每个匹配结果的内存
+                pid_cache_sweep(workers[0].pid_cache); // 空闲时清理已退出的进程
+                timeout_ms = worker_flush_events(&workers[0], REGION_TABLE_CHECK_INTERVAL);
             }
+            continue;
+        }
+        else if (ret != SUCCESS)
+        {
+            DLOGE("Failed to dequeue data with error code: %d", ret);
+            continue;
+        }
+        METRICS_RECORD_SINCE(METRICS_STAGE_QUEUE_WAIT, node->enqueue_ns);
+        if (worker_count <= 1)
+        {
+            process_message(&workers[0], (const char *)node->data);
+            timeout_ms = worker_flush_events(&workers[0], REGION_TABLE_CHECK_INTERVAL);
         }
-        free(node); // 释放节点内存
-        usleep(MAIN_FUNC_CYCLE); 
+        else
+        {
+            dispatch_message(node);
+        }
+        BufferReleaseNode(node); // 归还队列槽位
     }
     return NULL;
 }
 
+/**
+ * @brief 请求停止，可在信号处理函数中调用
+ * @note 只置位标志并写eventfd，都是异步信号安全的操作
+ */
+static void dns_client_request_stop(void)
+{
+    int saved_errno = errno;
+    uint64_t one = 1;
+    __atomic_store_n(&stop_requested, 1, __ATOMIC_RELEASE);
+    if (stop_event_fd >= 0)
+    {
+        ssize_t ret = write(stop_event_fd, &one, sizeof(one)); // 只可能因计数溢出失败，已经可读
+        (void)ret;
+    }
+    errno = saved_errno;
+}
+
 /**
  * @brief 信号处理函数
- * 
+ * @note 只通知主线程，由主线程在dns_client_wait_stop返回后调用dns_client_shutdown
  * @param signal 
  */
 void Stop_And_Exit(int signal)
 {
-    printf("Received signal %d, stopping threads and exiting...\n", signal);
-    ip2region_deinit(); // 释放ip2region资源
-    destroy_regex(); // 销毁正则表达式匹配器
-    bufferDestroy(); // 销毁队列
-    log_deinit(); // 释放日志资源
-    exit(0); // 退出程序
+    (void)signal;
+    dns_client_request_stop();
+}
+
+/**
+ * @brief 启动收包、分发和处理线程
+ * @note 失败时已启动的线程由dns_client_shutdown停止
+ * @return int 0成功
+ */
+int dns_client_start(void)
+{
+    udp_server_fd = udp_server_socket();
+    if (udp_server_fd < 0)
+    {
+        return -1;
+    }
+    if (worker_pool_start() != 0)
+    {
+        return -1;
+    }
+    if (pthread_create(&main_thread, NULL, main_loop, NULL) != 0)
+    {
+        DLOGE("Failed to create main loop thread");
+        return -1;
+    }
+    main_thread_started = 1;
+    if (pthread_create(&udp_thread, NULL, udp_server_loop, NULL) != 0)
+    {
+        DLOGE("Failed to create UDP server thread");
+        return -1;
+    }
+    udp_thread_started = 1;
+    return 0;
+}
+
+/**
+ * @brief 阻塞到收到停止请求
+ */
+void dns_client_wait_stop(void)
+{
+    struct pollfd pfd = {.fd = stop_event_fd, .events = POLLIN, .revents = 0};
+    while (!__atomic_load_n(&stop_requested, __ATOMIC_ACQUIRE))
+    {
+        if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+        {
+            DLOGE("poll error: %s(errno: %d)", strerror(errno), errno);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief 有序退出，只能在普通线程中调用
+ * @note 先按数据流向依次停止并等待收包线程、main_loop和处理线程，处理完已收到的上报；
+ *       再输出合并中的事件，停止控制、下发和日志写入线程，最后释放资源
+ */
+void dns_client_shutdown(void)
+{
+    dns_client_request_stop();
+    DLOGI("Stopping threads and exiting...");
+    // 1、停止收包，此后入口队列不再有新数据
+    if (udp_server_fd >= 0)
+    {
+        shutdown(udp_server_fd, SHUT_RD); // 唤醒阻塞在recvmmsg中的线程
+    }
+    if (udp_thread_started)
+    {
+        pthread_join(udp_thread, NULL);
+        udp_thread_started = 0;
+    }
+    if (udp_server_fd >= 0)
+    {
+        close(udp_server_fd);
+        udp_server_fd = -1;
+    }
+    // 2、main_loop取完入口队列后退出，处理线程再取完各自的队列后退出
+    BufferCloseQueue();
+    if (main_thread_started)
+    {
+        pthread_join(main_thread, NULL);
+        main_thread_started = 0;
+    }
+    for (int i = 0; i < workers_started; i++)
+    {
+        RingQueueClose(workers[i].ring);
+    }
+    for (int i = 0; i < workers_started; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+    }
+    workers_started = 0;
+    // 3、输出合并中的事件，之后不再有线程提交日志和下发
+    for (int i = 0; i < worker_count; i++)
+    {
+        if (workers[i].aggregator != NULL)
+        {
+            aggregator_flush_all(workers[i].aggregator);
+        }
+    }
+    control_stop(); // 关闭控制socket，之后没有线程读取队列统计
+    enforce_stop(); // 下发剩余的IP
+    log_deinit(); // 写完剩余的日志
+    // 4、释放资源
+    ip2region_deinit();
+    package_table_deinit();
+    bufferDestroy();
+    for (int i = 0; i < MAX_WORKERS; i++)
+    {
+        RingQueueDestroy(workers[i].ring); // 控制线程已停止，不再有人读取队列统计
+        workers[i].ring = NULL;
+        if (workers[i].aggregator != NULL)
+        {
+            aggregator_destroy(workers[i].aggregator);
+            workers[i].aggregator = NULL;
+        }
+        if (workers[i].pid_cache != NULL)
+        {
+            pid_cache_destroy(workers[i].pid_cache);
+            workers[i].pid_cache = NULL;
+        }
+    }
+    // stop_event_fd随进程退出关闭，之后再来的信号仍可安全写入
+}
+
+/**
+ * @brief 汇总所有处理线程的进程名缓存统计
+ * 
+ * @param stats 
+ */
+void dns_client_get_pid_cache_stats(pid_cache_stats_t *stats)
+{
+    memset(stats, 0, sizeof(pid_cache_stats_t));
+    for (int i = 0; i < worker_count; i++)
+    {
+        pid_cache_stats_t worker_stats;
+        if (workers[i].pid_cache == NULL)
+        {
+            continue;
+        }
+        pid_cache_get_stats(workers[i].pid_cache, &worker_stats);
+        stats->hits += worker_stats.hits;
+        stats->misses += worker_stats.misses;
+        stats->reused += worker_stats.reused;
+        stats->evictions += worker_stats.evictions;
+    }
+}
+
+/**
+ * @brief 取队列深度和丢包统计
+ *
+ * @param ingress 入口队列
+ * @param dispatch 所有处理线程队列之和，high_water取最大值；只有一个处理线程时全为0
+ */
+void dns_client_get_queue_stats(QUEUE_STATS_T *ingress, QUEUE_STATS_T *dispatch)
+{
+    GetQueueStats(ingress);
+    memset(dispatch, 0, sizeof(QUEUE_STATS_T));
+    for (int i = 0; i < worker_count; i++)
+    {
+        QUEUE_STATS_T worker_stats;
+        RING_QUEUE_T *ring = __atomic_load_n(&workers[i].ring, __ATOMIC_ACQUIRE);
+        if (ring == NULL)
+        {
+            continue;
+        }
+        RingQueueGetStats(ring, &worker_stats);
+        dispatch->capacity += worker_stats.capacity;
+        dispatch->size += worker_stats.size;
+        dispatch->enqueued += worker_stats.enqueued;
+        dispatch->dequeued += worker_stats.dequeued;
+        dispatch->dropped += worker_stats.dropped;
+        if (worker_stats.high_water > dispatch->high_water)
+        {
+            dispatch->high_water = worker_stats.high_water;
+        }
+    }
+}
+
+/**
+ * @brief 汇总所有处理线程的事件合并统计
+ *
+ * @param stats
+ */
+void dns_client_get_aggregate_stats(aggregate_stats_t *stats)
+{
+    memset(stats, 0, sizeof(aggregate_stats_t));
+    for (int i = 0; i < worker_count; i++)
+    {
+        aggregate_stats_t worker_stats;
+        if (workers[i].aggregator == NULL)
+        {
+            continue;
+        }
+        aggregator_get_stats(workers[i].aggregator, &worker_stats);
+        stats->collapsed += worker_stats.collapsed;
+        stats->emitted += worker_stats.emitted;
+        stats->evicted += worker_stats.evicted;
+    }
+}
+
+static void control_add_queue_stats(control_output_t *out, const char *name, const QUEUE_STATS_T *stats)
+{
+    control_section_begin(out, name);
+    control_add_uint(out, "capacity", stats->capacity);
+    control_add_uint(out, "size", stats->size);
+    control_add_uint(out, "high_water", stats->high_water);
+    control_add_uint(out, "enqueued", stats->enqueued);
+    control_add_uint(out, "dequeued", stats->dequeued);
+    control_add_uint(out, "dropped", stats->dropped);
+    control_section_end(out);
+}
+
+/**
+ * @brief 控制命令stats：流水线计数、队列、日志写入、下发和事件合并
+ */
+static void control_stats(control_output_t *out)
+{
+    metrics_snapshot_t snapshot;
+    QUEUE_STATS_T ingress;
+    QUEUE_STATS_T dispatch;
+    log_writer_stats_t log_stats;
+
+    metrics_snapshot(&snapshot);
+    control_section_begin(out, "counters");
+    for (int i = 0; i < METRICS_COUNTER_COUNT; i++)
+    {
+        control_add_uint(out, metrics_counter_name((metrics_counter_t)i), snapshot.counters[i]);
+    }
+    control_section_end(out);
+
+    dns_client_get_queue_stats(&ingress, &dispatch);
+    control_add_queue_stats(out, "ingress_queue", &ingress);
+    if (worker_count > 1)
+    {
+        control_add_queue_stats(out, "dispatch_queue", &dispatch);
+    }
+
+    log_writer_get_stats(&log_stats);
+    control_section_begin(out, "log_writer");
+    control_add_uint(out, "submitted", log_stats.submitted);
+    control_add_uint(out, "written", log_stats.written);
+    control_add_uint(out, "write_failures", log_stats.write_failures);
+    control_add_uint(out, "dropped_oldest", log_stats.dropped_oldest);
+    control_add_uint(out, "dropped_newest", log_stats.dropped_newest);
+    control_add_uint(out, "blocked", log_stats.blocked);
+    control_add_uint(out, "high_water", log_stats.high_water);
+    control_section_end(out);
+
+    if (enforce_backend != NULL)
+    {
+        enforce_stats_t enforce_stats;
+        enforce_get_stats(&enforce_stats);
+        control_section_begin(out, "enforce");
+        control_add_string(out, "backend", enforce_backend->name);
+        control_add_uint(out, "submitted", enforce_stats.submitted);
+        control_add_uint(out, "added", enforce_stats.added);
+        control_add_uint(out, "skipped", enforce_stats.skipped);
+        control_add_uint(out, "expired", enforce_stats.expired);
+        control_add_uint(out, "dropped", enforce_stats.dropped);
+        control_add_uint(out, "failures", enforce_stats.failures);
+        control_section_end(out);
+    }
+
+    if (aggregate_window > 0)
+    {
+        aggregate_stats_t aggregate_stats;
+        dns_client_get_aggregate_stats(&aggregate_stats);
+        control_section_begin(out, "aggregate");
+        control_add_uint(out, "window_ms", (uint64)aggregate_window);
+        control_add_uint(out, "collapsed", aggregate_stats.collapsed);
+        control_add_uint(out, "emitted", aggregate_stats.emitted);
+        control_add_uint(out, "evicted", aggregate_stats.evicted);
+        control_section_end(out);
+    }
+}
+
+/**
+ * @brief 控制命令histograms：各阶段的延迟分布，单位纳秒
+ */
+static void control_histograms(control_output_t *out)
+{
+    metrics_snapshot_t snapshot;
+
+    metrics_snapshot(&snapshot);
+    for (int i = 0; i < METRICS_STAGE_COUNT; i++)
+    {
+        const metrics_histogram_t *histogram = &snapshot.stages[i];
+        control_section_begin(out, metrics_stage_name((metrics_stage_t)i));
+        control_add_uint(out, "count", histogram->count);
+        control_add_uint(out, "sum_ns", histogram->sum_ns);
+        control_add_uint(out, "max_ns", histogram->max_ns);
+        control_add_uint(out, "p50_ns", metrics_percentile(histogram, 50));
+        control_add_uint(out, "p90_ns", metrics_percentile(histogram, 90));
+        control_add_uint(out, "p99_ns", metrics_percentile(histogram, 99));
+        control_add_uint_array(out, "buckets", histogram->buckets, METRICS_HISTOGRAM_BUCKETS);
+        control_section_end(out);
+    }
+}
+
+/**
+ * @brief 控制命令cache：进程名缓存和包名表
+ */
+static void control_cache(control_output_t *out)
+{
+    pid_cache_stats_t pid_stats;
+    package_table_stats_t package_stats;
+
+    dns_client_get_pid_cache_stats(&pid_stats);
+    control_section_begin(out, "pid_cache");
+    control_add_uint(out, "hits", pid_stats.hits);
+    control_add_uint(out, "misses", pid_stats.misses);
+    control_add_uint(out, "reused", pid_stats.reused);
+    control_add_uint(out, "evictions", pid_stats.evictions);
+    control_section_end(out);
+
+    package_table_get_stats(&package_stats);
+    control_section_begin(out, "package_table");
+    control_add_uint(out, "packages", package_stats.packages);
+    control_add_uint(out, "reloads", package_stats.reloads);
+    control_section_end(out);
 }
 
+static const control_command_t control_commands[] = {
+    {"stats", "pipeline counters, queues, log writer, enforcement and aggregation", control_stats},
+    {"histograms", "per-stage latency histograms in nanoseconds", control_histograms},
+    {"cache", "pid cache and package table", control_cache},
+};
+
 void set_region(char new_region)
 {
     region = new_region; // 设置新的区域
-    printf("Region set to: %s\n", (region == DOMESTIC) ? "Domestic" : "Foreign");
+    DLOGI("Region set to: %s", (region == DOMESTIC) ? "Domestic" : "Foreign");
 }
 
 void set_db_path(char *new_db_path)
 {
     if (new_db_path == NULL || strlen(new_db_path) == 0)
     {
-        printf("Invalid database path\n");
+        DLOGW("Invalid database path");
         return;
     }
     db_path = new_db_path; // 设置新的数据库路径
-    printf("Database path set to: %s\n", db_path);
+    DLOGI("Database path set to: %s", db_path);
 }
 
 void set_log_path(char *new_log_path)
 {
     if (new_log_path == NULL || strlen(new_log_path) == 0)
     {
-        printf("Invalid log path\n");
+        DLOGW("Invalid log path");
         return;
     }
     log_path = new_log_path; // 设置新的日志路径
-    printf("Log path set to: %s\n", log_path);
+    DLOGI("Log path set to: %s", log_path);
+}
+
+void set_package_list_path(char *new_package_list_path)
+{
+    if (new_package_list_path == NULL || strlen(new_package_list_path) == 0)
+    {
+        DLOGW("Invalid package list path");
+        return;
+    }
+    package_list_path = new_package_list_path; // 设置新的包列表路径
+    DLOGI("Package list path set to: %s", package_list_path);
+}
+
+void set_enforce_backend(const enforce_backend_t *new_enforce_backend)
+{
+    enforce_backend = new_enforce_backend; // 设置新的下发后端
+    DLOGI("Enforcement backend set to: %s", enforce_backend ? enforce_backend->name : "none");
+}
+
+void set_enforce_ttl(int new_enforce_ttl)
+{
+    if (new_enforce_ttl <= 0)
+    {
+        DLOGW("Invalid enforcement ttl %d", new_enforce_ttl);
+        return;
+    }
+    enforce_ttl = new_enforce_ttl;
+    DLOGI("Enforcement ttl set to: %ds", enforce_ttl);
+}
+
+void set_aggregate_window(int new_aggregate_window)
+{
+    if (new_aggregate_window < 0)
+    {
+        DLOGW("Invalid aggregation window %d", new_aggregate_window);
+        return;
+    }
+    aggregate_window = new_aggregate_window;
+    DLOGI("Aggregation window set to: %dms", aggregate_window);
+}
+
+void set_control_socket_path(const char *new_control_socket_path)
+{
+    if (new_control_socket_path == NULL)
+    {
+        DLOGW("Invalid control socket path");
+        return;
+    }
+    control_socket_path = (strcmp(new_control_socket_path, "off") == 0) ? NULL : new_control_socket_path;
+    DLOGI("Control socket set to: %s", control_socket_path ? control_socket_path : "off");
+}
+
+void set_log_overflow_policy(const char *new_log_overflow_policy)
+{
+    if (new_log_overflow_policy == NULL ||
+        log_overflow_policy_parse(new_log_overflow_policy, &log_overflow_policy) != 0)
+    {
+        DLOGW("Invalid log overflow policy, must be drop-oldest, drop-newest or block");
+        return;
+    }
+    DLOGI("Log overflow policy set to: %s", log_overflow_policy_name(log_overflow_policy));
+}
+
+void set_recv_batch(int new_recv_batch)
+{
+    if (new_recv_batch < 1 || new_recv_batch > MAX_RECV_BATCH)
+    {
+        DLOGW("Invalid receive batch size %d, must be 1-%d", new_recv_batch, MAX_RECV_BATCH);
+        return;
+    }
+    recv_batch = new_recv_batch;
+    DLOGI("Receive batch size set to: %d", recv_batch);
+}
+
+void set_recv_buffer_size(int new_recv_buffer_size)
+{
+    if (new_recv_buffer_size < 0)
+    {
+        DLOGW("Invalid receive buffer size %d", new_recv_buffer_size);
+        return;
+    }
+    recv_buffer_size = new_recv_buffer_size;
+    DLOGI("Receive buffer size set to: %d", recv_buffer_size);
+}
+
+void set_queue_capacity(int new_queue_capacity)
+{
+    if (new_queue_capacity < 1)
+    {
+        DLOGW("Invalid queue capacity %d", new_queue_capacity);
+        return;
+    }
+    queue_capacity = (uint32)new_queue_capacity;
+    DLOGI("Queue capacity set to: %u", queue_capacity);
+}
+
+void set_xdb_mode(const char *new_xdb_mode)
+{
+    if (new_xdb_mode == NULL)
+    {
+        DLOGW("Invalid xdb mode");
+        return;
+    }
+    for (int i = 0; i < (int)(sizeof(xdb_mode_names) / sizeof(xdb_mode_names[0])); i++)
+    {
+        if (strcmp(new_xdb_mode, xdb_mode_names[i]) == 0)
+        {
+            xdb_mode = i;
+            DLOGI("Xdb mode set to: %s", xdb_mode_names[xdb_mode]);
+            return;
+        }
+    }
+    DLOGW("Invalid xdb mode %s, must be file, vector, buffer or mmap", new_xdb_mode);
+}
+
+void set_worker_count(int new_worker_count)
+{
+    if (new_worker_count < 1 || new_worker_count > MAX_WORKERS)
+    {
+        DLOGW("Invalid worker count %d, must be 1-%d", new_worker_count, MAX_WORKERS);
+        return;
+    }
+    worker_count = new_worker_count;
+    DLOGI("Worker count set to: %d", worker_count);
 }
 
 int dns_client_init()
 {
-    // 初始化正则表达式匹配器
-    InitializeRegex();
+    stop_event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (stop_event_fd < 0)
+    {
+        DLOGE("eventfd error: %s(errno: %d)", strerror(errno), errno);
+        return 5;
+    }
+    for (int i = 0; i < MAX_WORKERS; i++)
+    {
+        workers[i].id = i;
+    }
+    for (int i = 0; i < worker_count; i++)
+    {
+        workers[i].pid_cache = pid_cache_create();
+        if (workers[i].pid_cache == NULL)
+        {
+            DLOGE("Failed to create pid cache for worker %d", i);
+            return 3;
+        }
+        if (aggregate_window > 0)
+        {
+            workers[i].aggregator = aggregator_create(aggregate_window, log_event);
+            if (workers[i].aggregator == NULL)
+            {
+                DLOGE("Failed to create aggregator for worker %d", i);
+                return 3;
+            }
+        }
+    }
     // 初始化队列
     Queue_Init();
     // 初始化ip2region
     if (ip2region_init() != 0) {
-        printf("Failed to initialize ip2region\n");
+        DLOGE("Failed to initialize ip2region");
         return 1; // 初始化失败
     }
+    // 加载包列表，失败时事件中的包名为Unknown，文件出现后会自动加载
+    if (package_table_init(package_list_path) != 0) {
+        DLOGW("Failed to load package list %s", package_list_path);
+    }
+    // 启动下发线程
+    if (enforce_backend != NULL) {
+        if (enforce_init(enforce_backend, (uint32)enforce_ttl) != 0 || enforce_start() != 0) {
+            DLOGE("Failed to start enforcement");
+            return 4;
+        }
+    }
     // 初始化日志库
     if (log_init(log_path) != 0) {
-        printf("Failed to initialize log library\n");
+        DLOGE("Failed to initialize log library");
         return 2; // 日志库初始化失败
     }
+    // 控制socket只用于查看统计，失败不影响运行
+    if (control_socket_path != NULL &&
+        control_start(control_socket_path, control_commands, sizeof(control_commands) / sizeof(control_commands[0])) != 0) {
+        DLOGW("Failed to start control socket %s", control_socket_path);
+    }
     return 0; // 成功
 }
 
@@ -526,7 +1455,6 @@ int dns_client_init()
  */
 int main()
 {
-    InitializeRegex(); // 初始化正则表达式匹配器
     Queue_Init(); // 初始化队列
     if (ip2region_init() != 0) {
         printf("Failed to initialize ip2region\n");
@@ -17,17 +17,36 @@ extern "C"
 #endif
 #include "queue.h"
 #include "selog.h"
+#include "pid_cache.h"
+#include "enforce.h"
+#include "aggregate.h"
 
 #define boolean unsigned char
 int dns_client_init();
 uint8 log_write(Selog_LogType type, uint16 eventid, uint16 user_eventid, Selog_LogLevelType level, boolean urgent_flag,
                 const char *format, ...);
+int PraseMessage(const char *message, char *dnsRet, char *domain, int *uid, int *pid);
 void set_db_path(char *new_db_path);
 void set_region(char new_region);
 void set_log_path(char *new_log_path);
+void set_log_overflow_policy(const char *new_log_overflow_policy);
+void set_package_list_path(char *new_package_list_path);
+void set_recv_batch(int new_recv_batch);
+void set_recv_buffer_size(int new_recv_buffer_size);
+void set_queue_capacity(int new_queue_capacity);
+void set_worker_count(int new_worker_count);
+void set_xdb_mode(const char *new_xdb_mode);
+void set_enforce_backend(const enforce_backend_t *new_enforce_backend);
+void set_enforce_ttl(int new_enforce_ttl);
+void set_aggregate_window(int new_aggregate_window);
+void set_control_socket_path(const char *new_control_socket_path);
 void Stop_And_Exit(int signal);
-void *udp_server_loop(void *arg);
-void* main_loop(void *arg);
+int dns_client_start(void);
+void dns_client_wait_stop(void);
+void dns_client_shutdown(void);
+void dns_client_get_pid_cache_stats(pid_cache_stats_t *stats);
+void dns_client_get_aggregate_stats(aggregate_stats_t *stats);
+void dns_client_get_queue_stats(QUEUE_STATS_T *ingress, QUEUE_STATS_T *dispatch);
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,476 @@
+/**
+ * @file enforce.c
+ * @brief 把匹配区域策略的IP带TTL下发到内核集合
+ * @note 处理线程只把IP放入等待队列，由下发线程攒批：TTL剩余过半的IP不重复下发，
+ *       过期的IP按批删除，后端可以替换，本地后端不需要root权限，便于测试
+ * @version 0.1
+ * @date 2025-08-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/prctl.h>
+#include <time.h>
+#include "file_watch.h"
+#include "dlog.h"
+#include "enforce.h"
+
+#define enforce_count(counter, n) __atomic_fetch_add(&(counter), (n), __ATOMIC_RELAXED)
+
+static const enforce_backend_t *backend = NULL;
+static long long ttl_ms = ENFORCE_DEFAULT_TTL * 1000LL;
+static enforce_table_t table; // 已下发的IP，只由下发线程访问
+static enforce_stats_t stats;
+static long long next_sweep_ms = 0;
+
+static pthread_mutex_t pending_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pending_cond = PTHREAD_COND_INITIALIZER;
+static uint32 pending[ENFORCE_MAX_PENDING];
+static int pending_count = 0;
+static uint32 draining[ENFORCE_MAX_PENDING];
+static int running = 0;
+static pthread_t enforce_thread;
+
+/*******************************IP表**********************************/
+
+static inline uint32 enforce_hash(uint32 ip)
+{
+    return ip * 2654435761U;
+}
+
+int enforce_table_init(enforce_table_t *t, uint32 capacity)
+{
+    uint32 size = 16;
+    while (size < capacity)
+    {
+        size <<= 1;
+    }
+    t->entries = (enforce_entry_t *)calloc(size, sizeof(enforce_entry_t));
+    if (t->entries == NULL)
+    {
+        return -1;
+    }
+    t->mask = size - 1;
+    t->count = 0;
+    return 0;
+}
+
+void enforce_table_free(enforce_table_t *t)
+{
+    free(t->entries);
+    t->entries = NULL;
+    t->count = 0;
+}
+
+enforce_entry_t *enforce_table_find(enforce_table_t *t, uint32 ip)
+{
+    for (uint32 i = enforce_hash(ip) & t->mask; t->entries[i].expire_ms != 0; i = (i + 1) & t->mask)
+    {
+        if (t->entries[i].ip == ip)
+        {
+            return &t->entries[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 插入IP，已存在时返回原表项
+ * @note 装载因子超过0.5时扩容，之前返回的表项指针失效
+ * @return enforce_entry_t* 新表项的expire_ms需要调用者设置为非0；内存不足返回NULL
+ */
+enforce_entry_t *enforce_table_insert(enforce_table_t *t, uint32 ip)
+{
+    enforce_entry_t *entry = enforce_table_find(t, ip);
+    if (entry != NULL)
+    {
+        return entry;
+    }
+    if ((t->count + 1) * 2 > t->mask + 1)
+    {
+        enforce_table_t bigger;
+        if (enforce_table_init(&bigger, (t->mask + 1) * 2) != 0)
+        {
+            return NULL;
+        }
+        for (uint32 i = 0; i <= t->mask; i++)
+        {
+            if (t->entries[i].expire_ms != 0)
+            {
+                *enforce_table_insert(&bigger, t->entries[i].ip) = t->entries[i];
+            }
+        }
+        free(t->entries);
+        *t = bigger;
+    }
+    uint32 i = enforce_hash(ip) & t->mask;
+    while (t->entries[i].expire_ms != 0)
+    {
+        i = (i + 1) & t->mask;
+    }
+    t->entries[i].ip = ip;
+    t->count++;
+    return &t->entries[i];
+}
+
+/**
+ * @brief 删除表项，把后面同一探测链上的表项前移，不留墓碑
+ */
+void enforce_table_remove(enforce_table_t *t, enforce_entry_t *entry)
+{
+    uint32 i = (uint32)(entry - t->entries);
+    uint32 j = i;
+    while (1)
+    {
+        j = (j + 1) & t->mask;
+        if (t->entries[j].expire_ms == 0)
+        {
+            break;
+        }
+        uint32 home = enforce_hash(t->entries[j].ip) & t->mask;
+        // home不在(i, j]之间时，j上的表项可以移到i
+        if ((i <= j) ? (home <= i || home > j) : (home <= i && home > j))
+        {
+            t->entries[i] = t->entries[j];
+            i = j;
+        }
+    }
+    t->entries[i].expire_ms = 0;
+    t->count--;
+}
+
+/*******************************本地后端**********************************/
+
+static pthread_mutex_t local_mutex = PTHREAD_MUTEX_INITIALIZER;
+static enforce_table_t local_table;
+
+static int local_add(void *ctx, const uint32 *ips, int count, uint32 ttl)
+{
+    (void)ctx;
+    (void)ttl; // 过期由下发线程按批删除
+    int ret = 0;
+    pthread_mutex_lock(&local_mutex);
+    if (local_table.entries == NULL && enforce_table_init(&local_table, 64) != 0)
+    {
+        ret = -1;
+    }
+    for (int i = 0; i < count && ret == 0; i++)
+    {
+        enforce_entry_t *entry = enforce_table_insert(&local_table, ips[i]);
+        if (entry == NULL)
+        {
+            ret = -1;
+            break;
+        }
+        entry->expire_ms = 1;
+    }
+    pthread_mutex_unlock(&local_mutex);
+    return ret;
+}
+
+static int local_expire(void *ctx, const uint32 *ips, int count)
+{
+    (void)ctx;
+    pthread_mutex_lock(&local_mutex);
+    for (int i = 0; i < count && local_table.entries != NULL; i++)
+    {
+        enforce_entry_t *entry = enforce_table_find(&local_table, ips[i]);
+        if (entry != NULL)
+        {
+            enforce_table_remove(&local_table, entry);
+        }
+    }
+    pthread_mutex_unlock(&local_mutex);
+    return 0;
+}
+
+static const enforce_backend_t local_backend = {"local", local_add, local_expire, NULL, NULL};
+
+/**
+ * @brief 进程内的后端，只记录IP，不修改内核状态
+ */
+const enforce_backend_t *enforce_local_backend(void)
+{
+    return &local_backend;
+}
+
+/**
+ * @brief 查询本地后端中是否有该IP
+ */
+int enforce_local_contains(uint32 ip)
+{
+    pthread_mutex_lock(&local_mutex);
+    int found = local_table.entries != NULL && enforce_table_find(&local_table, ip) != NULL;
+    pthread_mutex_unlock(&local_mutex);
+    return found;
+}
+
+/*******************************下发**********************************/
+
+/**
+ * @brief 设置后端和TTL，并让后端创建空集合
+ * @note 引用集合的规则在集合创建之后才能加载，调用者需在加载规则文件之前调用
+ *
+ * @param new_backend 调用者保证在运行期间有效
+ * @param ttl 单位秒
+ * @return int 0成功
+ */
+int enforce_init(const enforce_backend_t *new_backend, uint32 ttl)
+{
+    if (new_backend == NULL || new_backend->add == NULL || ttl == 0)
+    {
+        return -1;
+    }
+    if (table.entries == NULL && enforce_table_init(&table, 1024) != 0)
+    {
+        return -1;
+    }
+    if (new_backend->create != NULL && new_backend->create(new_backend->ctx, ttl) != 0)
+    {
+        DLOGE("Failed to create the set of enforcement backend %s", new_backend->name);
+        return -1;
+    }
+    ttl_ms = ttl * 1000LL;
+    __atomic_store_n(&backend, new_backend, __ATOMIC_RELEASE);
+    DLOGI("Enforcement backend %s with ttl %us", new_backend->name, ttl);
+    return 0;
+}
+
+/**
+ * @brief 提交一个匹配策略的IP，由处理线程调用
+ */
+void enforce_submit(uint32 ip)
+{
+    if (__atomic_load_n(&backend, __ATOMIC_ACQUIRE) == NULL)
+    {
+        return;
+    }
+    pthread_mutex_lock(&pending_mutex);
+    if (pending_count >= ENFORCE_MAX_PENDING)
+    {
+        enforce_count(stats.dropped, 1);
+    }
+    else
+    {
+        pending[pending_count++] = ip;
+        enforce_count(stats.submitted, 1);
+        // 第一个IP到来时开始计时攒批，攒满一批时立即下发
+        if (pending_count == 1 || pending_count == ENFORCE_MAX_BATCH)
+        {
+            pthread_cond_signal(&pending_cond);
+        }
+    }
+    pthread_mutex_unlock(&pending_mutex);
+}
+
+static void enforce_flush_add(uint32 *batch, int *count)
+{
+    if (*count == 0)
+    {
+        return;
+    }
+    enforce_count(stats.batches, 1);
+    if (backend->add(backend->ctx, batch, *count, (uint32)(ttl_ms / 1000)) != 0)
+    {
+        // 下发失败的IP从表中删除，下次提交时重新下发
+        enforce_count(stats.failures, 1);
+        for (int i = 0; i < *count; i++)
+        {
+            enforce_entry_t *entry = enforce_table_find(&table, batch[i]);
+            if (entry != NULL)
+            {
+                enforce_table_remove(&table, entry);
+            }
+        }
+    }
+    else
+    {
+        enforce_count(stats.added, *count);
+    }
+    *count = 0;
+}
+
+static void enforce_sweep(long long now_ms)
+{
+    uint32 batch[ENFORCE_MAX_BATCH];
+    int count;
+    do
+    {
+        count = 0;
+        for (uint32 i = 0; i <= table.mask && count < ENFORCE_MAX_BATCH; i++)
+        {
+            if (table.entries[i].expire_ms != 0 && table.entries[i].expire_ms <= now_ms)
+            {
+                batch[count++] = table.entries[i].ip;
+            }
+        }
+        for (int i = 0; i < count; i++)
+        {
+            enforce_table_remove(&table, enforce_table_find(&table, batch[i]));
+        }
+        if (count > 0)
+        {
+            enforce_count(stats.expired, count);
+            if (backend->expire != NULL && backend->expire(backend->ctx, batch, count) != 0)
+            {
+                enforce_count(stats.failures, 1);
+            }
+        }
+    } while (count == ENFORCE_MAX_BATCH);
+}
+
+/**
+ * @brief 下发等待中的IP并删除过期的IP
+ * @note 只能由一个线程调用，下发线程每次醒来调用一次，测试中可以直接调用
+ * @param now_ms 当前时间
+ */
+void enforce_process(long long now_ms)
+{
+    uint32 batch[ENFORCE_MAX_BATCH];
+    int batch_count = 0;
+    int count;
+
+    if (__atomic_load_n(&backend, __ATOMIC_ACQUIRE) == NULL)
+    {
+        return;
+    }
+    pthread_mutex_lock(&pending_mutex);
+    count = pending_count;
+    memcpy(draining, pending, count * sizeof(uint32));
+    pending_count = 0;
+    pthread_mutex_unlock(&pending_mutex);
+
+    for (int i = 0; i < count; i++)
+    {
+        enforce_entry_t *entry = enforce_table_find(&table, draining[i]);
+        if (entry != NULL && entry->expire_ms - now_ms > ttl_ms / 2)
+        {
+            enforce_count(stats.skipped, 1);
+            continue;
+        }
+        if (entry == NULL)
+        {
+            entry = enforce_table_insert(&table, draining[i]);
+            if (entry == NULL)
+            {
+                enforce_count(stats.dropped, 1);
+                continue;
+            }
+        }
+        entry->expire_ms = now_ms + ttl_ms;
+        batch[batch_count++] = draining[i];
+        if (batch_count == ENFORCE_MAX_BATCH)
+        {
+            enforce_flush_add(batch, &batch_count);
+        }
+    }
+    enforce_flush_add(batch, &batch_count);
+
+    if (now_ms >= next_sweep_ms)
+    {
+        next_sweep_ms = now_ms + ENFORCE_SWEEP_INTERVAL;
+        enforce_sweep(now_ms);
+    }
+}
+
+static void deadline_after(struct timespec *deadline, long long ms)
+{
+    clock_gettime(CLOCK_REALTIME, deadline);
+    deadline->tv_sec += ms / 1000;
+    deadline->tv_nsec += (ms % 1000) * 1000000;
+    if (deadline->tv_nsec >= 1000000000)
+    {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000;
+    }
+}
+
+static void *enforce_loop(void *arg)
+{
+    (void)arg;
+    struct timespec deadline;
+    prctl(PR_SET_NAME, "Enforce");
+    pthread_mutex_lock(&pending_mutex);
+    while (running)
+    {
+        if (pending_count == 0)
+        {
+            // 空闲时等待第一个IP，或到时间检查过期
+            deadline_after(&deadline, ENFORCE_SWEEP_INTERVAL);
+            pthread_cond_timedwait(&pending_cond, &pending_mutex, &deadline);
+        }
+        if (pending_count > 0)
+        {
+            // 攒批，直到攒满一批或超过攒批时间
+            deadline_after(&deadline, ENFORCE_FLUSH_INTERVAL);
+            while (pending_count < ENFORCE_MAX_BATCH && running &&
+                   pthread_cond_timedwait(&pending_cond, &pending_mutex, &deadline) == 0)
+            {
+            }
+        }
+        pthread_mutex_unlock(&pending_mutex);
+        enforce_process(file_watch_now_ms());
+        pthread_mutex_lock(&pending_mutex);
+    }
+    pthread_mutex_unlock(&pending_mutex);
+    return NULL;
+}
+
+/**
+ * @brief 启动下发线程
+ */
+int enforce_start(void)
+{
+    if (backend == NULL)
+    {
+        return -1;
+    }
+    running = 1;
+    if (pthread_create(&enforce_thread, NULL, enforce_loop, NULL) != 0)
+    {
+        running = 0;
+        DLOGE("Failed to create enforcement thread");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 停止下发线程，等待中的IP在退出前下发
+ * @note 要加锁并等待下发线程退出，只能在普通线程中调用，不能在信号处理函数或后端回调中调用；
+ *       调用前提交IP的线程应已停止
+ */
+void enforce_stop(void)
+{
+    pthread_mutex_lock(&pending_mutex);
+    if (running && pthread_equal(pthread_self(), enforce_thread))
+    {
+        pthread_mutex_unlock(&pending_mutex);
+        DLOGE("enforce_stop must not be called from the enforcement thread");
+        return;
+    }
+    int was_running = running;
+    running = 0;
+    pthread_cond_signal(&pending_cond);
+    pthread_mutex_unlock(&pending_mutex);
+    if (was_running)
+    {
+        pthread_join(enforce_thread, NULL);
+        enforce_process(file_watch_now_ms());
+    }
+}
+
+void enforce_get_stats(enforce_stats_t *out)
+{
+    out->submitted = __atomic_load_n(&stats.submitted, __ATOMIC_RELAXED);
+    out->added = __atomic_load_n(&stats.added, __ATOMIC_RELAXED);
+    out->skipped = __atomic_load_n(&stats.skipped, __ATOMIC_RELAXED);
+    out->expired = __atomic_load_n(&stats.expired, __ATOMIC_RELAXED);
+    out->dropped = __atomic_load_n(&stats.dropped, __ATOMIC_RELAXED);
+    out->batches = __atomic_load_n(&stats.batches, __ATOMIC_RELAXED);
+    out->failures = __atomic_load_n(&stats.failures, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,82 @@
+/**
+ * @file enforce.h
+ * @brief 把匹配区域策略的IP带TTL下发到内核集合
+ * @version 0.1
+ * @date 2025-08-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#ifndef ENFORCE_H
+#define ENFORCE_H
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include "queue.h"
+
+#define ENFORCE_SET_NAME "oemfw_dns"   // 规则文件通过 -m set --match-set oemfw_dns dst 引用
+#define ENFORCE_DEFAULT_TTL 300        // 默认TTL，单位秒
+#define ENFORCE_MAX_BATCH 256          // 单次下发的最大IP数
+#define ENFORCE_MAX_PENDING 4096       // 等待下发的最大IP数，超出时丢弃
+#define ENFORCE_FLUSH_INTERVAL 20      // 攒批的最长时间，单位毫秒，应用通常在解析后立即连接
+#define ENFORCE_SWEEP_INTERVAL 1000    // 检查过期的间隔，单位毫秒
+
+// 下发后端，函数返回0表示成功
+typedef struct enforce_backend
+{
+    const char *name;
+    // 添加或刷新一批IP，ttl秒后过期
+    int (*add)(void *ctx, const uint32 *ips, int count, uint32 ttl);
+    // 删除一批已过期的IP；为NULL表示后端自行按TTL过期(例如ipset的timeout)
+    int (*expire)(void *ctx, const uint32 *ips, int count);
+    // 创建空集合，由enforce_init调用；规则文件引用该集合，必须在加载规则之前创建。为NULL表示无需创建
+    int (*create)(void *ctx, uint32 ttl);
+    void *ctx;
+} enforce_backend_t;
+
+// 已下发的IP及其过期时间，开放寻址
+typedef struct enforce_entry
+{
+    uint32 ip;
+    long long expire_ms; // 0表示空槽位
+} enforce_entry_t;
+
+typedef struct enforce_table
+{
+    enforce_entry_t *entries;
+    uint32 mask;
+    uint32 count;
+} enforce_table_t;
+
+typedef struct enforce_stats
+{
+    uint64 submitted; // 提交的IP数
+    uint64 added;     // 下发(含刷新TTL)的IP数
+    uint64 skipped;   // TTL剩余过半无需刷新的IP数
+    uint64 expired;   // 过期的IP数
+    uint64 dropped;   // 等待队列满丢弃的IP数
+    uint64 batches;   // 下发批次数
+    uint64 failures;  // 下发失败的批次数
+} enforce_stats_t;
+
+int enforce_table_init(enforce_table_t *table, uint32 capacity);
+void enforce_table_free(enforce_table_t *table);
+enforce_entry_t *enforce_table_find(enforce_table_t *table, uint32 ip);
+enforce_entry_t *enforce_table_insert(enforce_table_t *table, uint32 ip);
+void enforce_table_remove(enforce_table_t *table, enforce_entry_t *entry);
+
+const enforce_backend_t *enforce_local_backend(void);
+int enforce_local_contains(uint32 ip);
+
+int enforce_init(const enforce_backend_t *backend, uint32 ttl);
+int enforce_start(void);
+void enforce_stop(void);
+void enforce_submit(uint32 ip);
+void enforce_process(long long now_ms);
+void enforce_get_stats(enforce_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
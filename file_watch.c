@@ -0,0 +1,76 @@
+/**
+ * @file file_watch.c
+ * @brief 配置/数据文件变化检测
+ * @version 0.1
+ * @date 2025-08-04
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#include <string.h>
+#include <sys/stat.h>
+#include "file_watch.h"
+
+/**
+ * @brief 当前单调时间，单位毫秒，使用COARSE时钟走vDSO，不陷入内核
+ *
+ * @return long long
+ */
+long long file_watch_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief 记录文件当前状态
+ *
+ * @param watch
+ * @param path 文件路径，调用者保证在watch使用期间有效
+ * @param interval_ms 两次检查之间的最小间隔
+ */
+void file_watch_init(file_watch_t *watch, const char *path, int interval_ms)
+{
+    struct stat st;
+    memset(watch, 0, sizeof(file_watch_t));
+    watch->path = path;
+    watch->interval_ms = interval_ms;
+    watch->next_check_ms = file_watch_now_ms() + interval_ms;
+    if (stat(path, &st) == 0)
+    {
+        watch->ino = st.st_ino;
+        watch->size = st.st_size;
+        watch->mtime = st.st_mtim;
+    }
+}
+
+/**
+ * @brief 检查文件是否变化(mtime、大小或inode不同)
+ * @note 未到检查间隔时直接返回0；文件暂时不存在(例如正在被替换)不算变化
+ * @param watch
+ * @return int 1表示变化，并更新记录的状态
+ */
+int file_watch_changed(file_watch_t *watch)
+{
+    struct stat st;
+    long long now = file_watch_now_ms();
+    if (now < watch->next_check_ms)
+    {
+        return 0;
+    }
+    watch->next_check_ms = now + watch->interval_ms;
+    if (stat(watch->path, &st) != 0)
+    {
+        return 0;
+    }
+    if (st.st_ino == watch->ino && st.st_size == watch->size &&
+        st.st_mtim.tv_sec == watch->mtime.tv_sec && st.st_mtim.tv_nsec == watch->mtime.tv_nsec)
+    {
+        return 0;
+    }
+    watch->ino = st.st_ino;
+    watch->size = st.st_size;
+    watch->mtime = st.st_mtim;
+    return 1;
+}
@@ -0,0 +1,37 @@
+/**
+ * @file file_watch.h
+ * @brief 配置/数据文件变化检测
+ * @version 0.1
+ * @date 2025-08-04
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#ifndef FILE_WATCH_H
+#define FILE_WATCH_H
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <time.h>
+#include <sys/types.h>
+
+// 文件状态快照，按间隔限频stat，避免在热路径上频繁系统调用
+typedef struct file_watch
+{
+    const char *path;
+    int interval_ms;        // 两次stat之间的最小间隔
+    long long next_check_ms; // 下次允许stat的时间
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+} file_watch_t;
+
+void file_watch_init(file_watch_t *watch, const char *path, int interval_ms);
+int file_watch_changed(file_watch_t *watch);
+long long file_watch_now_ms(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
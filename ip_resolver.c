@@ -1,158 +1,146 @@
-#include <pcre2.h>
+/**
+ * @file ip_resolver.c
+ * @brief 从DNS上报中提取IPv4地址
+ * @note 单遍扫描分号之后的IP段，直接把点分十进制解析为整数，
+ *       不做正则匹配，不分配内存
+ * @version 0.2
+ * @date 2025-07-15
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
 #include <stdio.h>
 #include <string.h>
-#define MATCH_IPV4 "((2(5[0-5]|[0-4]\\d))|[0-1]?\\d{1,2})(\\.((2(5[0-5]|[0-4]\\d))|[0-1]?\\d{1,2})){3}"
 #include "ip_resolver.h"
 
+#define IP_SECTION_DELIMITER ';'
 
-// 正则表达式匹配结构体
-typedef struct {
-    pcre2_code *re;
-    pcre2_match_data *match_data;
-} RegexMatcher;
-
-RegexMatcher matcher = {0};
-static unsigned char initialized = 0;
-
-// 
 /**
- * @brief 初始化正则表达式匹配器
- * 
- * @param matcher 
- * @param pattern 
- * @return int 
+ * @brief 解析IP段中的一个地址
+ *
+ * @param p 地址起始位置
+ * @param end 输出，地址之后的位置（分隔符或字符串结尾）
+ * @param ip 输出，主机字节序地址
+ * @return int 1表示是合法的点分十进制IPv4地址
  */
-int regex_init(RegexMatcher *matcher, const char *pattern) {
-    int error_number;
-    PCRE2_SIZE error_offset;
-
-    // 编译正则表达式
-    matcher->re = pcre2_compile(
-        (PCRE2_SPTR)pattern,
-        PCRE2_ZERO_TERMINATED,
-        0,
-        &error_number,
-        &error_offset,
-        NULL
-    );
-
-    if (matcher->re == NULL) {
-        PCRE2_UCHAR buffer[256];
-        pcre2_get_error_message(error_number, buffer, sizeof(buffer));
-        fprintf(stderr, "PCRE2 compilation failed at offset %d: %s\n", 
-                (int)error_offset, buffer);
-        return 0;
+static int parse_ipv4(const char *p, const char **end, uint32 *ip)
+{
+    uint32 value = 0;
+    uint32 octet = 0;
+    int octets = 0;
+    int digits = 0;
+    int valid = 1;
+
+    for (;; p++)
+    {
+        unsigned char c = (unsigned char)*p;
+        if (c >= '0' && c <= '9')
+        {
+            octet = octet * 10 + (c - '0');
+            if (++digits > 3 || octet > 255)
+            {
+                valid = 0;
+            }
+        }
+        else if (c == '.')
+        {
+            if (digits == 0 || ++octets > 3)
+            {
+                valid = 0;
+            }
+            value = (value << 8) | octet;
+            octet = 0;
+            digits = 0;
+        }
+        else if (c == ',' || c == IP_SECTION_DELIMITER || c == ' ' || c == '\0' || c == '\r' || c == '\n')
+        {
+            break;
+        }
+        else
+        {
+            // IPv6 或其他内容，整段跳过
+            valid = 0;
+        }
     }
 
-    // 准备匹配数据
-    matcher->match_data = pcre2_match_data_create_from_pattern(matcher->re, NULL);
-    if (matcher->match_data == NULL) {
-        fprintf(stderr, "Failed to create match data\n");
-        pcre2_code_free(matcher->re);
+    *end = p;
+    if (!valid || octets != 3 || digits == 0)
+    {
         return 0;
     }
-    initialized = 1;
+    *ip = (value << 8) | octet;
     return 1;
 }
 
 /**
- * @brief 释放正则表达式匹配器资源
- * 
- * @param matcher 
- * @return * void 
- */
-void regex_free(RegexMatcher *matcher) {
-    if (matcher->re) {
-        pcre2_code_free(matcher->re);
-        matcher->re = NULL;
-    }
-    if (matcher->match_data) {
-        pcre2_match_data_free(matcher->match_data);
-        matcher->match_data = NULL;
-    }
-}
-
-/**
- * @brief 初始化正则表达式匹配器
- * 
+ * @brief 查找IP地址
+ * @note 示例消息 DnsRet:success,domain:域名,UID:UID,PID:pid;114.114.114.114,8.8.8.8;
+ *       只扫描第一个分号之后、下一个分号之前的IP段
+ * @param subject 输入字符串
+ * @param ips 输出，主机字节序地址数组
+ * @param max_ips 数组容量，超出部分忽略
+ * @return int 找到的地址个数
  */
-void InitializeRegex()
+int found_ip_addresses(const char *subject, uint32 *ips, int max_ips)
 {
-    if (!initialized) {
-        if (!regex_init(&matcher, MATCH_IPV4)) {
-            fprintf(stderr, "Failed to initialize regex matcher\n");
-            exit(EXIT_FAILURE);
+    int count = 0;
+    const char *p = strchr(subject, IP_SECTION_DELIMITER);
+    if (p == NULL)
+    {
+        return 0;
+    }
+    p++;
+
+    while (*p != '\0' && *p != IP_SECTION_DELIMITER && count < max_ips)
+    {
+        const char *end = p;
+        if (parse_ipv4(p, &end, &ips[count]))
+        {
+            count++;
+        }
+        p = end;
+        if (*p == ',' || *p == ' ' || *p == '\r' || *p == '\n')
+        {
+            p++;
         }
     }
+    return count;
 }
 
 /**
- * @brief 销毁正则表达式匹配器资源
- * 
+ * @brief 把地址格式化为点分十进制
+ *
+ * @param ip 主机字节序地址
+ * @param buffer 至少IPV4_STRING_SIZE字节
+ * @return int 字符串长度
  */
-void destroy_regex()
+int format_ipv4(uint32 ip, char *buffer)
 {
-    regex_free(&matcher);
-}
-
-/**
- * @brief  使用正则表达式查找所有匹配的IP地址
- * 
- * @param matcher 
- * @param subject 
- * @param match_count 
- * @param match_results 
- */
-void regex_find_all(RegexMatcher *matcher, const char *subject,int* match_count,char* match_results[]) {
-    size_t subject_len = strlen(subject);
-    unsigned int offset = 0;
-    int rc;
-    PCRE2_SIZE *ovector;
-
-    printf("Searching in: %s\n", subject);
-
-    while (offset < subject_len) {
-        rc = pcre2_match(
-            matcher->re,
-            (PCRE2_SPTR)subject,
-            subject_len,
-            offset,
-            0,
-            matcher->match_data,
-            NULL
-        );
-
-        if (rc < 0) {
-            if (rc == PCRE2_ERROR_NOMATCH) {
-                break;
-            }
-            fprintf(stderr, "Matching error %d\n", rc);
-            break;
+    char *p = buffer;
+    for (int shift = 24; shift >= 0; shift -= 8)
+    {
+        uint32 octet = (ip >> shift) & 0xFF;
+        if (octet >= 100)
+        {
+            *p++ = (char)('0' + octet / 100);
+            octet %= 100;
+            *p++ = (char)('0' + octet / 10);
+            *p++ = (char)('0' + octet % 10);
+        }
+        else if (octet >= 10)
+        {
+            *p++ = (char)('0' + octet / 10);
+            *p++ = (char)('0' + octet % 10);
+        }
+        else
+        {
+            *p++ = (char)('0' + octet);
+        }
+        if (shift > 0)
+        {
+            *p++ = '.';
         }
-
-        ovector = pcre2_get_ovector_pointer(matcher->match_data);
-        printf("Found match: %.*s at position %d-%d\n",
-               (int)(ovector[1] - ovector[0]),
-               subject + ovector[0],
-               (int)ovector[0],
-               (int)ovector[1]);
-        match_results[*match_count] = strndup(subject + ovector[0], ovector[1] - ovector[0]);
-        (*match_count)++;
-        offset = ovector[1]; // 移动到下一个匹配位置
     }
+    *p = '\0';
+    return (int)(p - buffer);
 }
-
-/**
- * @brief 查找IP地址
- * 
- * @param subject 输入字符串
- * @param match_count 匹配数量
- * @param match_results 匹配结果数组
- */
-void found_ip_addresses(const char *subject, int *match_count, char *match_results[]) {
-    if (initialized) {
-        regex_find_all(&matcher, subject, match_count, match_results);
-    } else {
-        fprintf(stderr, "Failed to initialize regex matcher\n");
-    }
-}
\ No newline at end of file
@@ -2,7 +2,7 @@
  * @file ip_resolver.h
  * @author your name (you@domain.com)
  * @brief 
- * @version 0.1
+ * @version 0.2
  * @date 2025-07-15
  * 
  * @copyright Copyright (c) 2025
@@ -10,14 +10,19 @@
  */
 #ifndef IP_RESOLVER_H
 #define IP_RESOLVER_H
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include "queue.h"
 
+#define MAX_IP_ADDRESSES 32 // 单条上报最多处理的IP个数
+#define IPV4_STRING_SIZE 16 // 点分十进制字符串长度，含结束符
 
+int found_ip_addresses(const char *subject, uint32 *ips, int max_ips);
+int format_ipv4(uint32 ip, char *buffer);
 
-void InitializeRegex();
-void destroy_regex();
-void found_ip_addresses(const char *subject, int *match_count, char *match_results[]);
-
-
-
-
-#endif // IP_RESOLVER_H
\ No newline at end of file
+#ifdef __cplusplus
+}
+#endif
+#endif // IP_RESOLVER_H
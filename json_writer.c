@@ -0,0 +1,218 @@
+/**
+ * @file json_writer.c
+ * @brief 直接写入调用者缓冲区的JSON编码器，不分配内存
+ * @note 替代每个事件都要建cJSON树、格式化输出再复制一次的做法
+ * @version 0.1
+ * @date 2025-08-25
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#include <string.h>
+#include "json_writer.h"
+
+static const char hex_digits[] = "0123456789abcdef";
+
+/**
+ * @brief 初始化
+ *
+ * @param w
+ * @param buf 输出缓冲区，json_writer_finish后以'\0'结尾
+ * @param cap 缓冲区大小，包含结束符
+ */
+void json_writer_init(json_writer_t *w, char *buf, size_t cap)
+{
+    w->buf = buf;
+    w->cap = cap;
+    w->len = 0;
+    w->depth = 0;
+    w->overflow = (buf == NULL || cap == 0);
+    w->has_item[0] = 0;
+}
+
+static void json_put(json_writer_t *w, const char *data, size_t len)
+{
+    // 留一个字节给结束符
+    if (w->overflow || w->len + len >= w->cap)
+    {
+        w->overflow = 1;
+        return;
+    }
+    memcpy(w->buf + w->len, data, len);
+    w->len += len;
+}
+
+static void json_putc(json_writer_t *w, char c)
+{
+    if (w->overflow || w->len + 1 >= w->cap)
+    {
+        w->overflow = 1;
+        return;
+    }
+    w->buf[w->len++] = c;
+}
+
+/**
+ * @brief 写入带引号的字符串，转义引号、反斜杠和控制字符，其他字节原样输出
+ */
+static void json_put_string(json_writer_t *w, const char *s)
+{
+    const char *run = s;
+
+    json_putc(w, '"');
+    for (; *s != '\0'; s++)
+    {
+        unsigned char c = (unsigned char)*s;
+        char esc[6];
+        size_t esc_len = 2;
+
+        if (c >= 0x20 && c != '"' && c != '\\')
+        {
+            continue;
+        }
+        json_put(w, run, s - run);
+        run = s + 1;
+        esc[0] = '\\';
+        switch (c)
+        {
+        case '"': esc[1] = '"'; break;
+        case '\\': esc[1] = '\\'; break;
+        case '\b': esc[1] = 'b'; break;
+        case '\f': esc[1] = 'f'; break;
+        case '\n': esc[1] = 'n'; break;
+        case '\r': esc[1] = 'r'; break;
+        case '\t': esc[1] = 't'; break;
+        default:
+            esc[1] = 'u';
+            esc[2] = '0';
+            esc[3] = '0';
+            esc[4] = hex_digits[c >> 4];
+            esc[5] = hex_digits[c & 0xf];
+            esc_len = 6;
+            break;
+        }
+        json_put(w, esc, esc_len);
+    }
+    json_put(w, run, s - run);
+    json_putc(w, '"');
+}
+
+/**
+ * @brief 写入元素前的逗号和键
+ *
+ * @param key 数组元素或顶层值为NULL
+ */
+static void json_put_key(json_writer_t *w, const char *key)
+{
+    if (w->has_item[w->depth])
+    {
+        json_putc(w, ',');
+    }
+    w->has_item[w->depth] = 1;
+    if (key != NULL)
+    {
+        json_put_string(w, key);
+        json_putc(w, ':');
+    }
+}
+
+static void json_begin(json_writer_t *w, const char *key, char open)
+{
+    json_put_key(w, key);
+    json_putc(w, open);
+    if (w->depth + 1 >= JSON_WRITER_MAX_DEPTH)
+    {
+        w->overflow = 1;
+        return;
+    }
+    w->has_item[++w->depth] = 0;
+}
+
+static void json_end(json_writer_t *w, char close)
+{
+    if (w->depth > 0)
+    {
+        w->depth--;
+    }
+    json_putc(w, close);
+}
+
+void json_begin_object(json_writer_t *w, const char *key)
+{
+    json_begin(w, key, '{');
+}
+
+void json_end_object(json_writer_t *w)
+{
+    json_end(w, '}');
+}
+
+void json_begin_array(json_writer_t *w, const char *key)
+{
+    json_begin(w, key, '[');
+}
+
+void json_end_array(json_writer_t *w)
+{
+    json_end(w, ']');
+}
+
+/**
+ * @brief 写入字符串成员
+ *
+ * @param w
+ * @param key 数组元素为NULL
+ * @param value NULL时写null
+ */
+void json_add_string(json_writer_t *w, const char *key, const char *value)
+{
+    json_put_key(w, key);
+    if (value == NULL)
+    {
+        json_put(w, "null", 4);
+        return;
+    }
+    json_put_string(w, value);
+}
+
+/**
+ * @brief 写入整数成员
+ */
+void json_add_int(json_writer_t *w, const char *key, long long value)
+{
+    char digits[24];
+    int pos = sizeof(digits);
+    unsigned long long v = (value < 0) ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+
+    json_put_key(w, key);
+    do
+    {
+        digits[--pos] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+    if (value < 0)
+    {
+        digits[--pos] = '-';
+    }
+    json_put(w, digits + pos, sizeof(digits) - pos);
+}
+
+/**
+ * @brief 结束编码，写入结束符
+ *
+ * @param w
+ * @return int 输出长度，不包含结束符；缓冲区不够时返回-1
+ */
+int json_writer_finish(json_writer_t *w)
+{
+    if (w->overflow)
+    {
+        if (w->cap > 0)
+        {
+            w->buf[0] = '\0';
+        }
+        return -1;
+    }
+    w->buf[w->len] = '\0';
+    return (int)w->len;
+}
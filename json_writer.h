@@ -0,0 +1,43 @@
+/**
+ * @file json_writer.h
+ * @brief 直接写入调用者缓冲区的JSON编码器，不分配内存
+ * @version 0.1
+ * @date 2025-08-25
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stddef.h>
+
+#define JSON_WRITER_MAX_DEPTH 8 // 最大嵌套层数
+
+// 输出紧凑格式，缓冲区不够时置overflow，之后的写入都被忽略
+typedef struct json_writer
+{
+    char *buf;
+    size_t cap;
+    size_t len;
+    int depth;
+    int overflow;
+    unsigned char has_item[JSON_WRITER_MAX_DEPTH]; // 当前层是否已有元素，决定是否写逗号
+} json_writer_t;
+
+void json_writer_init(json_writer_t *w, char *buf, size_t cap);
+void json_begin_object(json_writer_t *w, const char *key);
+void json_end_object(json_writer_t *w);
+void json_begin_array(json_writer_t *w, const char *key);
+void json_end_array(json_writer_t *w);
+void json_add_string(json_writer_t *w, const char *key, const char *value);
+void json_add_int(json_writer_t *w, const char *key, long long value);
+int json_writer_finish(json_writer_t *w);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
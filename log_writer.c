@@ -0,0 +1,276 @@
+/**
+ * @file log_writer.c
+ * @brief 异步Selog写入线程
+ * @note 处理线程只把日志复制进环形队列，由写入线程成批取出后调用Selog_Write，
+ *       存储慢时不会阻塞DNS处理流程(阻塞策略除外)；
+ *       日志缓冲区在启动时一次分配，写入线程取出记录时用自己的空闲缓冲区和槽位交换，
+ *       提交和写入都不再分配内存
+ * @version 0.1
+ * @date 2025-08-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/prctl.h>
+#include "dlog.h"
+#include "metrics.h"
+#include "log_writer.h"
+
+static const char *policy_names[] = {"drop-oldest", "drop-newest", "block"};
+
+static pthread_mutex_t ring_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t not_empty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t not_full = PTHREAD_COND_INITIALIZER;
+static log_record_t *ring = NULL;
+static char *buffers = NULL; // capacity + LOG_WRITER_MAX_BATCH块日志缓冲区
+static log_record_t writer_batch[LOG_WRITER_MAX_BATCH]; // 写入线程取出的一批，各持有一块缓冲区
+static uint32 ring_capacity = 0;
+static uint32 ring_head = 0; // 下一条要写入的位置
+static uint32 ring_count = 0;
+static log_overflow_policy_t overflow_policy = LOG_OVERFLOW_DROP_OLDEST;
+static int running = 0;
+static pthread_t writer_thread;
+static selog_handle writer_handle = NULL;
+static log_writer_stats_t stats; // 在ring_mutex内更新，不加锁读取
+
+// 更新都在ring_mutex内，只需保证读取方看到完整的值
+#define log_stat_add(counter, n) __atomic_store_n(&(counter), (counter) + (n), __ATOMIC_RELAXED)
+
+static void *log_writer_loop(void *arg)
+{
+    (void)arg;
+    log_record_t *batch = writer_batch;
+    uint64 written = 0;
+    uint64 failures = 0;
+    prctl(PR_SET_NAME, "Log_Writer");
+    pthread_mutex_lock(&ring_mutex);
+    while (1)
+    {
+        log_stat_add(stats.written, written);
+        log_stat_add(stats.write_failures, failures);
+        written = 0;
+        failures = 0;
+        while (ring_count == 0 && running)
+        {
+            pthread_cond_wait(&not_empty, &ring_mutex);
+        }
+        if (ring_count == 0)
+        {
+            break; // 已停止且队列已排空
+        }
+        int count = 0;
+        while (ring_count > 0 && count < LOG_WRITER_MAX_BATCH)
+        {
+            uint32 tail = (ring_head + ring_capacity - ring_count) % ring_capacity;
+            char *spare = batch[count].data;
+            batch[count++] = ring[tail];
+            ring[tail].data = spare; // 换上空闲缓冲区，不复制日志内容
+            ring_count--;
+        }
+        log_stat_add(stats.batches, 1);
+        pthread_cond_broadcast(&not_full);
+        pthread_mutex_unlock(&ring_mutex);
+
+        for (int i = 0; i < count; i++)
+        {
+            uint64 start_ns = metrics_now_ns();
+            int ret = Selog_Write(writer_handle, batch[i].info, batch[i].data, batch[i].len);
+            METRICS_RECORD_SINCE(METRICS_STAGE_LOG_WRITE, start_ns);
+            if (ret != 0)
+            {
+                failures++;
+                DLOGW("Failed to write log: %s, error code: %d", batch[i].data, ret);
+            }
+            else
+            {
+                written++;
+                DLOGV("Log written successfully: %s", batch[i].data);
+            }
+        }
+        pthread_mutex_lock(&ring_mutex);
+    }
+    pthread_mutex_unlock(&ring_mutex);
+    return NULL;
+}
+
+/**
+ * @brief 启动写入线程
+ *
+ * @param handle 已初始化的Selog句柄
+ * @param capacity 等待写入的最大日志条数
+ * @param policy 队列满时的处理方式
+ * @return int 0成功
+ */
+int log_writer_start(selog_handle handle, uint32 capacity, log_overflow_policy_t policy)
+{
+    if (capacity == 0)
+    {
+        capacity = LOG_WRITER_DEFAULT_CAPACITY;
+    }
+    ring = (log_record_t *)calloc(capacity, sizeof(log_record_t));
+    buffers = (char *)malloc((size_t)(capacity + LOG_WRITER_MAX_BATCH) * (LOG_WRITER_SLOT_SIZE + 1));
+    if (ring == NULL || buffers == NULL)
+    {
+        free(ring);
+        free(buffers);
+        ring = NULL;
+        buffers = NULL;
+        return -1;
+    }
+    for (uint32 i = 0; i < capacity; i++)
+    {
+        ring[i].data = buffers + (size_t)i * (LOG_WRITER_SLOT_SIZE + 1);
+    }
+    for (uint32 i = 0; i < LOG_WRITER_MAX_BATCH; i++)
+    {
+        writer_batch[i].data = buffers + (size_t)(capacity + i) * (LOG_WRITER_SLOT_SIZE + 1);
+    }
+    ring_capacity = capacity;
+    ring_head = 0;
+    ring_count = 0;
+    overflow_policy = policy;
+    writer_handle = handle;
+    running = 1;
+    if (pthread_create(&writer_thread, NULL, log_writer_loop, NULL) != 0)
+    {
+        running = 0;
+        free(ring);
+        free(buffers);
+        ring = NULL;
+        buffers = NULL;
+        return -1;
+    }
+    DLOGI("Log writer started with capacity %u, overflow policy %s", capacity,
+           log_overflow_policy_name(policy));
+    return 0;
+}
+
+/**
+ * @brief 写完队列中剩余的日志后停止写入线程
+ * @note 要加锁并等待写入线程退出，只能在普通线程中调用，不能在信号处理函数或写入线程中调用；
+ *       调用前提交日志的线程应已停止，之后的log_submit返回-1
+ */
+void log_writer_stop(void)
+{
+    pthread_mutex_lock(&ring_mutex);
+    if (running && pthread_equal(pthread_self(), writer_thread))
+    {
+        pthread_mutex_unlock(&ring_mutex);
+        DLOGE("log_writer_stop must not be called from the writer thread");
+        return;
+    }
+    int was_running = running;
+    running = 0;
+    pthread_cond_broadcast(&not_empty);
+    pthread_cond_broadcast(&not_full);
+    pthread_mutex_unlock(&ring_mutex);
+    if (!was_running)
+    {
+        return;
+    }
+    pthread_join(writer_thread, NULL);
+    free(ring);
+    free(buffers);
+    ring = NULL;
+    buffers = NULL;
+    ring_capacity = 0;
+}
+
+/**
+ * @brief 提交一条日志，复制进队列槽位后立即返回
+ *
+ * @param info
+ * @param data
+ * @param len 不含结束符，最长LOG_WRITER_SLOT_SIZE
+ * @return int 0成功，日志过长、被丢弃或写入线程未运行返回-1
+ */
+int log_submit(const Selog_WriteStructType *info, const char *data, uint32 len)
+{
+    pthread_mutex_lock(&ring_mutex);
+    if (len > LOG_WRITER_SLOT_SIZE)
+    {
+        log_stat_add(stats.write_failures, 1); // Selog_Write同样会拒绝
+        pthread_mutex_unlock(&ring_mutex);
+        return -1;
+    }
+    if (ring_count == ring_capacity && running)
+    {
+        if (overflow_policy == LOG_OVERFLOW_BLOCK)
+        {
+            log_stat_add(stats.blocked, 1);
+            while (ring_count == ring_capacity && running)
+            {
+                pthread_cond_wait(&not_full, &ring_mutex);
+            }
+        }
+        else if (overflow_policy == LOG_OVERFLOW_DROP_OLDEST)
+        {
+            ring_count--; // 队列满时最早的一条就在ring_head，由本条覆盖
+            log_stat_add(stats.dropped_oldest, 1);
+        }
+    }
+    if (!running || ring_count == ring_capacity)
+    {
+        if (running)
+        {
+            log_stat_add(stats.dropped_newest, 1);
+        }
+        pthread_mutex_unlock(&ring_mutex);
+        return -1;
+    }
+    ring[ring_head].info = *info;
+    ring[ring_head].len = len;
+    memcpy(ring[ring_head].data, data, len);
+    ring[ring_head].data[len] = '\0';
+    ring_head = (ring_head + 1) % ring_capacity;
+    ring_count++;
+    log_stat_add(stats.submitted, 1);
+    if (ring_count > stats.high_water)
+    {
+        __atomic_store_n(&stats.high_water, ring_count, __ATOMIC_RELAXED);
+    }
+    pthread_cond_signal(&not_empty);
+    pthread_mutex_unlock(&ring_mutex);
+    return 0;
+}
+
+void log_writer_get_stats(log_writer_stats_t *out)
+{
+    out->submitted = __atomic_load_n(&stats.submitted, __ATOMIC_RELAXED);
+    out->written = __atomic_load_n(&stats.written, __ATOMIC_RELAXED);
+    out->write_failures = __atomic_load_n(&stats.write_failures, __ATOMIC_RELAXED);
+    out->dropped_oldest = __atomic_load_n(&stats.dropped_oldest, __ATOMIC_RELAXED);
+    out->dropped_newest = __atomic_load_n(&stats.dropped_newest, __ATOMIC_RELAXED);
+    out->blocked = __atomic_load_n(&stats.blocked, __ATOMIC_RELAXED);
+    out->batches = __atomic_load_n(&stats.batches, __ATOMIC_RELAXED);
+    out->high_water = __atomic_load_n(&stats.high_water, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief 解析队列满时的处理方式
+ *
+ * @param name drop-oldest、drop-newest或block
+ * @param policy 输出
+ * @return int 0成功
+ */
+int log_overflow_policy_parse(const char *name, log_overflow_policy_t *policy)
+{
+    for (int i = 0; i < (int)(sizeof(policy_names) / sizeof(policy_names[0])); i++)
+    {
+        if (strcmp(name, policy_names[i]) == 0)
+        {
+            *policy = (log_overflow_policy_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *log_overflow_policy_name(log_overflow_policy_t policy)
+{
+    return policy_names[policy];
+}
@@ -0,0 +1,61 @@
+/**
+ * @file log_writer.h
+ * @brief 异步Selog写入线程
+ * @version 0.1
+ * @date 2025-08-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#ifndef LOG_WRITER_H
+#define LOG_WRITER_H
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include "queue.h"
+#include "selog.h"
+
+#define LOG_WRITER_DEFAULT_CAPACITY 1024 // 等待写入的最大日志条数
+#define LOG_WRITER_MAX_BATCH 64          // 写入线程每次取出的最大条数
+#define LOG_WRITER_SLOT_SIZE SELOG_SINGLE_LOG_SIZE // 单条日志的最大长度，与Selog_Write的上限相同
+
+// 队列满时的处理方式
+typedef enum log_overflow_policy
+{
+    LOG_OVERFLOW_DROP_OLDEST, // 丢弃最早的一条，保留最新的日志
+    LOG_OVERFLOW_DROP_NEWEST, // 丢弃本条
+    LOG_OVERFLOW_BLOCK,       // 阻塞提交线程直到有空位
+} log_overflow_policy_t;
+
+// 每条记录固定持有一块LOG_WRITER_SLOT_SIZE + 1字节的预分配缓冲区
+typedef struct log_record
+{
+    Selog_WriteStructType info;
+    uint32 len;
+    char *data;
+} log_record_t;
+
+typedef struct log_writer_stats
+{
+    uint64 submitted;      // 提交的日志条数
+    uint64 written;        // 写入成功的条数
+    uint64 write_failures; // Selog_Write失败的条数
+    uint64 dropped_oldest; // 队列满时丢弃的最早日志条数
+    uint64 dropped_newest; // 队列满时丢弃的新日志条数
+    uint64 blocked;        // 提交线程因队列满而阻塞的次数
+    uint64 batches;        // 写入线程取出的批次数
+    uint32 high_water;     // 队列历史最大深度
+} log_writer_stats_t;
+
+int log_writer_start(selog_handle handle, uint32 capacity, log_overflow_policy_t policy);
+void log_writer_stop(void);
+int log_submit(const Selog_WriteStructType *info, const char *data, uint32 len);
+void log_writer_get_stats(log_writer_stats_t *stats);
+int log_overflow_policy_parse(const char *name, log_overflow_policy_t *policy);
+const char *log_overflow_policy_name(log_overflow_policy_t policy);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
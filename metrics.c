@@ -0,0 +1,188 @@
+/**
+ * @file metrics.c
+ * @brief DNS处理流水线各阶段的计数器和延迟直方图
+ * @note 每个线程写自己的槽位，只用relaxed的读和写，不加锁也没有原子加；
+ *       快照时把所有槽位加起来，读到的值可能相差正在进行的一次更新
+ * @version 0.1
+ * @date 2025-08-28
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#include <string.h>
+#include <time.h>
+#include "metrics.h"
+
+typedef struct metrics_slot
+{
+    uint64 counters[METRICS_COUNTER_COUNT];
+    metrics_histogram_t stages[METRICS_STAGE_COUNT];
+} __attribute__((aligned(QUEUE_CACHE_LINE))) metrics_slot_t;
+
+// 最后一个槽位给超出METRICS_MAX_THREADS的线程共用
+static metrics_slot_t metrics_slots[METRICS_MAX_THREADS + 1];
+static uint32 metrics_slot_count = 0;
+static __thread metrics_slot_t *metrics_local = NULL;
+
+static const char *metrics_stage_names[METRICS_STAGE_COUNT] = {
+    "receive", "queue_wait", "dispatch_wait", "parse", "pid_lookup",
+    "ip_extract", "xdb_lookup", "json_encode", "log_write",
+};
+
+static const char *metrics_counter_names[METRICS_COUNTER_COUNT] = {
+    "packets_received", "packets_too_long", "packets_queue_full", "packets_kernel_dropped",
+    "messages_processed", "messages_malformed", "xdb_errors", "events_logged", "events_dropped",
+};
+
+uint64 metrics_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64)ts.tv_sec * 1000000000ULL + (uint64)ts.tv_nsec;
+}
+
+static metrics_slot_t *metrics_thread_slot(void)
+{
+    if (unlikely(metrics_local == NULL))
+    {
+        uint32 index = __atomic_fetch_add(&metrics_slot_count, 1, __ATOMIC_RELAXED);
+        metrics_local = &metrics_slots[index < METRICS_MAX_THREADS ? index : METRICS_MAX_THREADS];
+    }
+    return metrics_local;
+}
+
+/**
+ * @brief 槽位独占时只有本线程写，普通的读加写即可；共用槽位要原子加
+ */
+static inline void metrics_add(metrics_slot_t *slot, uint64 *value, uint64 n)
+{
+    if (likely(slot != &metrics_slots[METRICS_MAX_THREADS]))
+    {
+        __atomic_store_n(value, __atomic_load_n(value, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+    }
+    else
+    {
+        __atomic_add_fetch(value, n, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief 增加计数
+ */
+void metrics_count(metrics_counter_t counter, uint64 n)
+{
+    metrics_slot_t *slot = metrics_thread_slot();
+    metrics_add(slot, &slot->counters[counter], n);
+}
+
+/**
+ * @brief 记录一次阶段耗时
+ *
+ * @param stage
+ * @param ns 纳秒
+ */
+void metrics_record(metrics_stage_t stage, uint64 ns)
+{
+    metrics_slot_t *slot = metrics_thread_slot();
+    metrics_histogram_t *histogram = &slot->stages[stage];
+    int bucket = (ns == 0) ? 0 : 64 - __builtin_clzll(ns);
+
+    if (bucket >= METRICS_HISTOGRAM_BUCKETS)
+    {
+        bucket = METRICS_HISTOGRAM_BUCKETS - 1;
+    }
+    metrics_add(slot, &histogram->count, 1);
+    metrics_add(slot, &histogram->sum_ns, ns);
+    metrics_add(slot, &histogram->buckets[bucket], 1);
+    // 共用槽位时最大值可能偶尔少记一次更新，不影响分布
+    if (ns > __atomic_load_n(&histogram->max_ns, __ATOMIC_RELAXED))
+    {
+        __atomic_store_n(&histogram->max_ns, ns, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief 汇总所有线程的计数，可以在任意线程调用
+ */
+void metrics_snapshot(metrics_snapshot_t *snapshot)
+{
+    uint32 used = __atomic_load_n(&metrics_slot_count, __ATOMIC_RELAXED);
+
+    memset(snapshot, 0, sizeof(metrics_snapshot_t));
+    for (uint32 s = 0; s <= METRICS_MAX_THREADS; s++)
+    {
+        const metrics_slot_t *slot = &metrics_slots[s];
+        if (s >= used && s < METRICS_MAX_THREADS)
+        {
+            continue;
+        }
+        for (int c = 0; c < METRICS_COUNTER_COUNT; c++)
+        {
+            snapshot->counters[c] += __atomic_load_n(&slot->counters[c], __ATOMIC_RELAXED);
+        }
+        for (int i = 0; i < METRICS_STAGE_COUNT; i++)
+        {
+            const metrics_histogram_t *from = &slot->stages[i];
+            metrics_histogram_t *to = &snapshot->stages[i];
+            uint64 max_ns = __atomic_load_n(&from->max_ns, __ATOMIC_RELAXED);
+            to->count += __atomic_load_n(&from->count, __ATOMIC_RELAXED);
+            to->sum_ns += __atomic_load_n(&from->sum_ns, __ATOMIC_RELAXED);
+            if (max_ns > to->max_ns)
+            {
+                to->max_ns = max_ns;
+            }
+            for (int b = 0; b < METRICS_HISTOGRAM_BUCKETS; b++)
+            {
+                to->buckets[b] += __atomic_load_n(&from->buckets[b], __ATOMIC_RELAXED);
+            }
+        }
+    }
+}
+
+/**
+ * @brief 估算百分位数
+ *
+ * @param histogram
+ * @param percentile 0-100
+ * @return uint64 所在桶的上界，纳秒，不超过记录到的最大值
+ */
+uint64 metrics_percentile(const metrics_histogram_t *histogram, double percentile)
+{
+    uint64 total = 0;
+    uint64 seen = 0;
+    uint64 rank;
+
+    for (int b = 0; b < METRICS_HISTOGRAM_BUCKETS; b++)
+    {
+        total += histogram->buckets[b];
+    }
+    if (total == 0)
+    {
+        return 0;
+    }
+    rank = (uint64)(total * percentile / 100.0 + 0.5);
+    if (rank == 0)
+    {
+        rank = 1;
+    }
+    for (int b = 0; b < METRICS_HISTOGRAM_BUCKETS; b++)
+    {
+        seen += histogram->buckets[b];
+        if (seen >= rank)
+        {
+            uint64 upper = (b == 0) ? 0 : (1ULL << b) - 1;
+            return (b == METRICS_HISTOGRAM_BUCKETS - 1 || upper > histogram->max_ns) ? histogram->max_ns : upper;
+        }
+    }
+    return histogram->max_ns;
+}
+
+const char *metrics_stage_name(metrics_stage_t stage)
+{
+    return (stage >= 0 && stage < METRICS_STAGE_COUNT) ? metrics_stage_names[stage] : "unknown";
+}
+
+const char *metrics_counter_name(metrics_counter_t counter)
+{
+    return (counter >= 0 && counter < METRICS_COUNTER_COUNT) ? metrics_counter_names[counter] : "unknown";
+}
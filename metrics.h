@@ -0,0 +1,78 @@
+/**
+ * @file metrics.h
+ * @brief DNS处理流水线各阶段的计数器和延迟直方图
+ * @version 0.1
+ * @date 2025-08-28
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#ifndef METRICS_H
+#define METRICS_H
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include "queue.h"
+
+#define METRICS_MAX_THREADS 32      // 独占槽位的线程数，之后的线程共用一个原子更新的槽位
+#define METRICS_HISTOGRAM_BUCKETS 32 // 第i个桶为[2^(i-1), 2^i)纳秒，最后一个桶包含更大的值
+
+// 各处理阶段
+typedef enum metrics_stage
+{
+    METRICS_STAGE_RECEIVE,       // 一批recvmmsg结果入队的耗时
+    METRICS_STAGE_QUEUE_WAIT,    // 在入口队列中等待的时间
+    METRICS_STAGE_DISPATCH_WAIT, // 多个处理线程时在处理线程队列中等待的时间
+    METRICS_STAGE_PARSE,         // 解析上报
+    METRICS_STAGE_PID_LOOKUP,    // 查询进程名
+    METRICS_STAGE_IP_EXTRACT,    // 提取IP
+    METRICS_STAGE_XDB_LOOKUP,    // 查询一个IP的归属地
+    METRICS_STAGE_JSON_ENCODE,   // 编码事件
+    METRICS_STAGE_LOG_WRITE,     // Selog_Write写入一条日志
+    METRICS_STAGE_COUNT
+} metrics_stage_t;
+
+typedef enum metrics_counter
+{
+    METRICS_PACKETS_RECEIVED,       // 收到的包
+    METRICS_PACKETS_TOO_LONG,       // 超长丢弃的包
+    METRICS_PACKETS_QUEUE_FULL,     // 入口队列满丢弃的包
+    METRICS_PACKETS_KERNEL_DROPPED, // socket缓冲区满被内核丢弃的包
+    METRICS_MESSAGES_PROCESSED,     // 处理的上报
+    METRICS_MESSAGES_MALFORMED,     // 解析失败的上报
+    METRICS_XDB_ERRORS,             // 归属地查询失败的IP
+    METRICS_EVENTS_LOGGED,          // 交给日志写入线程的事件
+    METRICS_EVENTS_DROPPED,         // 过长或日志队列拒绝的事件
+    METRICS_COUNTER_COUNT
+} metrics_counter_t;
+
+typedef struct metrics_histogram
+{
+    uint64 count;
+    uint64 sum_ns;
+    uint64 max_ns;
+    uint64 buckets[METRICS_HISTOGRAM_BUCKETS];
+} metrics_histogram_t;
+
+typedef struct metrics_snapshot
+{
+    uint64 counters[METRICS_COUNTER_COUNT];
+    metrics_histogram_t stages[METRICS_STAGE_COUNT];
+} metrics_snapshot_t;
+
+uint64 metrics_now_ns(void);
+void metrics_count(metrics_counter_t counter, uint64 n);
+void metrics_record(metrics_stage_t stage, uint64 ns);
+void metrics_snapshot(metrics_snapshot_t *snapshot);
+uint64 metrics_percentile(const metrics_histogram_t *histogram, double percentile);
+const char *metrics_stage_name(metrics_stage_t stage);
+const char *metrics_counter_name(metrics_counter_t counter);
+
+// 记录从start_ns到现在的耗时
+#define METRICS_RECORD_SINCE(stage, start_ns) metrics_record((stage), metrics_now_ns() - (start_ns))
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -16,9 +16,16 @@
 
 #define LOG_TAG "OemNetd"
 #include <log/log.h>
+#include <algorithm>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include "OemNetdListener.h"
 #include "NetdConstants.h"
+#include <android-base/file.h>
 #include <android-base/stringprintf.h>
+#include <android-base/strings.h>
 
 namespace com {
 namespace android {
@@ -86,23 +93,40 @@ std::string stringPrintf(const char* fmt, ...) {
     return result;
 }
 
-::android::String16 set_iptables_rule(int v4v6, int type, ::android::String16 rules) {
-    // iptables target
-    const char* target = (v4v6 == 0) ? "v4" : (v4v6 == 1) ? "v6" : "v4v6";
-    const char* table = (type == 0) ? "filter" : (type == 1) ? "nat" : "mangle";
+static IptablesTarget iptables_target(int v4v6) {
+    return (v4v6 == 0) ? V4 : (v4v6 == 1) ? V6 : V4V6;
+}
+
+// execIptablesRestore() feeds netd's IptablesRestoreController, which keeps long-lived
+// iptables-restore and ip6tables-restore processes, applies a timeout to every command
+// and restarts a process that died. Each call is therefore a pipe round trip, not a
+// fork. Ask for the output so a rejected rule is logged with the restore error.
+static int restore_iptables(int v4v6, const std::string& command) {
+    std::string output;
+    int ret = execIptablesRestoreWithOutput(iptables_target(v4v6), command, &output);
+    if (ret != 0) {
+        ALOGE("iptables-restore failed with %d: %s", ret, output.c_str());
+    }
+    return ret;
+}
+
+static const char* iptables_table(int type) {
+    return (type == 0) ? "filter" : (type == 1) ? "nat" : "mangle";
+}
 
+::android::String16 set_iptables_rule(int v4v6, int type, ::android::String16 rules) {
     std::string command = stringPrintf(
-        "%s\n%s\nCOMMIT\n",
-        "table " + std::string(table),
+        "*%s\n%s\nCOMMIT\n",
+        iptables_table(type),
         ::android::String8(rules).string()
     );
     ALOGV("set_iptables_rules:target=%d,type=%d, rules=%s", v4v6, type, command.c_str());
-    int ret = execIptablesRestore(target, command.c_str());
+    int ret = restore_iptables(v4v6, command);
     if (ret != 0) {
-        ALOGE("Failed to set iptables rules: %s", strerror(errno));
+        ALOGE("Failed to set iptables rules: %s", command.c_str());
         return ::android::String16("error_setting_iptables_rules");
     }
-    ALOGI("Successfully set iptables rules: %s", command.c_str());
+    ALOGV("Successfully set iptables rules: %s", command.c_str());
     return ::android::String16("iptables_rules_set_successfully");
 }
 
@@ -113,6 +137,206 @@ std::string stringPrintf(const char* fmt, ...) {
     return ::android::binder::Status::ok();
 }
 
+// Table and COMMIT lines would let an entry escape the transaction built for it.
+static bool is_valid_rule_entry(const IptablesRuleEntry& entry) {
+    if (entry.family < 0 || entry.family > 2 || entry.table < 0 || entry.table > 2) {
+        return false;
+    }
+    for (const std::string& line : ::android::base::Split(entry.rules, "\n")) {
+        std::string rule = ::android::base::Trim(line);
+        if (::android::base::StartsWith(rule, "*") || rule == "COMMIT") {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void append_rules(std::string* command, const std::string& rules) {
+    command->append(rules);
+    if (!rules.empty() && rules.back() != '\n') {
+        command->push_back('\n');
+    }
+}
+
+::android::binder::Status OemNetdListener::set_iptables_rules_batch(
+        const std::vector<IptablesRuleEntry>& entries, std::vector<int32_t>* _aidl_return) {
+    _aidl_return->assign(entries.size(), IOemNetd::IPTABLES_RULES_OK);
+
+    // Entries sharing a family and table go into one COMMIT, so each group is atomic
+    // and a failed group has applied nothing and can be retried entry by entry.
+    std::vector<std::vector<size_t>> groups;
+    int groupIndex[3][3];
+    memset(groupIndex, -1, sizeof(groupIndex));
+    for (size_t i = 0; i < entries.size(); i++) {
+        const IptablesRuleEntry& entry = entries[i];
+        if (!is_valid_rule_entry(entry)) {
+            ALOGE("Invalid iptables rule entry %zu: family=%d, table=%d", i, entry.family,
+                  entry.table);
+            (*_aidl_return)[i] = IOemNetd::IPTABLES_RULES_INVALID_ARGUMENT;
+            continue;
+        }
+        int& index = groupIndex[entry.family][entry.table];
+        if (index < 0) {
+            index = groups.size();
+            groups.emplace_back();
+        }
+        groups[index].push_back(i);
+    }
+
+    for (const std::vector<size_t>& group : groups) {
+        const IptablesRuleEntry& first = entries[group[0]];
+        std::string command = stringPrintf("*%s\n", iptables_table(first.table));
+        for (size_t i : group) {
+            append_rules(&command, entries[i].rules);
+        }
+        command.append("COMMIT\n");
+        if (restore_iptables(first.family, command) == 0) {
+            ALOGI("Set %zu iptables rule entries: family=%d, table=%d", group.size(),
+                  first.family, first.table);
+            continue;
+        }
+        ALOGE("Failed to set %zu iptables rule entries: family=%d, table=%d", group.size(),
+              first.family, first.table);
+        for (size_t i : group) {
+            if (group.size() > 1) {
+                command = stringPrintf("*%s\n", iptables_table(first.table));
+                append_rules(&command, entries[i].rules);
+                command.append("COMMIT\n");
+                if (restore_iptables(first.family, command) == 0) {
+                    continue;
+                }
+            }
+            (*_aidl_return)[i] = IOemNetd::IPTABLES_RULES_RESTORE_FAILED;
+        }
+    }
+    return ::android::binder::Status::ok();
+}
+
+::android::binder::Status OemNetdListener::dump_iptables_rules(int v4v6, int type,
+                                                              std::string* _aidl_return) {
+    if (v4v6 < 0 || v4v6 > 1 || type < 0 || type > 2) {
+        return ::android::binder::Status::fromServiceSpecificError(
+                IOemNetd::IPTABLES_RULES_INVALID_ARGUMENT, "invalid family or table");
+    }
+    // The restore processes accept listing commands and return the listing over the pipe.
+    std::string command = stringPrintf("*%s\n-S\nCOMMIT\n", iptables_table(type));
+    if (execIptablesRestoreWithOutput(iptables_target(v4v6), command, _aidl_return) != 0) {
+        ALOGE("Failed to dump iptables rules: %s", _aidl_return->c_str());
+        return ::android::binder::Status::fromServiceSpecificError(
+                IOemNetd::IPTABLES_RULES_RESTORE_FAILED, "iptables-restore failed");
+    }
+    return ::android::binder::Status::ok();
+}
+
+#define IPSET_PATH "/system/bin/ipset"
+#define IPSET_MAX_NAME 26  // IPSET_MAXNAMELEN is 32, leave room for the "_tmp" swap set
+
+// Feed a script to "ipset restore" and return its exit status.
+static int run_ipset_restore(const std::string& script) {
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        return -1;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        // Only async-signal-safe calls between fork and exec, netd is multithreaded.
+        dup2(fds[0], STDIN_FILENO);
+        execl(IPSET_PATH, IPSET_PATH, "restore", (char*)nullptr);
+        _exit(127);
+    }
+    close(fds[0]);
+    bool written = pid > 0 && ::android::base::WriteStringToFd(script, fds[1]);
+    close(fds[1]);
+    if (pid < 0) {
+        return -1;
+    }
+    int status = 0;
+    if (TEMP_FAILURE_RETRY(waitpid(pid, &status, 0)) != pid || !written) {
+        return -1;
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static bool is_valid_ipset_member(const std::string& member) {
+    return !member.empty() && member.size() <= INET6_ADDRSTRLEN + 4 &&
+           member.find_first_not_of("0123456789abcdefABCDEF.:/") == std::string::npos;
+}
+
+static int32_t check_ipset_request(const std::string& name, int family,
+                                   const std::vector<std::string>& members) {
+    if (name.empty() || name.size() > IPSET_MAX_NAME ||
+        name.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_") !=
+                std::string::npos ||
+        family < 0 || family > 1 ||
+        !std::all_of(members.begin(), members.end(), is_valid_ipset_member)) {
+        return IOemNetd::IPTABLES_RULES_INVALID_ARGUMENT;
+    }
+    if (access(IPSET_PATH, X_OK) != 0) {
+        ALOGE("Failed to set ipset %s: %s is not available", name.c_str(), IPSET_PATH);
+        return IOemNetd::IPTABLES_RULES_UNSUPPORTED;
+    }
+    return IOemNetd::IPTABLES_RULES_OK;
+}
+
+::android::binder::Status OemNetdListener::set_ipset(const std::string& name, int family,
+                                                    const std::vector<std::string>& members,
+                                                    int32_t* _aidl_return) {
+    *_aidl_return = check_ipset_request(name, family, members);
+    if (*_aidl_return != IOemNetd::IPTABLES_RULES_OK) {
+        return ::android::binder::Status::ok();
+    }
+
+    // Fill a temporary set and swap it in, so rules matching the set never see it half
+    // filled.
+    const char* inet = (family == 0) ? "inet" : "inet6";
+    std::string tmp = name + "_tmp";
+    std::string script = stringPrintf("create %s hash:net family %s -exist\n", name.c_str(), inet);
+    script += stringPrintf("create %s hash:net family %s -exist\n", tmp.c_str(), inet);
+    script += stringPrintf("flush %s\n", tmp.c_str());
+    for (const std::string& member : members) {
+        script += stringPrintf("add %s %s -exist\n", tmp.c_str(), member.c_str());
+    }
+    script += stringPrintf("swap %s %s\n", tmp.c_str(), name.c_str());
+    script += stringPrintf("destroy %s\n", tmp.c_str());
+    int ret = run_ipset_restore(script);
+    if (ret != 0) {
+        ALOGE("Failed to set ipset %s with %zu members: %d", name.c_str(), members.size(), ret);
+        *_aidl_return = IOemNetd::IPTABLES_RULES_RESTORE_FAILED;
+        return ::android::binder::Status::ok();
+    }
+    ALOGI("Set ipset %s with %zu members", name.c_str(), members.size());
+    return ::android::binder::Status::ok();
+}
+
+::android::binder::Status OemNetdListener::add_ipset_members(const std::string& name, int family,
+                                                            const std::vector<std::string>& members,
+                                                            int timeoutSeconds,
+                                                            int32_t* _aidl_return) {
+    *_aidl_return = check_ipset_request(name, family, members);
+    if (*_aidl_return != IOemNetd::IPTABLES_RULES_OK) {
+        return ::android::binder::Status::ok();
+    }
+    if (timeoutSeconds <= 0) {
+        *_aidl_return = IOemNetd::IPTABLES_RULES_INVALID_ARGUMENT;
+        return ::android::binder::Status::ok();
+    }
+
+    // One ipset run per batch; -exist on add refreshes the timeout of known addresses.
+    std::string script = stringPrintf("create %s hash:ip family %s timeout %d -exist\n",
+                                      name.c_str(), (family == 0) ? "inet" : "inet6",
+                                      timeoutSeconds);
+    for (const std::string& member : members) {
+        script += stringPrintf("add %s %s timeout %d -exist\n", name.c_str(), member.c_str(),
+                               timeoutSeconds);
+    }
+    int ret = run_ipset_restore(script);
+    if (ret != 0) {
+        ALOGE("Failed to add %zu members to ipset %s: %d", members.size(), name.c_str(), ret);
+        *_aidl_return = IOemNetd::IPTABLES_RULES_RESTORE_FAILED;
+    }
+    return ::android::binder::Status::ok();
+}
+
 } // namespace net
 } // namespace internal
 } // namespace android
@@ -19,6 +19,8 @@
 
 #include <map>
 #include <mutex>
+#include <string>
+#include <vector>
 #include <android-base/thread_annotations.h>
 #include "com/android/internal/net/BnOemNetd.h"
 #include "com/android/internal/net/IOemNetdUnsolicitedEventListener.h"
@@ -53,6 +55,32 @@ public:
         ::android::String16* _aidl_return
     ) override;
 
+    ::android::binder::Status set_iptables_rules_batch(
+        const std::vector<IptablesRuleEntry>& entries,
+        std::vector<int32_t>* _aidl_return
+    ) override;
+
+    ::android::binder::Status dump_iptables_rules(
+        int v4v6,
+        int type,
+        std::string* _aidl_return
+    ) override;
+
+    ::android::binder::Status set_ipset(
+        const std::string& name,
+        int family,
+        const std::vector<std::string>& members,
+        int32_t* _aidl_return
+    ) override;
+
+    ::android::binder::Status add_ipset_members(
+        const std::string& name,
+        int family,
+        const std::vector<std::string>& members,
+        int timeoutSeconds,
+        int32_t* _aidl_return
+    ) override;
+
 private:
     std::mutex mOemUnsolicitedMutex;
     OemUnsolListenerMap mOemUnsolListenerMap GUARDED_BY(mOemUnsolicitedMutex);
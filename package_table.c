@@ -0,0 +1,246 @@
+/**
+ * @file package_table.c
+ * @brief UID到应用包名的映射
+ * @note 启动时把packages.list解析成紧凑的哈希表，文件mtime变化后重新解析并原子替换，
+ *       处理线程无锁查询，进程已退出时同样可以得到包名
+ * @version 0.1
+ * @date 2025-08-07
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "file_watch.h"
+#include "dlog.h"
+#include "package_table.h"
+
+static package_table_t *current_table = NULL; // 当前生效的表
+static package_table_t *retired_table = NULL; // 上一张表，下次重新加载时才释放
+static file_watch_t list_watch;
+static uint32 reload_count = 0;
+
+static inline uint32 package_hash(uint32 uid)
+{
+    return uid * 2654435761U;
+}
+
+/**
+ * @brief 插入uid，同一个uid(sharedUserId)只保留第一个包名
+ *
+ * @param table
+ * @param uid
+ * @param name_off
+ */
+static void package_table_insert(package_table_t *table, uint32 uid, uint32 name_off)
+{
+    uint32 i = package_hash(uid) & table->mask;
+    while (table->slots[i].name_off != 0)
+    {
+        if (table->slots[i].uid == uid)
+        {
+            return;
+        }
+        i = (i + 1) & table->mask;
+    }
+    table->slots[i].uid = uid;
+    table->slots[i].name_off = name_off;
+    table->count++;
+}
+
+/**
+ * @brief 解析包列表
+ * @note 每行格式: <包名> <uid> <debuggable> <数据目录> <seinfo> <gids> ...
+ *       gids很多时一行可能超过缓冲区，只从第一段取包名和uid，其余部分丢弃
+ * @param path
+ * @return package_table_t* 失败返回NULL
+ */
+package_table_t *package_table_build(const char *path)
+{
+    FILE *fp = fopen(path, "re");
+    package_table_t *table = NULL;
+    char line[1024];
+    size_t names_size = 4096;
+    size_t names_len = 1; // 偏移0保留给空槽位
+    uint32 lines = 0;
+    uint32 size = 16;
+    int in_long_line = 0; // 上一次fgets没有读到行尾
+
+    if (fp == NULL)
+    {
+        DLOGW("Failed to open package list %s", path);
+        return NULL;
+    }
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        lines++;
+    }
+    // 装载因子不超过0.5
+    while (size < lines * 2)
+    {
+        size <<= 1;
+    }
+
+    table = (package_table_t *)calloc(1, sizeof(package_table_t));
+    if (table == NULL)
+    {
+        goto fail;
+    }
+    table->mask = size - 1;
+    table->slots = (package_slot_t *)calloc(size, sizeof(package_slot_t));
+    table->names = (char *)malloc(names_size);
+    if (table->slots == NULL || table->names == NULL)
+    {
+        goto fail;
+    }
+    table->names[0] = '\0';
+
+    rewind(fp);
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        size_t len = strlen(line);
+        int truncated = (len > 0 && line[len - 1] != '\n' && !feof(fp));
+        int tail = in_long_line;
+        in_long_line = truncated;
+        if (tail)
+        {
+            continue; // 超长行的后续部分
+        }
+        char *save = NULL;
+        char *name = strtok_r(line, " \t\n", &save);
+        char *uid_str = strtok_r(NULL, " \t\n", &save);
+        char *end = NULL;
+        if (name == NULL || uid_str == NULL)
+        {
+            continue;
+        }
+        unsigned long uid = strtoul(uid_str, &end, 10);
+        // uid恰好被缓冲区截断时无法确定完整的值，整行丢弃
+        if (end == uid_str || *end != '\0' || (truncated && end == line + len))
+        {
+            continue;
+        }
+        size_t name_len = strlen(name) + 1;
+        if (names_len + name_len > names_size)
+        {
+            char *names;
+            while (names_len + name_len > names_size)
+            {
+                names_size *= 2;
+            }
+            names = (char *)realloc(table->names, names_size);
+            if (names == NULL)
+            {
+                goto fail;
+            }
+            table->names = names;
+        }
+        memcpy(table->names + names_len, name, name_len);
+        package_table_insert(table, (uint32)uid % PACKAGE_USER_OFFSET, (uint32)names_len);
+        names_len += name_len;
+    }
+    fclose(fp);
+    DLOGI("Loaded %u uids from package list %s", table->count, path);
+    return table;
+
+fail:
+    fclose(fp);
+    package_table_free(table);
+    return NULL;
+}
+
+/**
+ * @brief 释放哈希表
+ *
+ * @param table
+ */
+void package_table_free(package_table_t *table)
+{
+    if (table != NULL)
+    {
+        free(table->slots);
+        free(table->names);
+        free(table);
+    }
+}
+
+/**
+ * @brief 加载包列表并开始监视文件变化
+ *
+ * @param path 调用者保证在运行期间有效
+ * @return int 0成功
+ */
+int package_table_init(const char *path)
+{
+    package_table_t *table;
+    file_watch_init(&list_watch, path, PACKAGE_TABLE_CHECK_INTERVAL);
+    table = package_table_build(path);
+    if (table == NULL)
+    {
+        return 1;
+    }
+    __atomic_store_n(&current_table, table, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void package_table_deinit(void)
+{
+    package_table_free(__atomic_exchange_n(&current_table, NULL, __ATOMIC_ACQ_REL));
+    package_table_free(retired_table);
+    retired_table = NULL;
+}
+
+/**
+ * @brief 包列表变化后重新加载
+ * @note 只能由一个线程调用；旧表延后到下一次重新加载才释放，
+ *       此时处理线程早已不再使用从旧表查到的包名
+ */
+void package_table_check_reload(void)
+{
+    package_table_t *table;
+    if (!file_watch_changed(&list_watch))
+    {
+        return;
+    }
+    table = package_table_build(list_watch.path);
+    if (table == NULL)
+    {
+        DLOGW("Failed to reload package list, keep the old one");
+        return;
+    }
+    package_table_free(retired_table);
+    retired_table = __atomic_exchange_n(&current_table, table, __ATOMIC_ACQ_REL);
+    __atomic_add_fetch(&reload_count, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief 查询uid对应的包名
+ *
+ * @param uid 可以是任意用户下的uid
+ * @return const char* 未知uid返回NULL
+ */
+const char *package_table_lookup(uint32 uid)
+{
+    const package_table_t *table = __atomic_load_n(&current_table, __ATOMIC_ACQUIRE);
+    if (table == NULL)
+    {
+        return NULL;
+    }
+    uid %= PACKAGE_USER_OFFSET;
+    for (uint32 i = package_hash(uid) & table->mask; table->slots[i].name_off != 0; i = (i + 1) & table->mask)
+    {
+        if (table->slots[i].uid == uid)
+        {
+            return table->names + table->slots[i].name_off;
+        }
+    }
+    return NULL;
+}
+
+void package_table_get_stats(package_table_stats_t *stats)
+{
+    const package_table_t *table = __atomic_load_n(&current_table, __ATOMIC_ACQUIRE);
+    stats->packages = (table != NULL) ? table->count : 0;
+    stats->reloads = __atomic_load_n(&reload_count, __ATOMIC_RELAXED);
+}
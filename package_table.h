@@ -0,0 +1,57 @@
+/**
+ * @file package_table.h
+ * @brief UID到应用包名的映射
+ * @version 0.1
+ * @date 2025-08-07
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#ifndef PACKAGE_TABLE_H
+#define PACKAGE_TABLE_H
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include "queue.h"
+
+#define PACKAGES_LIST_PATH "/data/system/packages.list" // 默认包列表
+#define PACKAGE_USER_OFFSET 100000 // 多用户下 uid = userId * 100000 + appId
+// 检查包列表变化的间隔，单位毫秒，测试时可由编译参数改小
+#ifndef PACKAGE_TABLE_CHECK_INTERVAL
+#define PACKAGE_TABLE_CHECK_INTERVAL 5000
+#endif
+
+// uid -> 包名的开放寻址哈希表，包名集中存放在names中
+typedef struct package_slot
+{
+    uint32 uid;      // appId
+    uint32 name_off; // 包名在names中的偏移，0表示空槽位
+} package_slot_t;
+
+typedef struct package_table
+{
+    uint32 mask;
+    uint32 count;
+    package_slot_t *slots;
+    char *names;
+} package_table_t;
+
+typedef struct package_table_stats
+{
+    uint32 packages; // 当前表中的uid个数
+    uint32 reloads;  // 包列表变化后重新加载的次数
+} package_table_stats_t;
+
+package_table_t *package_table_build(const char *path);
+void package_table_free(package_table_t *table);
+int package_table_init(const char *path);
+void package_table_deinit(void);
+void package_table_check_reload(void);
+const char *package_table_lookup(uint32 uid);
+void package_table_get_stats(package_table_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
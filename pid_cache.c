@@ -0,0 +1,314 @@
+/**
+ * @file pid_cache.c
+ * @brief PID到进程名的缓存
+ * @note 每个缓存项保留打开的/proc/<pid>目录，进程退出后通过它再也看不到stat，
+ *       即使PID被复用也是如此。命中时只需一次fstatat校验，不会返回旧进程名；
+ *       目录打不开(例如fd不足)时退回每次读取stat比较启动时间
+ * @version 0.1
+ * @date 2025-08-06
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // O_PATH
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "file_watch.h"
+#include "dlog.h"
+#include "pid_cache.h"
+
+#define pid_cache_count(counter) __atomic_fetch_add(&(counter), 1, __ATOMIC_RELAXED)
+
+// proc文件系统的挂载点，测试时可由编译参数指向伪造的目录
+#ifndef PID_CACHE_PROC_ROOT
+#define PID_CACHE_PROC_ROOT "/proc"
+#endif
+
+/**
+ * @brief 读取/proc/<pid>下的文件
+ *
+ * @param pid
+ * @param dir_fd 打开的/proc/<pid>目录，-1时按路径打开
+ * @param file 文件名
+ * @param buffer
+ * @param size 缓冲区大小，结果以null结尾
+ * @return int 读取的字节数，失败返回-1
+ */
+static int read_proc_file(int pid, int dir_fd, const char *file, char *buffer, size_t size)
+{
+    char path[64];
+    int fd;
+    if (dir_fd >= 0)
+    {
+        fd = openat(dir_fd, file, O_RDONLY | O_CLOEXEC);
+    }
+    else
+    {
+        snprintf(path, sizeof(path), PID_CACHE_PROC_ROOT "/%d/%s", pid, file);
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+    }
+    if (fd < 0)
+    {
+        return -1;
+    }
+    ssize_t n = read(fd, buffer, size - 1);
+    close(fd);
+    if (n < 0)
+    {
+        return -1;
+    }
+    buffer[n] = '\0';
+    return (int)n;
+}
+
+/**
+ * @brief 读取进程启动时间(/proc/<pid>/stat第22列)
+ *
+ * @param pid
+ * @param dir_fd 打开的/proc/<pid>目录，-1时按路径打开
+ * @param start_time 输出
+ * @return int 0成功，进程不存在返回-1
+ */
+static int read_start_time(int pid, int dir_fd, unsigned long long *start_time)
+{
+    char stat[512];
+    if (read_proc_file(pid, dir_fd, "stat", stat, sizeof(stat)) <= 0)
+    {
+        return -1;
+    }
+    // 进程名可能包含空格和括号，从最后一个')'之后开始数，')'后是第3列
+    char *p = strrchr(stat, ')');
+    if (p == NULL)
+    {
+        return -1;
+    }
+    for (int field = 2; field < 22 && p != NULL; field++)
+    {
+        p = strchr(p + 1, ' ');
+    }
+    if (p == NULL)
+    {
+        return -1;
+    }
+    *start_time = strtoull(p + 1, NULL, 10);
+    return 0;
+}
+
+/**
+ * @brief 读取进程名(/proc/<pid>/cmdline中的第一个参数)
+ *
+ * @param pid
+ * @param dir_fd 打开的/proc/<pid>目录，-1时按路径打开
+ * @param name 至少PID_NAME_SIZE字节
+ * @return int 0成功
+ */
+static int read_cmdline(int pid, int dir_fd, char *name)
+{
+    if (read_proc_file(pid, dir_fd, "cmdline", name, PID_NAME_SIZE) < 1)
+    {
+        DLOGD("Failed to read cmdline of pid %d", pid);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 检查缓存项对应的进程是否还在
+ * @note 有dir_fd时只需一次fstatat；否则读取stat比较启动时间
+ */
+static int entry_alive(const pid_cache_entry_t *entry)
+{
+    unsigned long long start_time = 0;
+    if (entry->dir_fd >= 0)
+    {
+        struct stat st;
+        return fstatat(entry->dir_fd, "stat", &st, 0) == 0;
+    }
+    return read_start_time(entry->pid, -1, &start_time) == 0 && start_time == entry->start_time;
+}
+
+static void entry_clear(pid_cache_entry_t *entry)
+{
+    if (entry->dir_fd >= 0)
+    {
+        close(entry->dir_fd);
+    }
+    entry->pid = 0;
+    entry->dir_fd = -1;
+}
+
+pid_cache_t *pid_cache_create(void)
+{
+    pid_cache_t *cache = (pid_cache_t *)calloc(1, sizeof(pid_cache_t));
+    if (cache == NULL)
+    {
+        return NULL;
+    }
+    for (int s = 0; s < PID_CACHE_SETS; s++)
+    {
+        for (int w = 0; w < PID_CACHE_WAYS; w++)
+        {
+            cache->entries[s][w].dir_fd = -1;
+        }
+    }
+    return cache;
+}
+
+void pid_cache_destroy(pid_cache_t *cache)
+{
+    if (cache == NULL)
+    {
+        return;
+    }
+    for (int s = 0; s < PID_CACHE_SETS; s++)
+    {
+        for (int w = 0; w < PID_CACHE_WAYS; w++)
+        {
+            entry_clear(&cache->entries[s][w]);
+        }
+    }
+    free(cache);
+}
+
+/**
+ * @brief 查询进程名
+ * @note 返回的指针指向缓存项，在同一缓存的下一次调用之前有效
+ * @param cache
+ * @param pid
+ * @return const char* 进程不存在返回NULL
+ */
+const char *pid_cache_lookup(pid_cache_t *cache, int pid)
+{
+    pid_cache_entry_t *set = cache->entries[(unsigned int)pid & (PID_CACHE_SETS - 1)];
+    pid_cache_entry_t *entry = NULL;
+    pid_cache_entry_t *victim = &set[0];
+    long long now = file_watch_now_ms();
+    unsigned long long start_time = 0;
+    char path[64];
+    int dir_fd;
+
+    if (pid <= 0)
+    {
+        return NULL;
+    }
+    for (int i = 0; i < PID_CACHE_WAYS; i++)
+    {
+        if (set[i].pid == pid)
+        {
+            entry = &set[i];
+            break;
+        }
+        // 优先用空位，否则淘汰最久没有校验的一项
+        if (victim->pid != 0 && (set[i].pid == 0 || set[i].validated_ms < victim->validated_ms))
+        {
+            victim = &set[i];
+        }
+    }
+
+    // 命中也要校验，PID刚被复用时不会返回旧进程名
+    if (entry != NULL && entry_alive(entry))
+    {
+        entry->validated_ms = now;
+        pid_cache_count(cache->stats.hits);
+        return entry->name;
+    }
+
+    // 先打开目录再通过它读取，读到的stat和cmdline与之后校验的是同一个进程
+    snprintf(path, sizeof(path), PID_CACHE_PROC_ROOT "/%d", pid);
+    dir_fd = open(path, O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if ((dir_fd < 0 && errno == ENOENT) || read_start_time(pid, dir_fd, &start_time) != 0)
+    {
+        // 进程已退出
+        if (dir_fd >= 0)
+        {
+            close(dir_fd);
+        }
+        if (entry != NULL)
+        {
+            entry_clear(entry);
+            pid_cache_count(cache->stats.evictions);
+        }
+        pid_cache_count(cache->stats.misses);
+        return NULL;
+    }
+
+    if (entry != NULL)
+    {
+        pid_cache_count(cache->stats.reused);
+    }
+    else
+    {
+        if (victim->pid != 0)
+        {
+            pid_cache_count(cache->stats.evictions);
+        }
+        entry = victim;
+    }
+    entry_clear(entry);
+
+    pid_cache_count(cache->stats.misses);
+    if (read_cmdline(pid, dir_fd, entry->name) != 0)
+    {
+        if (dir_fd >= 0)
+        {
+            close(dir_fd);
+        }
+        return NULL;
+    }
+    entry->pid = pid;
+    entry->dir_fd = dir_fd;
+    entry->start_time = start_time;
+    entry->validated_ms = now;
+    return entry->name;
+}
+
+/**
+ * @brief 淘汰已经退出的进程
+ * @note 只检查超过校验间隔的缓存项，由持有缓存的线程在空闲时调用
+ * @param cache
+ */
+void pid_cache_sweep(pid_cache_t *cache)
+{
+    long long now = file_watch_now_ms();
+    for (int s = 0; s < PID_CACHE_SETS; s++)
+    {
+        for (int w = 0; w < PID_CACHE_WAYS; w++)
+        {
+            pid_cache_entry_t *entry = &cache->entries[s][w];
+            if (entry->pid == 0 || now - entry->validated_ms < PID_CACHE_VALIDATE_INTERVAL)
+            {
+                continue;
+            }
+            if (!entry_alive(entry))
+            {
+                entry_clear(entry);
+                pid_cache_count(cache->stats.evictions);
+            }
+            else
+            {
+                entry->validated_ms = now;
+            }
+        }
+    }
+}
+
+/**
+ * @brief 读取命中统计，可在其他线程调用
+ *
+ * @param cache
+ * @param stats
+ */
+void pid_cache_get_stats(const pid_cache_t *cache, pid_cache_stats_t *stats)
+{
+    stats->hits = __atomic_load_n(&cache->stats.hits, __ATOMIC_RELAXED);
+    stats->misses = __atomic_load_n(&cache->stats.misses, __ATOMIC_RELAXED);
+    stats->reused = __atomic_load_n(&cache->stats.reused, __ATOMIC_RELAXED);
+    stats->evictions = __atomic_load_n(&cache->stats.evictions, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,57 @@
+/**
+ * @file pid_cache.h
+ * @brief PID到进程名的缓存
+ * @version 0.1
+ * @date 2025-08-06
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#ifndef PID_CACHE_H
+#define PID_CACHE_H
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include "queue.h"
+
+#define PID_CACHE_WAYS 4          // 组相联路数
+#define PID_CACHE_SETS 64         // 组数，2的幂
+#define PID_NAME_SIZE 256         // 进程名最大长度，含结束符
+#define PID_CACHE_VALIDATE_INTERVAL 1000 // 清理时跳过该时间(毫秒)内查询过的项
+#define PID_CACHE_SWEEP_INTERVAL 10000   // 空闲时清理已退出进程的间隔(毫秒)
+
+typedef struct pid_cache_entry
+{
+    int pid;                       // 0表示空
+    int dir_fd;                    // 打开的/proc/<pid>目录，进程退出后其中的文件不再可见；-1表示没有打开
+    unsigned long long start_time; // /proc/<pid>/stat 中的进程启动时间，没有dir_fd时用于识别PID复用
+    long long validated_ms;        // 上次校验时间
+    char name[PID_NAME_SIZE];
+} pid_cache_entry_t;
+
+typedef struct pid_cache_stats
+{
+    uint64 hits;        // 校验通过的命中
+    uint64 misses;      // 需要重新读取/proc
+    uint64 reused;      // 发现PID被复用
+    uint64 evictions;   // 进程退出或容量不足被淘汰
+} pid_cache_stats_t;
+
+// 每个处理线程一份，不加锁；同一UID的上报总在同一线程处理
+typedef struct pid_cache
+{
+    pid_cache_entry_t entries[PID_CACHE_SETS][PID_CACHE_WAYS];
+    pid_cache_stats_t stats;
+} pid_cache_t;
+
+pid_cache_t *pid_cache_create(void);
+void pid_cache_destroy(pid_cache_t *cache);
+const char *pid_cache_lookup(pid_cache_t *cache, int pid);
+void pid_cache_sweep(pid_cache_t *cache);
+void pid_cache_get_stats(const pid_cache_t *cache, pid_cache_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
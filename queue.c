@@ -9,180 +9,656 @@
  *
  */
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "dlog.h"
 #include "queue.h"
 
-static int lock;
-#define atomic_cas(dst, old, new) __sync_bool_compare_and_swap((dst), (old), (new))
-#define atomic_lock(ptr)\
-while(!atomic_cas(ptr,0,1))
-#define atomic_unlock(ptr)\
-while(!atomic_cas(ptr,1,0))
+#define atomic_load_relaxed(ptr) __atomic_load_n((ptr), __ATOMIC_RELAXED)
+#define atomic_load_acquire(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define atomic_store_release(ptr, val) __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+#define atomic_cas_weak(ptr, expected, desired) \
+    __atomic_compare_exchange_n((ptr), (expected), (desired), 1, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)
+
+RING_QUEUE_T *g_queue; // 全局队列指针
 
 /**
- * 原子锁加锁
- * @param 
- * null
- * @return 
- * null
+ * @brief 更新历史最大深度
+ *
+ * @param ring
+ * @param depth 当前深度
  */
-void atomic_lock_api(void)
+static inline void ring_update_high_water(RING_QUEUE_T *ring, uint32 depth)
 {
-    atomic_lock(&lock);
+    uint32 high = atomic_load_relaxed(&ring->high_water);
+    while (depth > high)
+    {
+        if (__atomic_compare_exchange_n(&ring->high_water, &high, depth, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        {
+            break;
+        }
+    }
 }
 
 /**
- * 原子锁解锁
- * @param 
- * null
- * @return 
- * null
+ * @brief 申请count个连续槽位
+ *
+ * @param ring
+ * @param count 期望个数
+ * @param pos 输出，第一个槽位的位置
+ * @return uint32 实际申请到的个数，0表示队列满
  */
-void atomic_unlock_api(void)
+static uint32 ring_claim(RING_QUEUE_T *ring, uint32 count, uint64 *pos)
 {
-    atomic_unlock(&lock);
+    uint64 head = atomic_load_relaxed(&ring->head);
+    while (1)
+    {
+        //* 槽位只由唯一的消费者按顺序释放，tail 之前的槽位都可以复用
+        uint64 tail = atomic_load_acquire(&ring->tail);
+        if (unlikely(tail > head))
+        {
+            //* head 读得太早，消费者已经越过它
+            head = atomic_load_relaxed(&ring->head);
+            continue;
+        }
+        uint32 used = (uint32)(head - tail);
+        uint32 room = (used < ring->capacity) ? ring->capacity - used : 0;
+        uint32 n = (count < room) ? count : room;
+        if (n == 0)
+        {
+            return 0;
+        }
+        if (atomic_cas_weak(&ring->head, &head, head + n))
+        {
+            *pos = head;
+            return n;
+        }
+    }
 }
 
-BUF_LIST *g_queue; // 全局队列指针
+/**
+ * @brief 写入槽位并对消费者可见
+ *
+ * @param ring
+ * @param pos 槽位位置
+ * @param data 数据指针
+ * @param len 数据长度
+ * @param now_ns 入队时间
+ */
+static inline void ring_publish(RING_QUEUE_T *ring, uint64 pos, const uint8 *data, uint32 len, uint64 now_ns)
+{
+    List_Node_ST *slot = &ring->slots[pos & ring->mask];
+    memcpy(slot->data, data, len);
+    slot->data[len] = '\0';
+    slot->len = len;
+    slot->enqueue_ns = now_ns;
+    atomic_store_release(&slot->seq, pos + 1);
+}
 
 /**
- * @brief 初始化队列
+ * @brief 生产者发布数据后，如果消费者在等待则唤醒它
  *
- * @return ERROR_MESSAGE_T
+ * @param ring
  */
-ERROR_MESSAGE_T QueueInit()
+static inline void ring_wakeup(RING_QUEUE_T *ring)
 {
-    ERROR_MESSAGE_T ret = SUCCESS;
+    //* 与 RingQueuePopWait 中先置 waiting 再检查槽位的顺序配对，保证不会漏掉唤醒
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (atomic_load_relaxed(&ring->waiting) && __atomic_exchange_n(&ring->waiting, 0, __ATOMIC_ACQ_REL))
+    {
+        uint64_t one = 1;
+        if (write(ring->event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        {
+            DLOGE("eventfd write error: %s(errno: %d)", strerror(errno), errno);
+        }
+    }
+}
 
-    g_queue = malloc(sizeof(BUF_LIST));
-    if (g_queue == NULL)
+/**
+ * @brief 消费者归还槽位后，如果有生产者在等待空位则唤醒它
+ *
+ * @param ring
+ */
+static inline void ring_wakeup_producer(RING_QUEUE_T *ring)
+{
+    //* 与 RingQueuePushWait 中先登记再申请槽位的顺序配对；
+    //* 有生产者登记期间每次归还都唤醒，多个生产者等待时不会有人漏掉
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (atomic_load_relaxed(&ring->space_waiters) != 0)
     {
-        printf("bufferInit error");
-        ret = MEM_MALLOC_FAIL;
+        uint64_t one = 1;
+        if (write(ring->space_event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        {
+            DLOGE("eventfd write error: %s(errno: %d)", strerror(errno), errno);
+        }
+    }
+}
+
+/**
+ * @brief 睡眠在eventfd上，被唤醒时清掉计数
+ *
+ * @param fd
+ * @param wait_ms 最长等待时间，-1表示一直等待
+ */
+static void ring_wait_event(int fd, int wait_ms)
+{
+    struct pollfd pfd = {.fd = fd, .events = POLLIN, .revents = 0};
+    int ret = poll(&pfd, 1, wait_ms);
+    if (ret > 0)
+    {
+        uint64_t count;
+        if (read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        {
+            DLOGE("eventfd read error: %s(errno: %d)", strerror(errno), errno);
+        }
     }
-    else
+    else if (ret < 0 && errno != EINTR)
     {
-        g_queue->head = NULL;
-        g_queue->tail = NULL;
-        g_queue->len = 0;
-        g_queue->size = 0;
+        DLOGE("poll error: %s(errno: %d)", strerror(errno), errno);
     }
-    return ret;
 }
 
 /**
- * @brief 入队列
+ * @brief 当前单调时间，单位纳秒
+ *
+ * @return uint64
+ */
+static uint64 ring_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64)ts.tv_sec * 1000000000ULL + (uint64)ts.tv_nsec;
+}
+
+/**
+ * @brief 当前单调时间，单位毫秒
+ *
+ * @return long long
+ */
+static long long ring_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief 创建环形队列
+ *
+ * @param capacity 槽位数，向上取整为2的幂，0表示使用默认值
+ * @return RING_QUEUE_T* 失败返回NULL
+ */
+RING_QUEUE_T *RingQueueCreate(uint32 capacity)
+{
+    RING_QUEUE_T *ring = NULL;
+    uint32 size = 1;
+
+    if (capacity == 0)
+    {
+        capacity = QUEUE_DEFAULT_CAPACITY;
+    }
+    while (size < capacity && size < 0x80000000U)
+    {
+        size <<= 1;
+    }
+
+    if (posix_memalign((void **)&ring, QUEUE_CACHE_LINE, sizeof(RING_QUEUE_T)) != 0)
+    {
+        return NULL;
+    }
+    memset(ring, 0, sizeof(RING_QUEUE_T));
+    if (posix_memalign((void **)&ring->slots, QUEUE_CACHE_LINE, (size_t)size * sizeof(List_Node_ST)) != 0)
+    {
+        free(ring);
+        return NULL;
+    }
+    for (uint32 i = 0; i < size; i++)
+    {
+        ring->slots[i].seq = 0;
+        ring->slots[i].len = 0;
+    }
+    ring->event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    ring->space_event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (ring->event_fd < 0 || ring->space_event_fd < 0)
+    {
+        if (ring->event_fd >= 0)
+        {
+            close(ring->event_fd);
+        }
+        if (ring->space_event_fd >= 0)
+        {
+            close(ring->space_event_fd);
+        }
+        free(ring->slots);
+        free(ring);
+        return NULL;
+    }
+    ring->capacity = size;
+    ring->mask = size - 1;
+    return ring;
+}
+
+/**
+ * @brief 销毁环形队列
  *
+ * @param ring
+ */
+void RingQueueDestroy(RING_QUEUE_T *ring)
+{
+    if (ring != NULL)
+    {
+        close(ring->event_fd);
+        close(ring->space_event_fd);
+        free(ring->slots);
+        free(ring);
+    }
+}
+
+/**
+ * @brief 入队列，可多线程并发调用
+ *
+ * @param ring
  * @param data 数据指针
  * @param len 数据长度
- * @return ERROR_MESSAGE_T 错误码
- * @note
+ * @return ERROR_MESSAGE_T 队列满返回BUF_FULL
  */
-ERROR_MESSAGE_T BufferInQueue(const uint8 *data, uint32 len)
+ERROR_MESSAGE_T RingQueuePush(RING_QUEUE_T *ring, const uint8 *data, uint32 len)
 {
-    ERROR_MESSAGE_T ret = SUCCESS;
-    BUF_LIST *list = g_queue;
-    do
+    uint64 pos = 0;
+
+    if ((len > QUEUE_SLOT_SIZE) || (len < QUEUE_MIN_DATA_LEN)) // 单个报文最大
+    {
+        return DATA_INVALID;
+    }
+    if (unlikely(ring_claim(ring, 1, &pos) == 0))
     {
-        //* 空的队列头
-        if (list == NULL)
+        __atomic_add_fetch(&ring->dropped, 1, __ATOMIC_RELAXED);
+        return BUF_FULL;
+    }
+    ring_publish(ring, pos, data, len, ring_now_ns());
+    ring_update_high_water(ring, (uint32)RingQueueSize(ring));
+    ring_wakeup(ring);
+    return SUCCESS;
+}
+
+/**
+ * @brief 阻塞入队列，可多线程并发调用
+ * @note 有空位时立即返回，队列满时睡眠在eventfd上，由消费者归还槽位时唤醒
+ * @param ring
+ * @param data 数据指针
+ * @param len 数据长度
+ * @param timeout_ms 最长等待时间，-1表示一直等待，0表示不等待
+ * @return ERROR_MESSAGE_T 超时返回BUF_FULL并计入丢包
+ */
+ERROR_MESSAGE_T RingQueuePushWait(RING_QUEUE_T *ring, const uint8 *data, uint32 len, int timeout_ms)
+{
+    long long deadline = (timeout_ms > 0) ? ring_now_ms() + timeout_ms : 0;
+    uint64 pos = 0;
+
+    if ((len > QUEUE_SLOT_SIZE) || (len < QUEUE_MIN_DATA_LEN))
+    {
+        return DATA_INVALID;
+    }
+    while (ring_claim(ring, 1, &pos) == 0)
+    {
+        int wait_ms = -1;
+        if (timeout_ms > 0)
         {
-            printf("g_queue is NULL!");
-            ret = BUF_EMPTY;
-            break;
+            long long left = deadline - ring_now_ms();
+            wait_ms = (left > 0) ? (int)left : 0;
+        }
+        if (timeout_ms == 0 || wait_ms == 0)
+        {
+            __atomic_add_fetch(&ring->dropped, 1, __ATOMIC_RELAXED);
+            return BUF_FULL;
         }
 
-        if ((len > 1024) || (len < 20)) // 单个报文最大
+        //* 先登记要睡眠，再申请一次，避免消费者在两次申请之间归还的槽位没有唤醒
+        __atomic_add_fetch(&ring->space_waiters, 1, __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        uint32 claimed = ring_claim(ring, 1, &pos);
+        if (claimed == 0)
+        {
+            ring_wait_event(ring->space_event_fd, wait_ms);
+        }
+        __atomic_sub_fetch(&ring->space_waiters, 1, __ATOMIC_RELAXED);
+        if (claimed != 0)
         {
-            printf("packet is to long.or too small\n");
-            ret = DATA_INVALID;
             break;
         }
+    }
+    ring_publish(ring, pos, data, len, ring_now_ns());
+    ring_update_high_water(ring, (uint32)RingQueueSize(ring));
+    ring_wakeup(ring);
+    return SUCCESS;
+}
 
-        struct List_Node *pnew = (struct List_Node *)malloc(sizeof(struct List_Node) + len);
-        if (pnew == NULL)
+/**
+ * @brief 批量入队列，一次申请整批槽位
+ *
+ * @param ring
+ * @param data 数据指针数组
+ * @param len 数据长度数组
+ * @param count 数据个数
+ * @return uint32 成功入队的个数，无效的数据被跳过，放不下的计入丢包
+ */
+uint32 RingQueuePushBatch(RING_QUEUE_T *ring, const uint8 *data[], const uint32 len[], uint32 count)
+{
+    uint32 valid = 0;
+    uint32 claimed;
+    uint64 pos = 0;
+
+    for (uint32 i = 0; i < count; i++)
+    {
+        if ((len[i] <= QUEUE_SLOT_SIZE) && (len[i] >= QUEUE_MIN_DATA_LEN))
         {
-            ret = MEM_MALLOC_FAIL;
-            break;
+            valid++;
         }
+    }
+    if (valid == 0)
+    {
+        return 0;
+    }
 
-        memcpy(pnew->data, data, len); // 入队的数据
-        pnew->len = len;
+    claimed = ring_claim(ring, valid, &pos);
+    if (claimed < valid)
+    {
+        __atomic_add_fetch(&ring->dropped, valid - claimed, __ATOMIC_RELAXED);
+    }
+    uint64 now_ns = ring_now_ns(); // 同一批共用一个入队时间
+    for (uint32 i = 0, n = 0; i < count && n < claimed; i++)
+    {
+        if ((len[i] <= QUEUE_SLOT_SIZE) && (len[i] >= QUEUE_MIN_DATA_LEN))
+        {
+            ring_publish(ring, pos + n, data[i], len[i], now_ns);
+            n++;
+        }
+    }
+    if (claimed > 0)
+    {
+        ring_update_high_water(ring, (uint32)RingQueueSize(ring));
+        ring_wakeup(ring);
+    }
+    return claimed;
+}
 
-        //* 进入临界区
-        LOCK();
-        LIST_RPUSH(list, pnew);
-        UNLOCK();
-        printf("bufferInQueue success, len =%d, addr %p, len = %d\n", list->len, pnew, len);
-    } while (0);
+/**
+ * @brief 出队列，只允许一个消费者调用
+ * @note 返回的节点指向队列内部槽位，处理完后必须调用RingQueueRelease归还
+ * @param ring
+ * @param node 指向节点指针的指针
+ * @return ERROR_MESSAGE_T 没有可读数据返回BUF_EMPTY
+ */
+ERROR_MESSAGE_T RingQueuePop(RING_QUEUE_T *ring, struct List_Node **node)
+{
+    uint64 pos = atomic_load_relaxed(&ring->tail);
+    List_Node_ST *slot = &ring->slots[pos & ring->mask];
 
+    //* 生产者已申请但还没写完的槽位同样视为空
+    if (atomic_load_acquire(&slot->seq) != pos + 1)
+    {
+        return BUF_EMPTY;
+    }
+    *node = slot;
+    return SUCCESS;
+}
+
+/**
+ * @brief 阻塞出队列，只允许一个消费者调用
+ * @note 队列中有数据时立即返回，只有确实没有数据时才睡眠在eventfd上；
+ *       队列已关闭时不再等待
+ * @param ring
+ * @param node 指向节点指针的指针
+ * @param timeout_ms 最长等待时间，-1表示一直等待，0表示不等待
+ * @return ERROR_MESSAGE_T 超时或队列已关闭且为空返回BUF_EMPTY
+ */
+ERROR_MESSAGE_T RingQueuePopWait(RING_QUEUE_T *ring, struct List_Node **node, int timeout_ms)
+{
+    long long deadline = (timeout_ms > 0) ? ring_now_ms() + timeout_ms : 0;
+
+    while (1)
+    {
+        if (RingQueuePop(ring, node) == SUCCESS)
+        {
+            return SUCCESS;
+        }
+        if (timeout_ms == 0 || atomic_load_acquire(&ring->closed))
+        {
+            return BUF_EMPTY;
+        }
+
+        //* 先声明要睡眠，再检查一次，避免生产者在两次检查之间发布的数据没有唤醒
+        __atomic_store_n(&ring->waiting, 1, __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (RingQueuePop(ring, node) == SUCCESS)
+        {
+            __atomic_store_n(&ring->waiting, 0, __ATOMIC_RELAXED);
+            return SUCCESS;
+        }
+
+        int wait_ms = -1;
+        if (atomic_load_acquire(&ring->closed))
+        {
+            __atomic_store_n(&ring->waiting, 0, __ATOMIC_RELAXED);
+            return BUF_EMPTY;
+        }
+        if (timeout_ms > 0)
+        {
+            long long left = deadline - ring_now_ms();
+            if (left <= 0)
+            {
+                __atomic_store_n(&ring->waiting, 0, __ATOMIC_RELAXED);
+                return BUF_EMPTY;
+            }
+            wait_ms = (int)left;
+        }
+        ring_wait_event(ring->event_fd, wait_ms);
+        __atomic_store_n(&ring->waiting, 0, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief 归还RingQueuePop取出的槽位
+ *
+ * @param ring
+ * @param node
+ */
+void RingQueueRelease(RING_QUEUE_T *ring, struct List_Node *node)
+{
+    uint64 pos = atomic_load_relaxed(&ring->tail);
+    if (unlikely(node != &ring->slots[pos & ring->mask]))
+    {
+        DLOGE("release node %p out of order", (void *)node);
+        return;
+    }
+    atomic_store_release(&ring->tail, pos + 1);
+    ring_wakeup_producer(ring);
+}
+
+/**
+ * @brief 关闭队列，通知消费者不会再有新数据
+ * @note 调用前生产者必须已经停止；已入队的数据仍可取出，取完后RingQueuePopWait立即返回
+ * @param ring
+ */
+void RingQueueClose(RING_QUEUE_T *ring)
+{
+    uint64_t one = 1;
+    __atomic_store_n(&ring->closed, 1, __ATOMIC_SEQ_CST);
+    //* 不论消费者是否声明了等待都唤醒一次，它醒来后会看到 closed
+    if (write(ring->event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+    {
+        DLOGE("eventfd write error: %s(errno: %d)", strerror(errno), errno);
+    }
+}
+
+int RingQueueIsClosed(RING_QUEUE_T *ring)
+{
+    return (int)atomic_load_acquire(&ring->closed);
+}
+
+int RingQueueSize(RING_QUEUE_T *ring)
+{
+    //* 先读 tail 再读 head，保证 head >= tail
+    uint64 tail = atomic_load_acquire(&ring->tail);
+    uint64 head = atomic_load_acquire(&ring->head);
+    return (head > tail) ? (int)(head - tail) : 0;
+}
+
+void RingQueueGetStats(RING_QUEUE_T *ring, QUEUE_STATS_T *stats)
+{
+    stats->dequeued = atomic_load_relaxed(&ring->tail);
+    stats->enqueued = atomic_load_relaxed(&ring->head);
+    stats->size = (stats->enqueued > stats->dequeued) ? (uint32)(stats->enqueued - stats->dequeued) : 0;
+    stats->capacity = ring->capacity;
+    stats->high_water = atomic_load_relaxed(&ring->high_water);
+    stats->dropped = atomic_load_relaxed(&ring->dropped);
+}
+
+/**
+ * @brief 初始化队列
+ *
+ * @param capacity 槽位数，0表示使用默认值
+ * @return ERROR_MESSAGE_T
+ */
+ERROR_MESSAGE_T QueueInit(uint32 capacity)
+{
+    ERROR_MESSAGE_T ret = SUCCESS;
+
+    g_queue = RingQueueCreate(capacity);
+    if (g_queue == NULL)
+    {
+        DLOGE("bufferInit error");
+        ret = MEM_MALLOC_FAIL;
+    }
     return ret;
 }
 
 /**
- * @brief 判断长度是为为空
+ * @brief 入队列
  *
- * @return ERROR_MESSAGE_T TRUE为空，FALSE不为空
+ * @param data 数据指针
+ * @param len 数据长度
+ * @return ERROR_MESSAGE_T 错误码
  * @note
  */
-uint8 IsEmptyQueue()
+ERROR_MESSAGE_T BufferInQueue(const uint8 *data, uint32 len)
 {
-    ERROR_MESSAGE_T ret = TRUE;
     if (g_queue == NULL)
     {
-        ret = TRUE;
+        DLOGE("g_queue is NULL!");
+        return BUF_EMPTY;
     }
-    else
+    return RingQueuePush(g_queue, data, len);
+}
+
+/**
+ * @brief 批量入队列
+ *
+ * @param data 数据指针数组
+ * @param len 数据长度数组
+ * @param count 数据个数
+ * @return uint32 成功入队的个数
+ * @note
+ */
+uint32 BufferInQueueBatch(const uint8 *data[], const uint32 len[], uint32 count)
+{
+    if (g_queue == NULL)
     {
-        //* 进入临界区
-        LOCK();
-        int len = g_queue->size;
-        UNLOCK();
-        ret = len ? FALSE : TRUE;
+        DLOGE("g_queue is NULL!");
+        return 0;
     }
+    return RingQueuePushBatch(g_queue, data, len, count);
+}
 
-    return ret;
+/**
+ * @brief 判断长度是为为空
+ *
+ * @return ERROR_MESSAGE_T TRUE为空，FALSE不为空
+ * @note
+ */
+uint8 IsEmptyQueue()
+{
+    if (g_queue == NULL)
+    {
+        return TRUE;
+    }
+    return RingQueueSize(g_queue) ? FALSE : TRUE;
 }
 
 /**
  * @brief 出队列
  *
- * @param node 指向节点指针的指针
+ * @param node 指向节点指针的指针，处理完后调用BufferReleaseNode归还
  * @return ERROR_MESSAGE_T
  * @note
  */
 ERROR_MESSAGE_T BufferOutQueue(struct List_Node **node)
 {
-    ERROR_MESSAGE_T ret = SUCCESS;
-    BUF_LIST *list = g_queue;
-
-    do
+    if (g_queue == NULL)
     {
-        if (IsEmptyQueue() == TRUE) // 队列为空
-        {
-            ret = BUF_EMPTY;
-            break;
-        }
+        return BUF_EMPTY;
+    }
+    return RingQueuePop(g_queue, node);
+}
 
-        struct List_Node *ppop = NULL; // 出对的节点
-        LOCK();
-        LIST_LPOP(list, ppop);
-        UNLOCK();
+/**
+ * @brief 阻塞出队列
+ *
+ * @param node 指向节点指针的指针，处理完后调用BufferReleaseNode归还
+ * @param timeout_ms 最长等待时间，-1表示一直等待
+ * @return ERROR_MESSAGE_T 超时返回BUF_EMPTY
+ */
+ERROR_MESSAGE_T BufferOutQueueWait(struct List_Node **node, int timeout_ms)
+{
+    if (g_queue == NULL)
+    {
+        return BUF_EMPTY;
+    }
+    return RingQueuePopWait(g_queue, node, timeout_ms);
+}
 
-        //! 出对前判断队列不为空，但是出现了出队失败
-        if (ppop == NULL)
-        {
-            ret = BUF_EMPTY;
-        }
-        else
-        {
-            *node = ppop;
-        }
+/**
+ * @brief 归还出队的节点
+ *
+ * @param node
+ */
+void BufferReleaseNode(struct List_Node *node)
+{
+    if (g_queue != NULL)
+    {
+        RingQueueRelease(g_queue, node);
+    }
+}
 
-    } while (0);
+/**
+ * @brief 关闭队列，生产者停止后调用
+ */
+void BufferCloseQueue(void)
+{
+    if (g_queue != NULL)
+    {
+        RingQueueClose(g_queue);
+    }
+}
 
-    return ret;
+/**
+ * @brief 判断队列是否已关闭
+ *
+ * @return uint8 TRUE已关闭或未初始化，FALSE未关闭
+ */
+uint8 IsClosedQueue(void)
+{
+    if (g_queue == NULL)
+    {
+        return TRUE;
+    }
+    return RingQueueIsClosed(g_queue) ? TRUE : FALSE;
 }
 
 int GetQueueSize(void)
@@ -190,12 +666,20 @@ int GetQueueSize(void)
     int size = 0;
     if (g_queue != NULL)
     {
-        LOCK();
-        size = g_queue->size;
-        UNLOCK();
+        size = RingQueueSize(g_queue);
     }
     return size;
 }
+
+void GetQueueStats(QUEUE_STATS_T *stats)
+{
+    memset(stats, 0, sizeof(QUEUE_STATS_T));
+    if (g_queue != NULL)
+    {
+        RingQueueGetStats(g_queue, stats);
+    }
+}
+
 /**
  * @brief 队列销毁
  *
@@ -206,7 +690,8 @@ void bufferDestroy(void)
 {
     if (g_queue != NULL)
     {
-        LIST_DESTROY(g_queue);
+        RingQueueDestroy(g_queue);
+        g_queue = NULL;
     }
 }
 
@@ -218,20 +703,9 @@ void bufferDestroy(void)
  */
 void ShowQueue(void)
 {
-    BUF_LIST *list = g_queue;
-    if (IsEmptyQueue() == TRUE) // 队列为空
-    {
-        printf("Queue is empty\n");
-    }
-    else
-    {
-        printf("in buffer packet len = %d\n", g_queue->len);
-        LOCK();
-        LIST_FOR_EACH(list)
-        {
-            printf("node %p, len %d\n", curr, curr->len);
-        }
-        UNLOCK();
-    }
+    QUEUE_STATS_T stats;
+    GetQueueStats(&stats);
+    printf("queue capacity %u, size %u, high water %u, enqueued %llu, dequeued %llu, dropped %llu\n",
+           stats.capacity, stats.size, stats.high_water, stats.enqueued, stats.dequeued, stats.dropped);
 }
 #endif
@@ -1,12 +1,12 @@
 /**
  * @file queue.h
  * @author your name (you@domain.com)
- * @brief 
+ * @brief
  * @version 0.1
  * @date 2025-07-15
- * 
+ *
  * @copyright Copyright (c) 2025
- * 
+ *
  */
 #ifndef QUEUE_H
 #define QUEUE_H
@@ -15,6 +15,7 @@
 typedef unsigned char uint8;
 typedef unsigned short uint16;
 typedef unsigned int uint32;
+typedef unsigned long long uint64;
 
 typedef enum ERROR_MESSAGE{
     SUCCESS,            //成功
@@ -29,181 +30,83 @@ typedef enum ERROR_MESSAGE{
     FILE_OPEN_FAIL,     //文件打开失败
 }ERROR_MESSAGE_T;
 
-//* 判断是否可入队
-#define LIST_JUDGE_IN(max_pck, max_len, list, ret)       \
-    do                                                       \
-    {                                                        \
-        if ((list->size > max_pck) || (list->len > max_len)) \
-            ret = ETH_TRUE;                              \
-        else                                                 \
-            ret = ETH_FALSE;                             \
-    } while (0);
+#define QUEUE_CACHE_LINE 64         // 缓存行大小
+#define QUEUE_SLOT_SIZE 1024        // 单个槽位最大报文长度
+#define QUEUE_MIN_DATA_LEN 20       // 更短的报文不是有效上报，不入队
+#define QUEUE_DEFAULT_CAPACITY 1024 // 默认槽位数
 
-//* 列表队尾入队
-#define LIST_RPUSH(list, node)          \
-    do                                      \
-    {                                       \
-        if (list->head)                     \
-        {                                   \
-            node->prev = list->tail;        \
-            node->next = NULL;              \
-            list->tail->next = node;        \
-            list->tail = node;              \
-        }                                   \
-        else                                \
-        {                                   \
-            list->head = list->tail = node; \
-            node->prev = node->next = NULL; \
-        }                                   \
-        ++list->size;                       \
-        list->len += node->len;             \
-    } while (0)
-
-//* 列表队尾出队，node使用前赋空
-#define LIST_RPOP(list, node)                       \
-    do                                                  \
-    {                                                   \
-        if (list->size)                                 \
-        {                                               \
-            node = list->tail;                          \
-            if (--self->size)                           \
-                (self->tail = node->prev)->next = NULL; \
-            else                                        \
-                self->tail = self->head = NULL;         \
-            node->next = node->prev = NULL;             \
-            list->len -= node->len;                     \
-        }                                               \
-    } while (0)
-
-//* 列表对首入队
-#define LIST_LPUSH(list, node)          \
-    do                                      \
-    {                                       \
-        if (list->size)                     \
-        {                                   \
-            node->next = list->head;        \
-            node->prev = NULL;              \
-            list->head->prev = node;        \
-            list->head = node;              \
-        }                                   \
-        else                                \
-        {                                   \
-            list->head = list->tail = node; \
-            node->prev = node->next = NULL; \
-        }                                   \
-        ++list->len;                        \
-        list->len += node->len;             \
-    } while (0)
-
-//* 列表对首出队，node使用前赋空
-#define LIST_LPOP(list, node)                       \
-    do                                                  \
-    {                                                   \
-        if (list->size)                                 \
-        {                                               \
-            node = list->head;                          \
-            if (--list->size)                           \
-                (list->head = node->next)->prev = NULL; \
-            else                                        \
-                list->head = list->tail = NULL;         \
-            node->next = node->prev = NULL;             \
-            list->len -= node->len;                     \
-        }                                               \
-    } while (0)
-
-//* 直接访问列表成员
-#define LIST_GET(list, node)   \
-    do                             \
-    {                              \
-        node = list->worked;       \
-        list->worked = node->next; \
-        list->offset++;            \
-    } while (0)
-
-//* 移除列表成员，使用前确定入参非空
-#define LIST_REMOVE_NODE(list, node)                                          \
-    do                                                                            \
-    {                                                                             \
-        node->prev ? (node->prev->next = node->next) : (list->head = node->next); \
-        node->next ? (node->next->prev = node->prev) : (list->tail = node->prev); \
-        list->len -= node->len;                                                   \
-        free(node);                                                               \
-        node = NULL;                                                              \
-        --list->size;                                                             \
-    } while (0)
-
-//* 列表节点释放
-#define LIST_NODE_FREE(node) \
-    do                           \
-    {                            \
-        if (node != NULL)        \
-            free(node);          \
-        node = NULL;             \
-    } while (0)
-
-//* 队列销毁
-#define LIST_DESTROY(list)               \
-    struct List_Node *next;              \
-    struct List_Node *curr = list->head; \
-    while (list->size--)                     \
-    {                                        \
-        next = curr->next;                   \
-        LIST_NODE_FREE(curr);            \
-        curr = next;                         \
-    }                                        \
-    list->len = 0;                           \
-    free(list);                              \
-    list = NULL;
-
-//* 队列遍历
-#define LIST_FOR_EACH(list) for (struct List_Node *curr = list->head; curr != NULL; curr = curr->next)
-
-// 数据节点
+// 数据节点，即环形队列中预分配的槽位，按缓存行对齐
 typedef struct List_Node
 {
-    struct List_Node *prev;
-    struct List_Node *next;
-
+    uint64 seq;       // 槽位序号，生产者写完数据后置为 pos + 1
     unsigned int len; // 数据长度
-    unsigned char data[];
-} __attribute__((packed)) List_Node_ST;
+    uint64 enqueue_ns; // 入队时的单调时间，用于统计排队时间
+    unsigned char data[QUEUE_SLOT_SIZE + 1]; // 多留一个字节放结束符
+} __attribute__((aligned(QUEUE_CACHE_LINE))) List_Node_ST;
 
-// 队列结构
-typedef struct BUF_LIST_ST
+// 多生产者单消费者有界环形队列
+typedef struct Ring_Queue
 {
-    struct List_Node *head; // 对列头节点
-    struct List_Node *tail; // 队列尾节点
-    int size; //* 包数
-    int len;  //* 总长度
-} BUF_LIST;
+    List_Node_ST *slots; // 预分配的槽位
+    uint32 capacity;     // 槽位数，2的幂
+    uint32 mask;
+
+    uint64 head __attribute__((aligned(QUEUE_CACHE_LINE))); //* 生产者位置
+    uint64 tail __attribute__((aligned(QUEUE_CACHE_LINE))); //* 消费者位置
+
+    uint32 waiting __attribute__((aligned(QUEUE_CACHE_LINE))); //* 消费者是否在等待
+    int event_fd;                                              //* 唤醒消费者的eventfd
+    uint32 closed;                                             //* 不会再有新数据，取完即可退出
 
-/*************************************
-* @brief 原子锁加锁
-* @param 参数1：NULL
-* @return 无
-*************************************/
-void atomic_lock_api(void);
-/*************************************
-* @brief 原子锁解锁
-* @param 参数1：NULL
-* @return 无
-*************************************/
-void atomic_unlock_api(void);
+    uint32 space_waiters __attribute__((aligned(QUEUE_CACHE_LINE))); //* 等待空位的生产者数
+    int space_event_fd;                                              //* 唤醒生产者的eventfd
 
-#define LOCK()      atomic_lock_api()
-#define UNLOCK()    atomic_unlock_api()
+    uint64 dropped __attribute__((aligned(QUEUE_CACHE_LINE))); //* 队列满丢弃的包数
+    uint32 high_water;                                         //* 历史最大深度
+} RING_QUEUE_T;
+
+// 队列统计
+typedef struct Queue_Stats
+{
+    uint32 capacity;   // 槽位数
+    uint32 size;       // 当前包数
+    uint32 high_water; // 历史最大深度
+    uint64 enqueued;   // 累计入队包数
+    uint64 dequeued;   // 累计出队包数
+    uint64 dropped;    // 队列满丢弃的包数
+} QUEUE_STATS_T;
 
 //* TODO:区分不同编译器对likely的命名
 #define likely(x) __builtin_expect(!!(x), 1)
 #define unlikely(x) __builtin_expect(!!(x), 0)
 
+/****************************环形队列接口定义********************************************************/
+RING_QUEUE_T *RingQueueCreate(uint32 capacity);
+void RingQueueDestroy(RING_QUEUE_T *ring);
+ERROR_MESSAGE_T RingQueuePush(RING_QUEUE_T *ring, const uint8 *data, uint32 len);
+ERROR_MESSAGE_T RingQueuePushWait(RING_QUEUE_T *ring, const uint8 *data, uint32 len, int timeout_ms);
+uint32 RingQueuePushBatch(RING_QUEUE_T *ring, const uint8 *data[], const uint32 len[], uint32 count);
+ERROR_MESSAGE_T RingQueuePop(RING_QUEUE_T *ring, struct List_Node **node);
+ERROR_MESSAGE_T RingQueuePopWait(RING_QUEUE_T *ring, struct List_Node **node, int timeout_ms);
+void RingQueueRelease(RING_QUEUE_T *ring, struct List_Node *node);
+void RingQueueClose(RING_QUEUE_T *ring);
+int RingQueueIsClosed(RING_QUEUE_T *ring);
+int RingQueueSize(RING_QUEUE_T *ring);
+void RingQueueGetStats(RING_QUEUE_T *ring, QUEUE_STATS_T *stats);
+
 /****************************函数接口定义************************************************************/
-ERROR_MESSAGE_T QueueInit(void);
+ERROR_MESSAGE_T QueueInit(uint32 capacity);
 ERROR_MESSAGE_T BufferInQueue(const uint8 *data, uint32 len);
+uint32 BufferInQueueBatch(const uint8 *data[], const uint32 len[], uint32 count);
 ERROR_MESSAGE_T BufferOutQueue(struct List_Node **node);
+ERROR_MESSAGE_T BufferOutQueueWait(struct List_Node **node, int timeout_ms);
+void BufferReleaseNode(struct List_Node *node);
+void BufferCloseQueue(void);
+uint8 IsClosedQueue(void);
 uint8 IsEmptyQueue(void);
 void bufferDestroy(void);
 int GetQueueSize(void);
+void GetQueueStats(QUEUE_STATS_T *stats);
 #ifdef DEBUG
 void ShowQueue(void);
 #endif
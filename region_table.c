@@ -0,0 +1,248 @@
+/**
+ * @file region_table.c
+ * @brief 预编译的IPv4国内/国外区间表
+ * @note 加载时遍历一次xdb的segment索引，把结论相同的相邻区间合并，
+ *       查询时先按/16前缀定位，再在很小的范围内二分，不做任何字符串处理
+ * @version 0.1
+ * @date 2025-08-04
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // memmem
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "xdb_searcher.h"
+#include "file_watch.h"
+#include "dlog.h"
+#include "region_table.h"
+
+#define DOMESTIC_REGION "中国"
+
+static region_table_t *current_table = NULL; // 当前生效的表，处理线程无锁读取
+static region_table_t *retired_table = NULL; // 上一张表，下次重建时才释放
+static file_watch_t db_watch;
+
+/**
+ * @brief 区间追加到表尾，与上一个区间结论相同时合并
+ *
+ * @param table
+ * @param start 区间起始地址
+ * @param domestic 结论
+ */
+static void region_table_append(region_table_t *table, uint32 start, uint8 domestic)
+{
+    if (table->count > 0)
+    {
+        uint32 last = table->count - 1;
+        if (((table->domestic[last >> 3] >> (last & 7)) & 1) == domestic)
+        {
+            return;
+        }
+    }
+    table->starts[table->count] = start;
+    if (domestic)
+    {
+        table->domestic[table->count >> 3] |= (uint8)(1 << (table->count & 7));
+    }
+    table->count++;
+}
+
+/**
+ * @brief 由xdb文件编译区间表
+ * @note xdb中没有覆盖的地址按查不到处理，即不是中国IP
+ * @param db_path
+ * @return region_table_t* 失败返回NULL
+ */
+region_table_t *region_table_build(const char *db_path)
+{
+    xdb_searcher_t searcher;
+    region_table_t *table = NULL;
+    const char *buffer;
+    unsigned int start_ptr, end_ptr, segments, length;
+    unsigned long long next = 0; // 下一个期望的起始地址，用于发现空洞
+    long s_time = xdb_now();
+
+    if (xdb_new_with_mmap(&searcher, db_path) != 0)
+    {
+        DLOGE("failed to map xdb `%s`", db_path);
+        return NULL;
+    }
+    buffer = searcher.content->buffer;
+    length = searcher.content->length;
+    start_ptr = xdb_get_uint(buffer, 8);
+    end_ptr = xdb_get_uint(buffer, 12);
+    if (start_ptr < xdb_header_info_length || end_ptr < start_ptr ||
+        end_ptr + xdb_segment_index_size > length)
+    {
+        DLOGE("invalid segment index [%u, %u] in `%s`", start_ptr, end_ptr, db_path);
+        goto fail;
+    }
+
+    // 每个segment至多带来两个区间(前面的空洞和它自己)
+    segments = (end_ptr - start_ptr) / xdb_segment_index_size + 1;
+    table = (region_table_t *)calloc(1, sizeof(region_table_t));
+    if (table == NULL)
+    {
+        goto fail;
+    }
+    table->starts = (uint32 *)malloc(sizeof(uint32) * (segments * 2 + 1));
+    table->domestic = (uint8 *)calloc((segments * 2 + 1 + 7) / 8, 1);
+    if (table->starts == NULL || table->domestic == NULL)
+    {
+        goto fail;
+    }
+
+    for (unsigned int p = start_ptr; p <= end_ptr; p += xdb_segment_index_size)
+    {
+        const char *segment = buffer + p;
+        unsigned int sip = xdb_get_uint(segment, 0);
+        unsigned int eip = xdb_get_uint(segment, 4);
+        unsigned int data_len = (unsigned int)xdb_get_ushort(segment, 8);
+        unsigned int data_ptr = xdb_get_uint(segment, 10);
+        uint8 domestic = 0;
+
+        if (sip < next || eip < sip || (unsigned long long)data_ptr + data_len > length)
+        {
+            DLOGE("invalid segment at %u in `%s`", p, db_path);
+            goto fail;
+        }
+        if (sip > next)
+        {
+            region_table_append(table, (uint32)next, 0);
+        }
+        if (data_len > 0 && memmem(buffer + data_ptr, data_len, DOMESTIC_REGION, strlen(DOMESTIC_REGION)) != NULL)
+        {
+            domestic = 1;
+        }
+        region_table_append(table, sip, domestic);
+        next = (unsigned long long)eip + 1;
+    }
+    if (next <= 0xFFFFFFFFULL)
+    {
+        region_table_append(table, (uint32)next, 0);
+    }
+
+    // 为每个/16前缀记录其第一个地址所在的区间
+    for (uint32 prefix = 0, i = 0; prefix < REGION_TABLE_PREFIX_COUNT; prefix++)
+    {
+        uint32 ip = prefix << 16;
+        while (i + 1 < table->count && table->starts[i + 1] <= ip)
+        {
+            i++;
+        }
+        table->prefix_index[prefix] = i;
+    }
+    table->prefix_index[REGION_TABLE_PREFIX_COUNT] = table->count - 1;
+
+    xdb_close(&searcher);
+    DLOGI("region table built from %u segments into %u ranges, cost: %ld μs",
+           segments, table->count, xdb_now() - s_time);
+    return table;
+
+fail:
+    region_table_free(table);
+    xdb_close(&searcher);
+    return NULL;
+}
+
+/**
+ * @brief 释放区间表
+ *
+ * @param table
+ */
+void region_table_free(region_table_t *table)
+{
+    if (table != NULL)
+    {
+        free(table->starts);
+        free(table->domestic);
+        free(table);
+    }
+}
+
+/**
+ * @brief 编译区间表并开始监视db文件
+ *
+ * @param db_path 调用者保证在运行期间有效
+ * @return int 0成功
+ */
+int region_table_init(const char *db_path)
+{
+    region_table_t *table;
+    file_watch_init(&db_watch, db_path, REGION_TABLE_CHECK_INTERVAL);
+    table = region_table_build(db_path);
+    if (table == NULL)
+    {
+        return 1;
+    }
+    __atomic_store_n(&current_table, table, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void region_table_deinit(void)
+{
+    region_table_free(__atomic_exchange_n(&current_table, NULL, __ATOMIC_ACQ_REL));
+    region_table_free(retired_table);
+    retired_table = NULL;
+}
+
+/**
+ * @brief db文件变化后重建区间表
+ * @note 只能由一个线程调用；旧表延后到下一次重建才释放，
+ *       此时处理线程早已完成对它的查询
+ */
+void region_table_check_reload(void)
+{
+    region_table_t *table;
+    if (!file_watch_changed(&db_watch))
+    {
+        return;
+    }
+    DLOGI("database `%s` changed, rebuilding region table", db_watch.path);
+    table = region_table_build(db_watch.path);
+    if (table == NULL)
+    {
+        DLOGW("failed to rebuild region table, keep the old one");
+        return;
+    }
+    region_table_free(retired_table);
+    retired_table = __atomic_exchange_n(&current_table, table, __ATOMIC_ACQ_REL);
+}
+
+/**
+ * @brief 查询IP是否为中国IP
+ *
+ * @param ip 主机字节序的IPv4地址
+ * @param is_china 返回值指针，设置为1表示是中国IP，0表示不是中国IP
+ * @return int 0成功，1表示区间表不可用
+ */
+int region_table_lookup(uint32 ip, char *is_china)
+{
+    const region_table_t *table = __atomic_load_n(&current_table, __ATOMIC_ACQUIRE);
+    if (table == NULL)
+    {
+        return 1;
+    }
+    uint32 prefix = ip >> 16;
+    uint32 lo = table->prefix_index[prefix];
+    uint32 hi = table->prefix_index[prefix + 1];
+    // 找 [lo, hi] 中最后一个 starts <= ip 的区间，starts[lo] <= ip 必然成立
+    while (lo < hi)
+    {
+        uint32 mid = (lo + hi + 1) >> 1;
+        if (table->starts[mid] <= ip)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+    *is_china = (char)((table->domestic[lo >> 3] >> (lo & 7)) & 1);
+    return 0;
+}
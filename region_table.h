@@ -0,0 +1,43 @@
+/**
+ * @file region_table.h
+ * @brief 预编译的IPv4国内/国外区间表
+ * @version 0.1
+ * @date 2025-08-04
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#ifndef REGION_TABLE_H
+#define REGION_TABLE_H
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include "queue.h"
+
+#define REGION_TABLE_PREFIX_COUNT 65536 // /16前缀个数
+// 检查db文件变化的间隔，单位毫秒，测试时可由编译参数改小
+#ifndef REGION_TABLE_CHECK_INTERVAL
+#define REGION_TABLE_CHECK_INTERVAL 5000
+#endif
+
+// 合并后的区间表：starts[i] 到 starts[i + 1] - 1 属于同一结论
+typedef struct region_table
+{
+    uint32 count;     // 区间数
+    uint32 *starts;   // 区间起始地址，升序，starts[0] == 0
+    uint8 *domestic;  // 结论位图，1表示中国IP
+    uint32 prefix_index[REGION_TABLE_PREFIX_COUNT + 1]; // 每个/16前缀第一个地址所在的区间下标
+} region_table_t;
+
+region_table_t *region_table_build(const char *db_path);
+void region_table_free(region_table_t *table);
+int region_table_init(const char *db_path);
+void region_table_deinit(void);
+void region_table_check_reload(void);
+int region_table_lookup(uint32 ip, char *is_china);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,153 @@
+/**
+ * @file rule_ipset.cpp
+ * @brief 把只有地址不同的连续规则编译成ipset
+ * @version 0.1
+ * @date 2025-08-14
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#include "rule_ipset.h"
+
+#include <cstdio>
+#include <cstdint>
+
+#define IPSET_ADDRESS_MARK "\x01" // 规则模板中地址的位置
+
+// 每条规则各自计数或记录状态的匹配模块，多条规则合并成一条后含义会变
+static const char* const kStatefulMatches[] = {"limit", "quota", "recent", "connlimit", "statistic"};
+
+/**
+ * @brief 判断是否为IPv4地址或网段，hash:net不能存放/0
+ */
+static bool is_ipv4_net(const std::string& value) {
+    unsigned a, b, c, d, prefix = 32;
+    char tail;
+    int n = sscanf(value.c_str(), "%u.%u.%u.%u/%u%c", &a, &b, &c, &d, &prefix, &tail);
+    if (n != 4 && n != 5) {
+        return false;
+    }
+    if (n == 4 && value.find('/') != std::string::npos) {
+        return false;
+    }
+    return a <= 255 && b <= 255 && c <= 255 && d <= 255 && prefix >= 1 && prefix <= 32 &&
+           value.find_first_not_of("0123456789./") == std::string::npos;
+}
+
+/**
+ * @brief 拆出规则模板
+ *
+ * @param line 规则行
+ * @param key 输出，地址替换为标记后的规则
+ * @param address 输出，地址
+ * @param direction 输出，"src" 或 "dst"
+ * @return true 规则只有一个可以放入集合的地址
+ */
+static bool split_address(const std::string& line, std::string* key, std::string* address,
+                          std::string* direction) {
+    if (line.compare(0, 3, "-A ") != 0 || line.find('"') != std::string::npos) {
+        return false;
+    }
+    std::vector<std::string> tokens;
+    for (size_t pos = 0; pos < line.size();) {
+        size_t end = line.find_first_of(" \t", pos);
+        if (end == std::string::npos) {
+            end = line.size();
+        }
+        if (end > pos) {
+            tokens.push_back(line.substr(pos, end - pos));
+        }
+        pos = end + 1;
+    }
+    int found = -1;
+    for (size_t i = 2; i + 1 < tokens.size(); i++) {
+        const std::string& token = tokens[i];
+        if (token == "-m" || token == "--match") {
+            for (const char* match : kStatefulMatches) {
+                if (tokens[i + 1] == match) {
+                    return false;
+                }
+            }
+        }
+        bool is_src = token == "-s" || token == "--source" || token == "--src";
+        bool is_dst = token == "-d" || token == "--destination" || token == "--dst";
+        if (!is_src && !is_dst) {
+            continue;
+        }
+        // 取反的地址和有多个地址的规则不合并
+        if (found >= 0 || tokens[i - 1] == "!" || !is_ipv4_net(tokens[i + 1])) {
+            return false;
+        }
+        found = i;
+        *direction = is_src ? "src" : "dst";
+    }
+    if (found < 0) {
+        return false;
+    }
+    *address = tokens[found + 1];
+    key->clear();
+    for (size_t i = 0; i < tokens.size(); i++) {
+        if (i > 0) {
+            key->push_back(' ');
+        }
+        if ((int)i == found) {
+            key->append(IPSET_ADDRESS_MARK);
+            i++;
+        } else {
+            key->append(tokens[i]);
+        }
+    }
+    return true;
+}
+
+static std::string ipset_name(const std::string& table, size_t ordinal, const std::string& key) {
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (char c : table + " " + std::to_string(ordinal) + " " + key) {
+        hash = (hash ^ (unsigned char)c) * 16777619u;
+    }
+    char name[32];
+    snprintf(name, sizeof(name), IPSET_NAME_PREFIX "%08x", hash);
+    return name;
+}
+
+std::vector<IpsetRun> find_ipset_runs(const std::vector<std::string>& lines, const std::string& table,
+                                      size_t min_run, size_t ordinal) {
+    std::vector<IpsetRun> runs;
+    std::string run_key;
+    std::string run_direction;
+    IpsetRun run;
+    auto close_run = [&]() {
+        if (run.count >= min_run && min_run > 0) {
+            run.name = ipset_name(table, ordinal + runs.size(), run_key + " " + run_direction);
+            run.rule = run_key;
+            run.rule.replace(run.rule.find(IPSET_ADDRESS_MARK), 1,
+                             "-m set --match-set " + run.name + " " + run_direction);
+            runs.push_back(run);
+        }
+        run.count = 0;
+        run.members.clear();
+        run_key.clear();
+    };
+    run.count = 0;
+    for (size_t i = 0; i < lines.size(); i++) {
+        std::string key;
+        std::string address;
+        std::string direction;
+        if (!split_address(lines[i], &key, &address, &direction)) {
+            close_run();
+            continue;
+        }
+        if (run.count > 0 && (key != run_key || direction != run_direction)) {
+            close_run();
+        }
+        if (run.count == 0) {
+            run.first = i;
+            run_key = key;
+            run_direction = direction;
+        }
+        run.members.push_back(address);
+        run.count++;
+    }
+    close_run();
+    return runs;
+}
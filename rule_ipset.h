@@ -0,0 +1,44 @@
+/**
+ * @file rule_ipset.h
+ * @brief 把只有地址不同的连续规则编译成ipset
+ * @version 0.1
+ * @date 2025-08-14
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#ifndef RULE_IPSET_H
+#define RULE_IPSET_H
+
+#include <string>
+#include <vector>
+
+#define IPSET_NAME_PREFIX "oemfw_"
+#define IPSET_DEFAULT_MIN_RUN 8 // 至少这么多条连续规则才编译成ipset
+
+// 一段可以合并的规则
+struct IpsetRun {
+    std::string name;                 // 集合名，由表名、序号和规则模板生成，规则文件不变时重启后不变
+    size_t first;                     // 第一条规则在输入中的下标
+    size_t count;                     // 规则条数
+    std::vector<std::string> members; // 地址或网段
+    std::string rule;                 // 代替这段规则的匹配规则
+};
+
+/**
+ * @brief 查找只有 -s 或 -d 地址不同的连续 -A 规则
+ * @note 例如 "-A OUTPUT -d 1.2.3.4 -j DROP"，"-A OUTPUT -d 5.6.7.0/24 -j DROP" 合并为
+ *       "-A OUTPUT -m set --match-set oemfw_xxxxxxxx dst -j DROP"；
+ *       带limit、quota等有状态匹配的规则合并后含义会变，不参与合并
+ *
+ * @param lines 同一张表的规则行
+ * @param table 表名，参与集合名的计算
+ * @param min_run 最少的连续规则条数
+ * @param ordinal 第一段规则的序号，参与集合名的计算，模板相同的多段规则因此不会共用一个集合；
+ *                同一张表分多批编译时传入之前各批找到的段数
+ * @return std::vector<IpsetRun> 按下标升序
+ */
+std::vector<IpsetRun> find_ipset_runs(const std::vector<std::string>& lines, const std::string& table,
+                                      size_t min_run, size_t ordinal = 0);
+
+#endif
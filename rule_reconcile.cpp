@@ -0,0 +1,313 @@
+/**
+ * @file rule_reconcile.cpp
+ * @brief 规则文件与内核当前规则的差量计算
+ * @version 0.1
+ * @date 2025-08-12
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#include "rule_reconcile.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+// 一个选项及其参数，例如 {"!", "-s", "1.2.3.4/32"}
+typedef std::vector<std::string> RuleOption;
+
+struct ChainRule {
+    std::string canonical;  // 规范化后的规则，用于比较
+    std::string line;       // 原始规则行，用于下发
+};
+
+static const char* const kBuiltinChains[] = {"INPUT", "OUTPUT", "FORWARD", "PREROUTING",
+                                             "POSTROUTING"};
+
+/**
+ * @brief 按空白切分，引号内的空白不切分，并去掉引号
+ */
+static std::vector<std::string> split_tokens(const std::string& text) {
+    std::vector<std::string> tokens;
+    std::string token;
+    bool in_token = false;
+    bool quoted = false;
+    for (char c : text) {
+        if (c == '"') {
+            quoted = !quoted;
+            in_token = true;
+        } else if (!quoted && (c == ' ' || c == '\t' || c == '\r' || c == '\n')) {
+            if (in_token) {
+                tokens.push_back(token);
+                token.clear();
+                in_token = false;
+            }
+        } else {
+            token.push_back(c);
+            in_token = true;
+        }
+    }
+    if (in_token) {
+        tokens.push_back(token);
+    }
+    return tokens;
+}
+
+static std::string long_option(const std::string& option) {
+    static const std::map<std::string, std::string> kShortOptions = {
+        {"--source", "-s"},        {"--src", "-s"},          {"--destination", "-d"},
+        {"--dst", "-d"},           {"--in-interface", "-i"}, {"--out-interface", "-o"},
+        {"--protocol", "-p"},      {"--jump", "-j"},         {"--goto", "-g"},
+        {"--match", "-m"},         {"--fragment", "-f"},     {"--source-port", "--sport"},
+        {"--destination-port", "--dport"},
+    };
+    auto it = kShortOptions.find(option);
+    return it == kShortOptions.end() ? option : it->second;
+}
+
+static bool is_option(const std::string& token) {
+    return token == "!" || (token.size() > 1 && token[0] == '-' &&
+                            !(token[1] >= '0' && token[1] <= '9'));
+}
+
+static std::string canonical_address(const std::string& address) {
+    if (address.find('/') == std::string::npos && address.find(':') == std::string::npos) {
+        return address + "/32";
+    }
+    return address;
+}
+
+std::string canonical_rule(const std::string& spec) {
+    std::vector<std::string> tokens = split_tokens(spec);
+    std::vector<RuleOption> options;
+    for (size_t i = 0; i < tokens.size();) {
+        RuleOption option;
+        if (tokens[i] == "!") {
+            option.push_back(tokens[i++]);
+            if (i == tokens.size()) {
+                break;
+            }
+        }
+        option.push_back(long_option(tokens[i++]));
+        while (i < tokens.size() && !is_option(tokens[i])) {
+            option.push_back(tokens[i++]);
+        }
+        options.push_back(option);
+    }
+
+    // iptables -S 先输出基本匹配，再按原顺序输出扩展匹配，最后是目标
+    static const char* const kBaseOrder[] = {"-s", "-d", "-i", "-o", "-p", "-f"};
+    std::vector<RuleOption> base[6];
+    std::vector<RuleOption> matches;
+    std::vector<RuleOption> target;
+    std::string protocol;
+    std::set<std::string> explicit_matches;
+    for (RuleOption& option : options) {
+        const std::string& name = option[option[0] == "!" ? 1 : 0];
+        const std::string* value = (option.size() > (option[0] == "!" ? 2u : 1u)) ? &option.back() : nullptr;
+        const char* const* base_it = std::find_if(std::begin(kBaseOrder), std::end(kBaseOrder),
+                                                  [&](const char* n) { return name == n; });
+        if (!target.empty() || name == "-j" || name == "-g") {
+            target.push_back(option);
+        } else if (base_it != std::end(kBaseOrder)) {
+            if ((name == "-s" || name == "-d") && value != nullptr) {
+                option.back() = canonical_address(*value);
+                if (option.back() == "0.0.0.0/0" && option[0] != "!") {
+                    continue;
+                }
+            }
+            if (name == "-p" && value != nullptr) {
+                std::transform(option.back().begin(), option.back().end(), option.back().begin(),
+                               ::tolower);
+                protocol = option.back();
+            }
+            base[base_it - std::begin(kBaseOrder)].push_back(option);
+        } else {
+            if (name == "-m" && value != nullptr) {
+                explicit_matches.insert(*value);
+            }
+            matches.push_back(option);
+        }
+    }
+
+    // 使用 --dport 等协议选项而没有写 -m 时，iptables 会隐式加载同名匹配
+    if ((protocol == "tcp" || protocol == "udp" || protocol == "icmp") &&
+        explicit_matches.count(protocol) == 0) {
+        for (size_t i = 0; i < matches.size(); i++) {
+            const std::string& name = matches[i][matches[i][0] == "!" ? 1 : 0];
+            if (name != "-m" && name.compare(0, 2, "--") == 0) {
+                matches.insert(matches.begin() + i, RuleOption{"-m", protocol});
+                break;
+            }
+        }
+    }
+    if (!target.empty() && target[0].size() == 2 && target[0][0] == "-j" &&
+        target[0][1] == "REJECT" && target.size() == 1) {
+        target.push_back(RuleOption{"--reject-with", "icmp-port-unreachable"});
+    }
+
+    std::string result;
+    auto append = [&result](const std::vector<RuleOption>& list) {
+        for (const RuleOption& option : list) {
+            for (const std::string& token : option) {
+                if (!result.empty()) {
+                    result.push_back(' ');
+                }
+                result.append(token);
+            }
+        }
+    };
+    for (const std::vector<RuleOption>& list : base) {
+        append(list);
+    }
+    append(matches);
+    append(target);
+    return result;
+}
+
+/**
+ * @brief 拆分 "-A CHAIN spec" 形式的规则行
+ *
+ * @return 命令，例如 "-A"；无法识别时返回空字符串
+ */
+static std::string split_rule(const std::string& line, std::string* chain, std::string* spec) {
+    std::vector<std::string> tokens = split_tokens(line);
+    if (tokens.size() < 2) {
+        return "";
+    }
+    std::string command = tokens[0];
+    *chain = tokens[1];
+    size_t skip = 2;
+    // -I CHAIN [位置] spec，位置不参与比较
+    if (command == "-I" && tokens.size() > 2 && !is_option(tokens[2])) {
+        skip = 3;
+    }
+    size_t pos = 0;
+    for (size_t i = 0; i < skip; i++) {
+        pos = line.find(tokens[i], pos) + tokens[i].size();
+    }
+    *spec = (pos < line.size()) ? line.substr(pos) : "";
+    return command;
+}
+
+static bool is_builtin_chain(const std::string& chain) {
+    return std::find(std::begin(kBuiltinChains), std::end(kBuiltinChains), chain) !=
+           std::end(kBuiltinChains);
+}
+
+bool reconcile_table(const std::vector<std::string>& desired, const std::string& live,
+                     std::string* delta) {
+    // 当前状态：链 -> 规则
+    std::set<std::string> live_chains;
+    std::map<std::string, std::vector<std::string>> live_rules;
+    std::string chain;
+    std::string spec;
+    std::string line;
+    for (size_t start = 0; start < live.size();) {
+        size_t end = live.find('\n', start);
+        if (end == std::string::npos) {
+            end = live.size();
+        }
+        line = live.substr(start, end - start);
+        start = end + 1;
+        std::string command = split_rule(line, &chain, &spec);
+        if (command == "-P" || command == "-N") {
+            live_chains.insert(chain);
+        } else if (command == "-A") {
+            live_rules[chain].push_back(canonical_rule(spec));
+        }
+    }
+
+    // 目标状态
+    std::vector<std::string> owned_chains;  // 按文件顺序
+    std::map<std::string, std::vector<ChainRule>> desired_rules;
+    std::vector<std::string> other_chains;  // 只补充规则的链，按文件顺序
+    std::map<std::string, std::vector<ChainRule>> removed_rules;
+    for (const std::string& desired_line : desired) {
+        std::string command = split_rule(desired_line, &chain, &spec);
+        bool owned = std::find(owned_chains.begin(), owned_chains.end(), chain) !=
+                     owned_chains.end();
+        if (command == "-N") {
+            if (std::find(other_chains.begin(), other_chains.end(), chain) != other_chains.end()) {
+                return false;  // 创建前已经引用过的链
+            }
+            if (!owned && !is_builtin_chain(chain)) {
+                owned_chains.push_back(chain);
+            }
+            continue;
+        }
+        if (command == "-F" && owned) {
+            desired_rules[chain].clear();
+            continue;
+        }
+        if (command != "-A" && command != "-I" && command != "-D") {
+            return false;  // -P、-X、-R、-Z 等命令不做差量比较
+        }
+        if (!owned && desired_rules.count(chain) == 0 && removed_rules.count(chain) == 0) {
+            other_chains.push_back(chain);
+        }
+        ChainRule rule{canonical_rule(spec), desired_line};
+        std::vector<ChainRule>& rules = desired_rules[chain];
+        if (command == "-D") {
+            auto it = std::find_if(rules.begin(), rules.end(), [&](const ChainRule& r) {
+                return r.canonical == rule.canonical;
+            });
+            if (it != rules.end()) {
+                rules.erase(it);
+            } else if (!owned) {
+                removed_rules[chain].push_back(rule);
+            }
+        } else if (command == "-I" && owned) {
+            return false;  // 自有链中插入的位置无法与重建后的顺序对应
+        } else {
+            rules.push_back(rule);
+        }
+    }
+
+    delta->clear();
+    for (const std::string& owned : owned_chains) {
+        if (live_chains.count(owned) == 0) {
+            delta->append("-N " + owned + "\n");
+        }
+    }
+    for (const std::string& owned : owned_chains) {
+        const std::vector<ChainRule>& rules = desired_rules[owned];
+        const std::vector<std::string>& current = live_rules[owned];
+        size_t same = 0;
+        while (same < rules.size() && same < current.size() &&
+               rules[same].canonical == current[same]) {
+            same++;
+        }
+        if (same == rules.size() && same == current.size()) {
+            continue;
+        }
+        if (same < current.size()) {
+            // 不只是缺少尾部规则，在同一事务中清空重建，不会出现只有一半规则的状态
+            delta->append("-F " + owned + "\n");
+            same = 0;
+        }
+        for (size_t i = same; i < rules.size(); i++) {
+            delta->append(rules[i].line + "\n");
+        }
+    }
+    for (const std::string& other : other_chains) {
+        // 其他链中可能有netd等模块的规则，只删除文件中要求删除的、补充缺少的
+        std::vector<std::string> current = live_rules[other];
+        for (const ChainRule& rule : removed_rules[other]) {
+            auto it = std::find(current.begin(), current.end(), rule.canonical);
+            if (it != current.end()) {
+                current.erase(it);
+                delta->append(rule.line + "\n");
+            }
+        }
+        for (const ChainRule& rule : desired_rules[other]) {
+            auto it = std::find(current.begin(), current.end(), rule.canonical);
+            if (it != current.end()) {
+                current.erase(it);
+            } else {
+                delta->append(rule.line + "\n");
+            }
+        }
+    }
+    return true;
+}
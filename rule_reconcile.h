@@ -0,0 +1,40 @@
+/**
+ * @file rule_reconcile.h
+ * @brief 规则文件与内核当前规则的差量计算
+ * @version 0.1
+ * @date 2025-08-12
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#ifndef RULE_RECONCILE_H
+#define RULE_RECONCILE_H
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief 把规则(不含 -A/-I 和链名)规范化成 iptables -S 的输出形式
+ * @note 只处理常见写法：长选项、基本匹配的顺序、地址掩码、隐式的 -m tcp/udp/icmp、
+ *       引号和REJECT的默认参数
+ *
+ * @param spec 例如 "-p tcp --dport 80 -s 1.2.3.4 -j DROP"
+ * @return std::string 例如 "-s 1.2.3.4/32 -p tcp -m tcp --dport 80 -j DROP"
+ */
+std::string canonical_rule(const std::string& spec);
+
+/**
+ * @brief 计算一张表从当前状态到目标状态所需的最少规则
+ * @note 规则文件中 -N 创建的链归本程序所有，内容不一致时在同一事务中清空重建，
+ *       只多出尾部规则时只追加尾部；其余链(内置链或其他模块的链)只补充缺少的规则，
+ *       并执行文件中的 -D
+ *
+ * @param desired 规则文件中该表的规则行，按文件顺序
+ * @param live 该表 iptables -S 的输出
+ * @param delta 输出，iptables-restore 格式的规则行，不含表名和COMMIT，为空表示无需修改
+ * @return true 计算成功；false 规则文件中有无法比较的行，调用者应完整加载
+ */
+bool reconcile_table(const std::vector<std::string>& desired, const std::string& live,
+                     std::string* delta);
+
+#endif
@@ -0,0 +1,103 @@
+// tests/test_aggregate.c
+//
+// Checks that identical DNS events inside the window are collapsed into one
+// record carrying the real count, and that records come out when the window ends.
+//
+// Usage:
+// - In AOSP: `mm` in tests/ and run test_aggregate on the device or host.
+// - On host: gcc -I.. test_aggregate.c ../aggregate.c -lpthread -o test_aggregate
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "aggregate.h"
+
+static char emitted_events[1024][32];
+static uint32 emitted_counts[1024];
+static int emitted = 0;
+
+static void record_emit(const char *event, uint32 count)
+{
+    snprintf(emitted_events[emitted], sizeof(emitted_events[0]), "%s", event);
+    emitted_counts[emitted++] = count;
+}
+
+static void test_key(void)
+{
+    uint32 a[] = {1, 2, 3};
+    uint32 b[] = {3, 1, 2};
+    uint32 c[] = {1, 2};
+    uint64 k = aggregate_key(10001, "com.a", "x.com", a, 3);
+
+    assert(k == aggregate_key(10001, "com.a", "x.com", b, 3)); // IP顺序不影响
+    assert(k != aggregate_key(10001, "com.a", "x.com", c, 2));
+    assert(k != aggregate_key(10002, "com.a", "x.com", a, 3));
+    assert(k != aggregate_key(10001, "com.b", "x.com", a, 3));
+    assert(k != aggregate_key(10001, "com.a", "y.com", a, 3));
+    assert(k != aggregate_key(10001, NULL, "x.com", a, 3));
+    // 进程名和域名的分界不能混淆
+    assert(aggregate_key(1, "ab", "c", a, 0) != aggregate_key(1, "a", "bc", a, 0));
+}
+
+static void test_window(void)
+{
+    aggregator_t *agg = aggregator_create(1000, record_emit);
+    aggregate_stats_t stats;
+
+    emitted = 0;
+    aggregator_add(agg, 1, "a", 1, 0);
+    aggregator_add(agg, 2, "b", 1, 100);
+    for (int i = 0; i < 9; i++)
+    {
+        aggregator_add(agg, 1, "a-dup", 5, 200 + i);
+    }
+    aggregator_flush(agg, 999);
+    assert(emitted == 0);
+    assert(aggregator_timeout(agg, 999, 5000) == 1);
+    aggregator_flush(agg, 1000);
+    assert(emitted == 1);
+    assert(strcmp(emitted_events[0], "a") == 0); // 输出第一次出现的事件
+    assert(emitted_counts[0] == 10);
+    assert(aggregator_timeout(agg, 1000, 5000) == 100);
+
+    // 窗口结束后同样的事件重新开始计数
+    aggregator_add(agg, 1, "a2", 2, 1050);
+    aggregator_flush(agg, 1100);
+    assert(emitted == 2 && strcmp(emitted_events[1], "b") == 0 && emitted_counts[1] == 1);
+    aggregator_flush(agg, 2050);
+    assert(emitted == 3 && strcmp(emitted_events[2], "a2") == 0 && emitted_counts[2] == 1);
+    assert(aggregator_timeout(agg, 2050, 5000) == 5000);
+
+    aggregator_get_stats(agg, &stats);
+    assert(stats.collapsed == 9);
+    assert(stats.emitted == 3);
+    assert(stats.evicted == 0);
+    aggregator_destroy(agg);
+}
+
+static void test_full_and_destroy(void)
+{
+    aggregator_t *agg = aggregator_create(1000, record_emit);
+    aggregate_stats_t stats;
+
+    emitted = 0;
+    for (uint64 k = 1; k <= AGGREGATE_MAX_ENTRIES + 10; k++)
+    {
+        aggregator_add(agg, k, "e", 1, 0);
+    }
+    assert(emitted == 10); // 表满时提前输出最早的事件
+    aggregator_get_stats(agg, &stats);
+    assert(stats.evicted == 10);
+    aggregator_destroy(agg); // 退出时输出剩余的事件
+    assert(emitted == AGGREGATE_MAX_ENTRIES + 10);
+}
+
+int main(void)
+{
+    test_key();
+    test_window();
+    test_full_and_destroy();
+    printf("test_aggregate passed\n");
+    return 0;
+}
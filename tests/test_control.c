@@ -0,0 +1,168 @@
+// tests/test_control.c
+//
+// Checks that one set of handler calls renders as "section.key value" text or
+// as JSON, that unknown commands return the help text and oversized responses
+// are reported, and that the server answers requests over the Unix socket and
+// survives a client that closes before reading the response.
+//
+// Usage:
+// - In AOSP: `mm` in tests/ and run test_control on the device or host.
+// - On host: gcc -I.. test_control.c ../control.c ../json_writer.c ../dlog.c -lpthread -o test_control
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "control.h"
+
+#define SOCKET_PATH "/tmp/test_control.sock"
+
+static void handle_stats(control_output_t *out)
+{
+    uint64 buckets[3] = {1, 0, 7};
+
+    control_add_uint(out, "uptime", 42);
+    control_section_begin(out, "queue");
+    control_add_uint(out, "size", 3);
+    control_add_string(out, "policy", "drop \"oldest\"");
+    control_add_uint_array(out, "buckets", buckets, 3);
+    control_section_end(out);
+}
+
+static void handle_big(control_output_t *out)
+{
+    char key[32];
+
+    for (int i = 0; i < 4096; i++)
+    {
+        snprintf(key, sizeof(key), "key_%d", i);
+        control_add_uint(out, key, (uint64)i);
+    }
+}
+
+// 响应前等待，保证客户端已经关闭连接
+static void handle_slow(control_output_t *out)
+{
+    usleep(100 * 1000);
+    control_add_uint(out, "slow", 1);
+}
+
+static const control_command_t commands[] = {
+    {"stats", "test stats", handle_stats},
+    {"big", "too large to answer", handle_big},
+    {"slow", "answers after the client is gone", handle_slow},
+};
+#define COMMAND_COUNT ((int)(sizeof(commands) / sizeof(commands[0])))
+
+static void test_text(void)
+{
+    char response[CONTROL_MAX_RESPONSE];
+    int len = control_handle_request(commands, COMMAND_COUNT, "stats\n", response, sizeof(response));
+    const char *expected = "uptime 42\n"
+                           "queue.size 3\n"
+                           "queue.policy drop \"oldest\"\n"
+                           "queue.buckets 1 0 7\n";
+
+    assert(strcmp(response, expected) == 0);
+    assert(len == (int)strlen(expected));
+}
+
+static void test_json(void)
+{
+    char response[CONTROL_MAX_RESPONSE];
+    int len = control_handle_request(commands, COMMAND_COUNT, "stats json", response, sizeof(response));
+    const char *expected =
+        "{\"uptime\":42,\"queue\":{\"size\":3,\"policy\":\"drop \\\"oldest\\\"\",\"buckets\":[1,0,7]}}\n";
+
+    assert(strcmp(response, expected) == 0);
+    assert(len == (int)strlen(expected));
+}
+
+static void test_unknown_and_overflow(void)
+{
+    char response[CONTROL_MAX_RESPONSE];
+    int ret;
+
+    ret = control_handle_request(commands, COMMAND_COUNT, "nope", response, sizeof(response));
+    assert(ret == -1);
+    assert(strstr(response, "stats") != NULL && strstr(response, "test stats") != NULL);
+    ret = control_handle_request(commands, COMMAND_COUNT, "", response, sizeof(response));
+    assert(ret == -1);
+
+    ret = control_handle_request(commands, COMMAND_COUNT, "big", response, sizeof(response));
+    assert(ret == -2);
+    assert(strcmp(response, "response too large\n") == 0);
+    ret = control_handle_request(commands, COMMAND_COUNT, "big json", response, sizeof(response));
+    assert(ret == -2);
+    assert(strcmp(response, "response too large\n") == 0);
+}
+
+static int send_request(const char *request)
+{
+    struct sockaddr_un addr;
+    ssize_t written;
+    int ret;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    assert(fd >= 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, SOCKET_PATH, sizeof(addr.sun_path) - 1);
+    ret = connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+    assert(ret == 0);
+    written = write(fd, request, strlen(request));
+    assert(written == (ssize_t)strlen(request));
+    return fd;
+}
+
+static void query(const char *request, char *response, size_t cap)
+{
+    size_t got = 0;
+    int fd = send_request(request);
+
+    for (;;)
+    {
+        ssize_t n = read(fd, response + got, cap - 1 - got);
+        if (n <= 0)
+        {
+            break;
+        }
+        got += (size_t)n;
+    }
+    response[got] = '\0';
+    close(fd);
+}
+
+static void test_socket(void)
+{
+    char response[CONTROL_MAX_RESPONSE];
+    int ret;
+
+    ret = control_start(SOCKET_PATH, commands, COMMAND_COUNT);
+    assert(ret == 0);
+    query("stats\n", response, sizeof(response));
+    assert(strncmp(response, "uptime 42\n", 10) == 0);
+    query("stats json\n", response, sizeof(response));
+    assert(strncmp(response, "{\"uptime\":42,", 13) == 0);
+    query("missing\n", response, sizeof(response));
+    assert(strstr(response, "histograms") == NULL && strstr(response, "big") != NULL);
+
+    // 客户端不读响应就关闭，服务端写入失败后继续服务
+    close(send_request("slow\n"));
+    query("stats\n", response, sizeof(response));
+    assert(strncmp(response, "uptime 42\n", 10) == 0);
+    control_stop();
+    assert(access(SOCKET_PATH, F_OK) != 0);
+}
+
+int main(void)
+{
+    test_text();
+    test_json();
+    test_unknown_and_overflow();
+    test_socket();
+    printf("test_control: OK\n");
+    return 0;
+}
@@ -0,0 +1,80 @@
+// tests/test_dlog.c
+//
+// Checks level parsing and filtering of the diagnostic log macros, and that
+// calls below the compile-time minimum level do not evaluate their arguments.
+//
+// Usage:
+// - In AOSP: `mm` in tests/ and run test_dlog on the device or host.
+// - On host: gcc -I.. test_dlog.c ../dlog.c -o test_dlog
+
+#define DLOG_MIN_LEVEL DLOG_LEVEL_DEBUG
+#include <assert.h>
+#include <stdio.h>
+#include "dlog.h"
+
+static int evaluated = 0;
+
+static int touch(void)
+{
+    return ++evaluated;
+}
+
+static void test_parse(void)
+{
+    int level = -1;
+    int ret;
+
+    ret = dlog_level_parse("verbose", &level);
+    assert(ret == 0 && level == DLOG_LEVEL_VERBOSE);
+    ret = dlog_level_parse("warn", &level);
+    assert(ret == 0 && level == DLOG_LEVEL_WARN);
+    ret = dlog_level_parse("none", &level);
+    assert(ret == 0 && level == DLOG_LEVEL_NONE);
+    ret = dlog_level_parse("3", &level);
+    assert(ret == 0 && level == DLOG_LEVEL_WARN);
+    ret = dlog_level_parse("6", &level);
+    assert(ret != 0);
+    ret = dlog_level_parse("loud", &level);
+    assert(ret != 0);
+    ret = dlog_level_parse("", &level);
+    assert(ret != 0);
+    ret = dlog_level_parse(NULL, &level);
+    assert(ret != 0);
+}
+
+static void test_filter(void)
+{
+    assert(dlog_level == DLOG_DEFAULT_LEVEL);
+
+    // 低于编译期级别，运行期打开也不计算参数
+    dlog_set_level(DLOG_LEVEL_VERBOSE);
+    assert(dlog_level == DLOG_LEVEL_VERBOSE);
+    DLOGV("verbose %d", touch());
+    assert(evaluated == 0);
+    assert(!DLOG_ON(DLOG_LEVEL_VERBOSE));
+
+    DLOGD("debug %d", touch());
+    assert(evaluated == 1);
+
+    // 低于运行期级别
+    dlog_set_level(DLOG_LEVEL_WARN);
+    DLOGI("info %d", touch());
+    assert(evaluated == 1);
+    DLOGE("error %d", touch());
+    assert(evaluated == 2);
+
+    dlog_set_level(DLOG_LEVEL_NONE);
+    DLOGE("error %d", touch());
+    assert(evaluated == 2);
+
+    dlog_set_level(42); // 无效级别不改变当前级别
+    assert(dlog_level == DLOG_LEVEL_NONE);
+}
+
+int main(void)
+{
+    test_parse();
+    test_filter();
+    printf("test_dlog passed\n");
+    return 0;
+}
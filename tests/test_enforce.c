@@ -0,0 +1,183 @@
+// tests/test_enforce.c
+//
+// Checks batching, TTL refresh and expiration of the enforcement path using the
+// in-process backend, so it runs without root, that enforce_init creates the
+// backend's set before anything is added, and that a backend calling
+// enforce_stop from the enforcement thread does not join itself.
+//
+// Usage:
+// - In AOSP: `mm` in tests/ and run test_enforce on the device or host.
+// - On host: gcc -I.. test_enforce.c ../enforce.c ../file_watch.c ../dlog.c -lpthread -o test_enforce
+
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "enforce.h"
+
+static int create_calls = 0;
+static int add_calls = 0;
+static int add_sizes[64];
+static int expire_calls = 0;
+static int stop_from_backend = 0; // counting_add里调用enforce_stop
+
+static int counting_add(void *ctx, const uint32 *ips, int count, uint32 ttl)
+{
+    assert(ttl == 10);
+    add_sizes[add_calls++] = count;
+    if (__atomic_load_n(&stop_from_backend, __ATOMIC_ACQUIRE))
+    {
+        enforce_stop(); // must return instead of joining itself
+    }
+    return enforce_local_backend()->add(ctx, ips, count, ttl);
+}
+
+static int counting_expire(void *ctx, const uint32 *ips, int count)
+{
+    expire_calls++;
+    return enforce_local_backend()->expire(ctx, ips, count);
+}
+
+// 规则文件加载前集合就要存在，必须先于任何add创建
+static int counting_create(void *ctx, uint32 ttl)
+{
+    (void)ctx;
+    assert(ttl == 10);
+    assert(add_calls == 0);
+    create_calls++;
+    return 0;
+}
+
+static int failing_create(void *ctx, uint32 ttl)
+{
+    (void)ctx;
+    (void)ttl;
+    return -1;
+}
+
+static const enforce_backend_t counting_backend = {"counting", counting_add, counting_expire, counting_create, NULL};
+static const enforce_backend_t failing_backend = {"failing", counting_add, counting_expire, failing_create, NULL};
+
+static void test_table(void)
+{
+    enforce_table_t t;
+    int ret = enforce_table_init(&t, 4);
+    assert(ret == 0);
+    for (uint32 ip = 1; ip <= 1000; ip++)
+    {
+        enforce_table_insert(&t, ip * 7919)->expire_ms = ip;
+    }
+    assert(t.count == 1000);
+    for (uint32 ip = 1; ip <= 1000; ip += 2)
+    {
+        enforce_table_remove(&t, enforce_table_find(&t, ip * 7919));
+    }
+    assert(t.count == 500);
+    for (uint32 ip = 1; ip <= 1000; ip++)
+    {
+        enforce_entry_t *entry = enforce_table_find(&t, ip * 7919);
+        assert((ip % 2 == 0) == (entry != NULL));
+        assert(entry == NULL || entry->expire_ms == ip);
+    }
+    enforce_table_free(&t);
+}
+
+static void test_create(void)
+{
+    int ret = enforce_init(&failing_backend, 10);
+    assert(ret == -1);
+    enforce_submit(1); // 初始化失败后不接收IP
+    enforce_process(1000);
+    assert(add_calls == 0);
+
+    ret = enforce_init(&counting_backend, 10);
+    assert(ret == 0);
+    assert(create_calls == 1 && add_calls == 0);
+}
+
+static void test_batch_refresh_expire(void)
+{
+    long long now = 1000000;
+
+    // 300 IPs go out as two batches, duplicates are sent once
+    for (uint32 ip = 0; ip < 300; ip++)
+    {
+        enforce_submit(ip + 1);
+        enforce_submit(ip + 1);
+    }
+    enforce_process(now);
+    assert(add_calls == 2);
+    assert(add_sizes[0] == ENFORCE_MAX_BATCH && add_sizes[1] == 300 - ENFORCE_MAX_BATCH);
+    assert(enforce_local_contains(1) && enforce_local_contains(300));
+
+    // more than half of the TTL left: not sent again
+    enforce_submit(1);
+    enforce_process(now + 4000);
+    assert(add_calls == 2);
+
+    // less than half left: refreshed
+    enforce_submit(2);
+    enforce_process(now + 6000);
+    assert(add_calls == 3 && add_sizes[2] == 1);
+
+    // everything except the refreshed IP expires in one batch
+    enforce_process(now + 10000);
+    assert(expire_calls == 2); // 299 expired IPs in batches of ENFORCE_MAX_BATCH
+    assert(!enforce_local_contains(1) && enforce_local_contains(2));
+    enforce_process(now + 16000);
+    assert(!enforce_local_contains(2));
+
+    enforce_stats_t stats;
+    enforce_get_stats(&stats);
+    assert(stats.submitted == 602 && stats.added == 301 && stats.expired == 300);
+}
+
+static void test_thread_flushes(void)
+{
+    int calls = add_calls;
+    int ret = enforce_start();
+    assert(ret == 0);
+    enforce_submit(12345);
+    for (int i = 0; i < 100 && !enforce_local_contains(12345); i++)
+    {
+        usleep(10 * 1000);
+    }
+    assert(enforce_local_contains(12345));
+    enforce_submit(23456);
+    enforce_stop();
+    assert(enforce_local_contains(23456));
+    assert(add_calls > calls);
+}
+
+static void test_stop_from_backend(void)
+{
+    int ret = enforce_start();
+    assert(ret == 0);
+    __atomic_store_n(&stop_from_backend, 1, __ATOMIC_RELEASE);
+    enforce_submit(34567);
+    for (int i = 0; i < 100 && !enforce_local_contains(34567); i++)
+    {
+        usleep(10 * 1000);
+    }
+    assert(enforce_local_contains(34567));
+    __atomic_store_n(&stop_from_backend, 0, __ATOMIC_RELEASE);
+    // the thread is still running and keeps flushing
+    enforce_submit(45678);
+    for (int i = 0; i < 100 && !enforce_local_contains(45678); i++)
+    {
+        usleep(10 * 1000);
+    }
+    assert(enforce_local_contains(45678));
+    enforce_stop();
+}
+
+int main(void)
+{
+    printf("Running test_enforce\n");
+    test_table();
+    test_create();
+    test_batch_refresh_expire();
+    test_thread_flushes();
+    test_stop_from_backend();
+    printf("All tests passed.\n");
+    return 0;
+}
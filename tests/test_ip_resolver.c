@@ -0,0 +1,95 @@
+// tests/test_ip_resolver.c
+//
+// Checks the single-pass IPv4 extractor used on the DNS report path.
+//
+// Usage:
+// - In AOSP: `mm` in tests/ and run test_ip_resolver on the device or host.
+// - On host: gcc -I.. test_ip_resolver.c ../ip_resolver.c -o test_ip_resolver
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include "ip_resolver.h"
+
+#define IP(a, b, c, d) (((uint32)(a) << 24) | ((uint32)(b) << 16) | ((uint32)(c) << 8) | (uint32)(d))
+
+static void test_basic(void)
+{
+    uint32 ips[MAX_IP_ADDRESSES];
+    int n = found_ip_addresses("DnsRet:success,domain:a.com,UID:10001,PID:42;114.114.114.114,8.8.8.8,1.1.1.1;",
+                               ips, MAX_IP_ADDRESSES);
+    assert(n == 3);
+    assert(ips[0] == IP(114, 114, 114, 114));
+    assert(ips[1] == IP(8, 8, 8, 8));
+    assert(ips[2] == IP(1, 1, 1, 1));
+}
+
+static void test_header_is_ignored(void)
+{
+    uint32 ips[MAX_IP_ADDRESSES];
+    // dotted quads in the domain must not be picked up
+    int n = found_ip_addresses("DnsRet:success,domain:1.2.3.4.nip.io,UID:1,PID:1;5.6.7.8;", ips, MAX_IP_ADDRESSES);
+    assert(n == 1);
+    assert(ips[0] == IP(5, 6, 7, 8));
+
+    n = found_ip_addresses("DnsRet:success,domain:1.2.3.4,UID:1,PID:1", ips, MAX_IP_ADDRESSES);
+    assert(n == 0);
+    n = found_ip_addresses("DnsRet:fail,domain:a.com,UID:1,PID:1;;", ips, MAX_IP_ADDRESSES);
+    assert(n == 0);
+}
+
+static void test_invalid_entries_are_skipped(void)
+{
+    uint32 ips[MAX_IP_ADDRESSES];
+    int n = found_ip_addresses("h;256.1.1.1,1.2.3,1.2.3.4.5,1..2.3,2001:db8::1,a.b.c.d,0.0.0.0,255.255.255.255,1.2.3.4000,010.1.1.1;",
+                               ips, MAX_IP_ADDRESSES);
+    assert(n == 3);
+    assert(ips[0] == IP(0, 0, 0, 0));
+    assert(ips[1] == IP(255, 255, 255, 255));
+    assert(ips[2] == IP(10, 1, 1, 1));
+
+    // trailing section without the final ';' and stray whitespace
+    n = found_ip_addresses("h;9.9.9.9, 1.0.0.1\n", ips, MAX_IP_ADDRESSES);
+    assert(n == 2);
+    assert(ips[1] == IP(1, 0, 0, 1));
+}
+
+static void test_bounded_output(void)
+{
+    char msg[1024] = "h;";
+    uint32 ips[4];
+    int n;
+    for (int i = 0; i < 40; i++)
+    {
+        char ip[IPV4_STRING_SIZE + 1];
+        snprintf(ip, sizeof(ip), "10.0.0.%d,", i);
+        strcat(msg, ip);
+    }
+    n = found_ip_addresses(msg, ips, 4);
+    assert(n == 4);
+    assert(ips[3] == IP(10, 0, 0, 3));
+}
+
+static void test_format(void)
+{
+    char buf[IPV4_STRING_SIZE];
+    int n;
+    n = format_ipv4(IP(114, 114, 114, 114), buf);
+    assert(n == 15 && strcmp(buf, "114.114.114.114") == 0);
+    n = format_ipv4(IP(0, 0, 0, 0), buf);
+    assert(n == 7 && strcmp(buf, "0.0.0.0") == 0);
+    n = format_ipv4(IP(10, 200, 3, 99), buf);
+    assert(n == 11 && strcmp(buf, "10.200.3.99") == 0);
+}
+
+int main(void)
+{
+    printf("Running test_ip_resolver\n");
+    test_basic();
+    test_header_is_ignored();
+    test_invalid_entries_are_skipped();
+    test_bounded_output();
+    test_format();
+    printf("All tests passed.\n");
+    return 0;
+}
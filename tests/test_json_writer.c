@@ -0,0 +1,141 @@
+// tests/test_json_writer.c
+//
+// Checks the streaming JSON writer: escaping, nesting, buffer overflow, and
+// that a DNS event encodes byte-for-byte like cJSON_PrintUnformatted.
+//
+// Usage:
+// - In AOSP: `mm` in tests/ and run test_json_writer on the device or host.
+// - On host: gcc -I.. test_json_writer.c ../json_writer.c ../cJSON.c -lm -o test_json_writer
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cJSON.h"
+#include "json_writer.h"
+
+static void test_escape(void)
+{
+    char buf[128];
+    json_writer_t w;
+    int len;
+
+    json_writer_init(&w, buf, sizeof(buf));
+    json_begin_object(&w, NULL);
+    json_add_string(&w, "s", "a\"b\\c\n\t\x01\x1f/\xe4\xb8\xad");
+    json_add_string(&w, "n", NULL);
+    json_add_int(&w, "neg", -42);
+    json_add_int(&w, "zero", 0);
+    json_end_object(&w);
+    len = json_writer_finish(&w);
+    assert(len == (int)strlen(buf));
+    assert(strcmp(buf, "{\"s\":\"a\\\"b\\\\c\\n\\t\\u0001\\u001f/\xe4\xb8\xad\",\"n\":null,\"neg\":-42,\"zero\":0}") == 0);
+
+    // 输出必须能被解析回原值
+    cJSON *root = cJSON_Parse(buf);
+    assert(root != NULL);
+    assert(strcmp(cJSON_GetObjectItem(root, "s")->valuestring, "a\"b\\c\n\t\x01\x1f/\xe4\xb8\xad") == 0);
+    assert(cJSON_GetObjectItem(root, "neg")->valueint == -42);
+    cJSON_Delete(root);
+}
+
+static void test_nesting(void)
+{
+    char buf[128];
+    json_writer_t w;
+    int len;
+
+    json_writer_init(&w, buf, sizeof(buf));
+    json_begin_array(&w, NULL);
+    json_begin_object(&w, NULL);
+    json_end_object(&w);
+    json_begin_array(&w, NULL);
+    json_add_int(&w, NULL, 1);
+    json_add_int(&w, NULL, 2);
+    json_end_array(&w);
+    json_add_string(&w, NULL, "x");
+    json_end_array(&w);
+    len = json_writer_finish(&w);
+    assert(len > 0);
+    assert(strcmp(buf, "[{},[1,2],\"x\"]") == 0);
+}
+
+static void test_overflow(void)
+{
+    char buf[16];
+    json_writer_t w;
+    int len;
+
+    // 刚好放下，包含结束符
+    json_writer_init(&w, buf, 12);
+    json_begin_object(&w, NULL);
+    json_add_string(&w, "ab", "cd");
+    json_end_object(&w);
+    len = json_writer_finish(&w);
+    assert(len == 11);
+    assert(strcmp(buf, "{\"ab\":\"cd\"}") == 0);
+
+    json_writer_init(&w, buf, 11);
+    json_begin_object(&w, NULL);
+    json_add_string(&w, "ab", "cd");
+    json_end_object(&w);
+    len = json_writer_finish(&w);
+    assert(len == -1);
+    assert(buf[0] == '\0');
+}
+
+static void test_matches_cjson(void)
+{
+    const char *ips[] = {"1.2.3.4", "8.8.8.8", "114.114.114.114"};
+    char buf[512];
+    json_writer_t w;
+    int len;
+    cJSON *event = cJSON_CreateObject();
+    cJSON *ip_array = cJSON_CreateArray();
+    char *expected;
+
+    cJSON_AddStringToObject(event, "DnsRet", "success");
+    cJSON_AddStringToObject(event, "Domain", "www.example.com");
+    cJSON_AddNumberToObject(event, "UID", 10086);
+    cJSON_AddNumberToObject(event, "PID", 2345);
+    cJSON_AddStringToObject(event, "ProcessName", "com.example.app:remote");
+    cJSON_AddStringToObject(event, "PackageName", "com.example.app");
+    for (int i = 0; i < 3; i++)
+    {
+        cJSON_AddItemToArray(ip_array, cJSON_CreateString(ips[i]));
+    }
+    cJSON_AddItemToObject(event, "IPAddresses", ip_array);
+    expected = cJSON_PrintUnformatted(event);
+
+    json_writer_init(&w, buf, sizeof(buf));
+    json_begin_object(&w, NULL);
+    json_add_string(&w, "DnsRet", "success");
+    json_add_string(&w, "Domain", "www.example.com");
+    json_add_int(&w, "UID", 10086);
+    json_add_int(&w, "PID", 2345);
+    json_add_string(&w, "ProcessName", "com.example.app:remote");
+    json_add_string(&w, "PackageName", "com.example.app");
+    json_begin_array(&w, "IPAddresses");
+    for (int i = 0; i < 3; i++)
+    {
+        json_add_string(&w, NULL, ips[i]);
+    }
+    json_end_array(&w);
+    json_end_object(&w);
+    len = json_writer_finish(&w);
+    assert(len == (int)strlen(expected));
+    assert(strcmp(buf, expected) == 0);
+
+    free(expected);
+    cJSON_Delete(event);
+}
+
+int main(void)
+{
+    test_escape();
+    test_nesting();
+    test_overflow();
+    test_matches_cjson();
+    printf("test_json_writer passed\n");
+    return 0;
+}
@@ -0,0 +1,205 @@
+// tests/test_log_writer.c
+//
+// Checks the overflow policies, the drain on stop, the refusal to stop from
+// the writer thread itself and the fixed slot size of the asynchronous Selog
+// writer, against an in-test Selog_Write that can be held to simulate slow storage.
+//
+// Usage:
+// - In AOSP: `mm` in tests/ and run test_log_writer on the device or host.
+// - On host: gcc -I.. test_log_writer.c ../log_writer.c ../dlog.c ../metrics.c -lpthread -o test_log_writer
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "log_writer.h"
+
+static pthread_mutex_t sink_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sink_cond = PTHREAD_COND_INITIALIZER;
+static int sink_held = 0;
+static int sink_count = 0;
+static int sink_values[4096];
+static int sink_stop_writer = 0; // Selog_Write里调用log_writer_stop
+
+SELOG_S32 Selog_Write(selog_handle lhs, Selog_WriteStructType logInfo, SELOG_S8 *logs, SELOG_U32 logLen)
+{
+    (void)lhs;
+    (void)logLen;
+    assert(logInfo.eventid == 7);
+    pthread_mutex_lock(&sink_mutex);
+    while (sink_held)
+    {
+        pthread_cond_wait(&sink_cond, &sink_mutex);
+    }
+    sink_values[sink_count++] = atoi(logs);
+    int stop_writer = sink_stop_writer;
+    pthread_cond_broadcast(&sink_cond);
+    pthread_mutex_unlock(&sink_mutex);
+    if (stop_writer)
+    {
+        log_writer_stop(); // must return instead of joining itself
+    }
+    return 0;
+}
+
+static void hold_sink(int held)
+{
+    pthread_mutex_lock(&sink_mutex);
+    sink_held = held;
+    pthread_cond_broadcast(&sink_cond);
+    pthread_mutex_unlock(&sink_mutex);
+}
+
+static int submit(int value)
+{
+    Selog_WriteStructType info;
+    char buf[16];
+    memset(&info, 0, sizeof(info));
+    info.eventid = 7;
+    int len = snprintf(buf, sizeof(buf), "%d", value);
+    return log_submit(&info, buf, len);
+}
+
+static void reset_sink(void)
+{
+    pthread_mutex_lock(&sink_mutex);
+    sink_count = 0;
+    pthread_mutex_unlock(&sink_mutex);
+}
+
+static void test_drop_policy(log_overflow_policy_t policy)
+{
+    int ret;
+    reset_sink();
+    hold_sink(1);
+    ret = log_writer_start(NULL, 8, policy);
+    assert(ret == 0);
+    // the writer may already hold the first record, so submit well past capacity
+    for (int i = 0; i < 100; i++)
+    {
+        submit(i);
+    }
+    hold_sink(0);
+    log_writer_stop();
+
+    log_writer_stats_t stats;
+    log_writer_get_stats(&stats);
+    assert(sink_count >= 8 && sink_count <= 8 + LOG_WRITER_MAX_BATCH);
+    for (int i = 1; i < sink_count; i++)
+    {
+        assert(sink_values[i] > sink_values[i - 1]);
+    }
+    if (policy == LOG_OVERFLOW_DROP_OLDEST)
+    {
+        assert(sink_values[sink_count - 1] == 99);
+    }
+    else
+    {
+        assert(sink_values[0] == 0 && sink_values[sink_count - 1] < 99);
+    }
+}
+
+static void *blocked_producer(void *arg)
+{
+    (void)arg;
+    for (int i = 0; i < 1000; i++)
+    {
+        int ret = submit(i);
+        assert(ret == 0);
+    }
+    return NULL;
+}
+
+static void test_block_policy(void)
+{
+    pthread_t thread;
+    int ret;
+    reset_sink();
+    hold_sink(1);
+    ret = log_writer_start(NULL, 4, LOG_OVERFLOW_BLOCK);
+    assert(ret == 0);
+    pthread_create(&thread, NULL, blocked_producer, NULL);
+    usleep(50 * 1000);
+    hold_sink(0);
+    pthread_join(thread, NULL);
+    log_writer_stop();
+    assert(sink_count == 1000);
+    for (int i = 0; i < 1000; i++)
+    {
+        assert(sink_values[i] == i);
+    }
+    ret = submit(1);
+    assert(ret != 0); // stopped
+}
+
+static void test_stop_from_writer(void)
+{
+    int ret;
+    reset_sink();
+    pthread_mutex_lock(&sink_mutex);
+    sink_stop_writer = 1;
+    pthread_mutex_unlock(&sink_mutex);
+    ret = log_writer_start(NULL, 4, LOG_OVERFLOW_BLOCK);
+    assert(ret == 0);
+    ret = submit(1);
+    assert(ret == 0);
+    pthread_mutex_lock(&sink_mutex);
+    while (sink_count < 1)
+    {
+        pthread_cond_wait(&sink_cond, &sink_mutex);
+    }
+    sink_stop_writer = 0;
+    pthread_mutex_unlock(&sink_mutex);
+    // the writer is still running and keeps writing
+    ret = submit(2);
+    assert(ret == 0);
+    log_writer_stop();
+    assert(sink_count == 2);
+}
+
+static void test_slot_size(void)
+{
+    static char big[LOG_WRITER_SLOT_SIZE + 2];
+    Selog_WriteStructType info;
+    int ret;
+
+    memset(&info, 0, sizeof(info));
+    info.eventid = 7;
+    memset(big, '0', sizeof(big) - 1);
+    big[LOG_WRITER_SLOT_SIZE - 1] = '9';
+    reset_sink();
+    ret = log_writer_start(NULL, 4, LOG_OVERFLOW_BLOCK);
+    assert(ret == 0);
+    ret = log_submit(&info, big, LOG_WRITER_SLOT_SIZE + 1); // longer than a slot
+    assert(ret != 0);
+    ret = log_submit(&info, big, LOG_WRITER_SLOT_SIZE); // fills a slot, written as "000...9"
+    assert(ret == 0);
+    log_writer_stop();
+    assert(sink_count == 1 && sink_values[0] == 9);
+}
+
+int main(void)
+{
+    log_overflow_policy_t policy;
+    int ret;
+    printf("Running test_log_writer\n");
+    ret = log_overflow_policy_parse("drop-newest", &policy);
+    assert(ret == 0 && policy == LOG_OVERFLOW_DROP_NEWEST);
+    ret = log_overflow_policy_parse("fifo", &policy);
+    assert(ret != 0);
+    test_drop_policy(LOG_OVERFLOW_DROP_OLDEST);
+    test_drop_policy(LOG_OVERFLOW_DROP_NEWEST);
+    test_block_policy();
+    test_stop_from_writer();
+    test_slot_size();
+
+    log_writer_stats_t stats;
+    log_writer_get_stats(&stats);
+    assert(stats.dropped_oldest > 0 && stats.dropped_newest > 0 && stats.blocked > 0);
+    assert(stats.written == stats.submitted - stats.dropped_oldest);
+    assert(stats.write_failures == 1); // the oversized record
+    printf("All tests passed.\n");
+    return 0;
+}
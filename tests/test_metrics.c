@@ -0,0 +1,106 @@
+// tests/test_metrics.c
+//
+// Checks histogram bucketing and percentiles, and that counters updated from
+// more threads than there are private slots add up exactly in a snapshot.
+//
+// Usage:
+// - In AOSP: `mm` in tests/ and run test_metrics on the device or host.
+// - On host: gcc -I.. test_metrics.c ../metrics.c -lpthread -o test_metrics
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include "metrics.h"
+
+#define THREADS (METRICS_MAX_THREADS + 8) // 超出的线程共用一个槽位
+#define PER_THREAD 20000
+
+static void test_histogram(void)
+{
+    metrics_snapshot_t snap;
+    const metrics_histogram_t *h;
+
+    metrics_record(METRICS_STAGE_PARSE, 0);
+    metrics_record(METRICS_STAGE_PARSE, 1);
+    metrics_record(METRICS_STAGE_PARSE, 1000);       // [512, 1024)
+    metrics_record(METRICS_STAGE_PARSE, 1500);       // [1024, 2048)
+    metrics_record(METRICS_STAGE_PARSE, 1ULL << 40); // 最后一个桶
+    metrics_snapshot(&snap);
+    h = &snap.stages[METRICS_STAGE_PARSE];
+    assert(h->count == 5);
+    assert(h->sum_ns == 2501 + (1ULL << 40));
+    assert(h->max_ns == 1ULL << 40);
+    assert(h->buckets[0] == 1 && h->buckets[1] == 1);
+    assert(h->buckets[10] == 1 && h->buckets[11] == 1);
+    assert(h->buckets[METRICS_HISTOGRAM_BUCKETS - 1] == 1);
+
+    assert(metrics_percentile(h, 0) == 0);
+    assert(metrics_percentile(h, 50) == 1023);
+    assert(metrics_percentile(h, 70) == 2047);
+    assert(metrics_percentile(h, 100) == 1ULL << 40);
+
+    memset(&snap, 0, sizeof(snap));
+    assert(metrics_percentile(&snap.stages[0], 99) == 0);
+    assert(strcmp(metrics_stage_name(METRICS_STAGE_XDB_LOOKUP), "xdb_lookup") == 0);
+    assert(strcmp(metrics_counter_name(METRICS_EVENTS_DROPPED), "events_dropped") == 0);
+}
+
+static void *count_thread(void *arg)
+{
+    (void)arg;
+    for (int i = 0; i < PER_THREAD; i++)
+    {
+        metrics_count(METRICS_PACKETS_RECEIVED, 1);
+        metrics_record(METRICS_STAGE_RECEIVE, (uint64)i);
+    }
+    return NULL;
+}
+
+static void *snapshot_thread(void *arg)
+{
+    int *stop = (int *)arg;
+    uint64 last = 0;
+    while (!__atomic_load_n(stop, __ATOMIC_RELAXED))
+    {
+        metrics_snapshot_t snap;
+        metrics_snapshot(&snap);
+        // 每个槽位单调增加，合计也不会变小
+        assert(snap.counters[METRICS_PACKETS_RECEIVED] >= last);
+        last = snap.counters[METRICS_PACKETS_RECEIVED];
+    }
+    return NULL;
+}
+
+static void test_threads(void)
+{
+    pthread_t threads[THREADS];
+    pthread_t reader;
+    int stop = 0;
+    metrics_snapshot_t snap;
+
+    pthread_create(&reader, NULL, snapshot_thread, &stop);
+    for (int i = 0; i < THREADS; i++)
+    {
+        pthread_create(&threads[i], NULL, count_thread, NULL);
+    }
+    for (int i = 0; i < THREADS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    pthread_join(reader, NULL);
+
+    metrics_snapshot(&snap);
+    assert(snap.counters[METRICS_PACKETS_RECEIVED] == (uint64)THREADS * PER_THREAD);
+    assert(snap.stages[METRICS_STAGE_RECEIVE].count == (uint64)THREADS * PER_THREAD);
+    assert(snap.stages[METRICS_STAGE_RECEIVE].max_ns == PER_THREAD - 1);
+}
+
+int main(void)
+{
+    test_histogram();
+    test_threads();
+    printf("test_metrics passed\n");
+    return 0;
+}
@@ -0,0 +1,169 @@
+// tests/test_package_table.c
+//
+// Parses sample packages.list files: shared UIDs, multi-user UIDs, malformed
+// lines and lines longer than the read buffer, then checks that the table is
+// rebuilt and swapped when the file is replaced or rewritten in place, and
+// that names from the previous table stay readable until the next reload.
+//
+// Usage:
+// - In AOSP: `mm` in tests/ and run test_package_table on the device or host.
+// - On host: gcc -I.. -DPACKAGE_TABLE_CHECK_INTERVAL=0 test_package_table.c ../package_table.c ../file_watch.c ../dlog.c -o test_package_table
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include "package_table.h"
+
+#ifdef __ANDROID__
+#define LIST_PATH "/data/local/tmp/test_package_table.list"
+#else
+#define LIST_PATH "/tmp/test_package_table.list"
+#endif
+
+#define LONG_LINE_GIDS 400 // gids足够多，一行超过1024字节
+
+static void write_list(const char *path, const char *content)
+{
+    FILE *file = fopen(path, "w");
+    assert(file != NULL);
+    fputs(content, file);
+    fclose(file);
+}
+
+// 先写临时文件再rename，inode会变化
+static void replace_list(const char *content)
+{
+    write_list(LIST_PATH ".tmp", content);
+    int ret = rename(LIST_PATH ".tmp", LIST_PATH);
+    assert(ret == 0);
+}
+
+static int same_name(const char *name, const char *expected)
+{
+    return name != NULL && strcmp(name, expected) == 0;
+}
+
+static void test_parse(void)
+{
+    static char content[16384];
+    size_t len = 0;
+    const char *name;
+
+    len += (size_t)snprintf(content + len, sizeof(content) - len,
+                            "com.android.settings 1000 0 /data/user_de/0/com.android.settings platform:privapp 3002,3003\n"
+                            "com.android.shell 2000 0 /data/user_de/0/com.android.shell platform:privapp 3003\n"
+                            "android 1000 0 /data/system platform:privapp none\n" // sharedUserId，保留第一个
+                            "\n"
+                            "com.example.nouid\n"
+                            "com.example.baduid 10abc 0 /data/user/0/com.example.baduid default none\n"
+                            "   \t\n");
+    // 超长行：包名和uid在第一段，第1024字节之后伪装成另一行
+    size_t start = len;
+    len += (size_t)snprintf(content + len, sizeof(content) - len,
+                            "com.example.longgids 10100 0 /data/user/0/com.example.longgids default ");
+    while (len - start < 1023)
+    {
+        content[len++] = 'x';
+    }
+    len += (size_t)snprintf(content + len, sizeof(content) - len, " com.example.tail 10999 0 /data default");
+    for (int i = 0; i < LONG_LINE_GIDS; i++)
+    {
+        len += (size_t)snprintf(content + len, sizeof(content) - len, "%s%d", i ? "," : " ", 3000 + i);
+    }
+    // uid恰好在第一段末尾被截断的行整行丢弃
+    content[len++] = '\n';
+    start = len;
+    while (len - start < 1023 - 6)
+    {
+        content[len++] = 'p';
+    }
+    len += (size_t)snprintf(content + len, sizeof(content) - len, " 10123456 0 /data default none\n");
+    len += (size_t)snprintf(content + len, sizeof(content) - len,
+                            "com.example.app 10123 0 /data/user/0/com.example.app default:targetSdkVersion=34 3003\n"
+                            "com.example.last 10200 0 /data/user/0/com.example.last default none"); // 没有换行
+    assert(len < sizeof(content));
+    write_list(LIST_PATH, content);
+
+    package_table_t *table = package_table_build(LIST_PATH);
+    assert(table != NULL);
+    assert(table->count == 5);
+    package_table_free(table);
+
+    int ret = package_table_init(LIST_PATH);
+    assert(ret == 0);
+    name = package_table_lookup(1000);
+    assert(same_name(name, "com.android.settings"));
+    name = package_table_lookup(2000);
+    assert(same_name(name, "com.android.shell"));
+    name = package_table_lookup(10100);
+    assert(same_name(name, "com.example.longgids"));
+    name = package_table_lookup(10999);
+    assert(name == NULL);
+    name = package_table_lookup(10123);
+    assert(same_name(name, "com.example.app"));
+    name = package_table_lookup(1010123); // 用户10下的同一应用
+    assert(same_name(name, "com.example.app"));
+    name = package_table_lookup(10200);
+    assert(same_name(name, "com.example.last"));
+    name = package_table_lookup(12345);
+    assert(name == NULL);
+    package_table_deinit();
+}
+
+static void test_reload(void)
+{
+    package_table_stats_t stats;
+    const char *old_name;
+    const char *name;
+    int ret;
+
+    replace_list("com.example.a 10001 0 /data default none\n");
+    ret = package_table_init(LIST_PATH);
+    assert(ret == 0);
+    package_table_get_stats(&stats);
+    assert(stats.packages == 1 && stats.reloads == 0);
+    old_name = package_table_lookup(10001);
+    assert(same_name(old_name, "com.example.a"));
+
+    // 文件没有变化时不重新加载
+    package_table_check_reload();
+    package_table_get_stats(&stats);
+    assert(stats.reloads == 0);
+
+    // 替换文件(inode变化)
+    replace_list("com.example.b 10001 0 /data default none\n"
+                 "com.example.c 10002 0 /data default none\n");
+    package_table_check_reload();
+    package_table_get_stats(&stats);
+    assert(stats.packages == 2 && stats.reloads == 1);
+    name = package_table_lookup(10001);
+    assert(same_name(name, "com.example.b"));
+    assert(strcmp(old_name, "com.example.a") == 0); // 旧表延后释放，之前查到的包名仍可读
+
+    // 原地改写(大小和mtime变化)
+    write_list(LIST_PATH, "com.example.d 10003 0 /data default none\n");
+    package_table_check_reload();
+    package_table_get_stats(&stats);
+    assert(stats.packages == 1 && stats.reloads == 2);
+    name = package_table_lookup(10001);
+    assert(name == NULL);
+    name = package_table_lookup(10003);
+    assert(same_name(name, "com.example.d"));
+
+    // 文件暂时不存在时保留当前的表
+    ret = remove(LIST_PATH);
+    assert(ret == 0);
+    package_table_check_reload();
+    package_table_get_stats(&stats);
+    assert(stats.packages == 1 && stats.reloads == 2);
+    package_table_deinit();
+}
+
+int main(void)
+{
+    printf("Running test_package_table\n");
+    test_parse();
+    test_reload();
+    printf("All tests passed.\n");
+    return 0;
+}
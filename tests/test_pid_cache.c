@@ -0,0 +1,222 @@
+// tests/test_pid_cache.c
+//
+// Runs the PID cache against a fake proc directory: hits that only check the
+// cached /proc/<pid> directory, PID reuse detected right after a hit, the
+// start-time fallback when no directory is held, exited and unknown
+// processes, eviction from a full set and the idle sweep.
+//
+// Usage:
+// - In AOSP: `mm` in tests/ and run test_pid_cache on the device or host.
+// - On host: gcc -I.. -DPID_CACHE_PROC_ROOT='"test_pid_cache_proc"' test_pid_cache.c ../pid_cache.c ../file_watch.c ../dlog.c -o test_pid_cache
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "pid_cache.h"
+
+#ifndef PID_CACHE_PROC_ROOT
+#error "build with -DPID_CACHE_PROC_ROOT pointing at a scratch directory"
+#endif
+
+#ifdef __ANDROID__
+#define WORK_DIR "/data/local/tmp"
+#else
+#define WORK_DIR "/tmp"
+#endif
+
+// 写出伪造的/proc/<pid>/stat和cmdline，进程名中带空格和括号
+static void fake_process(int pid, unsigned long long start_time, const char *name)
+{
+    char path[128];
+    FILE *file;
+
+    snprintf(path, sizeof(path), PID_CACHE_PROC_ROOT "/%d", pid);
+    mkdir(path, 0755);
+
+    snprintf(path, sizeof(path), PID_CACHE_PROC_ROOT "/%d/stat", pid);
+    file = fopen(path, "w");
+    assert(file != NULL);
+    fprintf(file, "%d (a) b (c) S", pid);
+    for (int field = 4; field < 22; field++)
+    {
+        fprintf(file, " %d", field);
+    }
+    fprintf(file, " %llu 0 0\n", start_time);
+    fclose(file);
+
+    snprintf(path, sizeof(path), PID_CACHE_PROC_ROOT "/%d/cmdline", pid);
+    file = fopen(path, "w");
+    assert(file != NULL);
+    fprintf(file, "%s%c--flag%c", name, '\0', '\0');
+    fclose(file);
+}
+
+static void exit_process(int pid)
+{
+    char path[128];
+    snprintf(path, sizeof(path), PID_CACHE_PROC_ROOT "/%d/stat", pid);
+    unlink(path);
+    snprintf(path, sizeof(path), PID_CACHE_PROC_ROOT "/%d/cmdline", pid);
+    unlink(path);
+    snprintf(path, sizeof(path), PID_CACHE_PROC_ROOT "/%d", pid);
+    rmdir(path);
+}
+
+static void test_hit_and_reuse(void)
+{
+    pid_cache_t *cache = pid_cache_create();
+    pid_cache_stats_t stats;
+    const char *name;
+    char path[128];
+    FILE *file;
+
+    assert(cache != NULL);
+    fake_process(100, 5, "com.example.a");
+    name = pid_cache_lookup(cache, 100);
+    assert(name != NULL && strcmp(name, "com.example.a") == 0);
+
+    // 同一个进程，命中后不再读cmdline
+    fake_process(100, 5, "changed");
+    name = pid_cache_lookup(cache, 100);
+    assert(name != NULL && strcmp(name, "com.example.a") == 0);
+    pid_cache_get_stats(cache, &stats);
+    assert(stats.hits == 1 && stats.misses == 1 && stats.reused == 0);
+
+    // 命中时也不读stat，只检查它是否存在
+    snprintf(path, sizeof(path), PID_CACHE_PROC_ROOT "/100/stat");
+    file = fopen(path, "w");
+    assert(file != NULL);
+    fputs("garbage", file);
+    fclose(file);
+    name = pid_cache_lookup(cache, 100);
+    assert(name != NULL && strcmp(name, "com.example.a") == 0);
+
+    // 刚命中过也能发现PID被复用：新进程是新的/proc/<pid>目录
+    exit_process(100);
+    fake_process(100, 6, "com.example.b");
+    name = pid_cache_lookup(cache, 100);
+    assert(name != NULL && strcmp(name, "com.example.b") == 0);
+    pid_cache_get_stats(cache, &stats);
+    assert(stats.hits == 2 && stats.misses == 2 && stats.reused == 1);
+
+    // 进程退出后不再返回旧进程名
+    exit_process(100);
+    name = pid_cache_lookup(cache, 100);
+    assert(name == NULL);
+    name = pid_cache_lookup(cache, 101);
+    assert(name == NULL);
+    name = pid_cache_lookup(cache, 0);
+    assert(name == NULL);
+    pid_cache_get_stats(cache, &stats);
+    assert(stats.misses == 4 && stats.evictions == 1);
+    pid_cache_destroy(cache);
+}
+
+// 目录打不开(例如fd不足)时按启动时间校验
+static void test_start_time_fallback(void)
+{
+    pid_cache_t *cache = pid_cache_create();
+    pid_cache_entry_t *entry = &cache->entries[300 & (PID_CACHE_SETS - 1)][0];
+    pid_cache_stats_t stats;
+    const char *name;
+
+    assert(cache != NULL);
+    fake_process(300, 5, "com.example.a");
+    name = pid_cache_lookup(cache, 300);
+    assert(name != NULL && entry->pid == 300 && entry->dir_fd >= 0);
+    close(entry->dir_fd);
+    entry->dir_fd = -1;
+
+    fake_process(300, 5, "changed");
+    name = pid_cache_lookup(cache, 300);
+    assert(name != NULL && strcmp(name, "com.example.a") == 0);
+
+    // 原地改写的目录中启动时间变了
+    fake_process(300, 6, "com.example.b");
+    name = pid_cache_lookup(cache, 300);
+    assert(name != NULL && strcmp(name, "com.example.b") == 0);
+    pid_cache_get_stats(cache, &stats);
+    assert(stats.hits == 1 && stats.misses == 2 && stats.reused == 1);
+    exit_process(300);
+    pid_cache_destroy(cache);
+}
+
+static void test_eviction(void)
+{
+    pid_cache_t *cache = pid_cache_create();
+    pid_cache_stats_t stats;
+    char expected[32];
+    const char *name;
+
+    assert(cache != NULL);
+    // 同一组中放入PID_CACHE_WAYS + 1个进程
+    for (int i = 0; i <= PID_CACHE_WAYS; i++)
+    {
+        int pid = 7 + i * PID_CACHE_SETS;
+        snprintf(expected, sizeof(expected), "proc%d", pid);
+        fake_process(pid, 1, expected);
+        name = pid_cache_lookup(cache, pid);
+        assert(name != NULL && strcmp(name, expected) == 0);
+    }
+    pid_cache_get_stats(cache, &stats);
+    assert(stats.misses == PID_CACHE_WAYS + 1 && stats.evictions == 1);
+
+    // 每个PID都还能查到正确的进程名
+    for (int i = 0; i <= PID_CACHE_WAYS; i++)
+    {
+        int pid = 7 + i * PID_CACHE_SETS;
+        snprintf(expected, sizeof(expected), "proc%d", pid);
+        name = pid_cache_lookup(cache, pid);
+        assert(name != NULL && strcmp(name, expected) == 0);
+        exit_process(pid);
+    }
+    pid_cache_destroy(cache);
+}
+
+static void test_sweep(void)
+{
+    pid_cache_t *cache = pid_cache_create();
+    pid_cache_stats_t stats;
+    const char *name;
+
+    assert(cache != NULL);
+    fake_process(200, 1, "gone");
+    fake_process(201, 1, "alive");
+    name = pid_cache_lookup(cache, 200);
+    assert(name != NULL);
+    name = pid_cache_lookup(cache, 201);
+    assert(name != NULL);
+    exit_process(200);
+
+    // 刚查询过的项不检查
+    pid_cache_sweep(cache);
+    pid_cache_get_stats(cache, &stats);
+    assert(stats.evictions == 0);
+
+    usleep((PID_CACHE_VALIDATE_INTERVAL + 100) * 1000);
+    pid_cache_sweep(cache);
+    pid_cache_get_stats(cache, &stats);
+    assert(stats.evictions == 1);
+    assert(cache->entries[200 & (PID_CACHE_SETS - 1)][0].pid == 0);
+    assert(cache->entries[201 & (PID_CACHE_SETS - 1)][0].pid == 201);
+    exit_process(201);
+    pid_cache_destroy(cache);
+}
+
+int main(void)
+{
+    int ret;
+    printf("Running test_pid_cache\n");
+    ret = chdir(WORK_DIR);
+    assert(ret == 0);
+    mkdir(PID_CACHE_PROC_ROOT, 0755);
+    test_hit_and_reuse();
+    test_start_time_fallback();
+    test_eviction();
+    test_sweep();
+    rmdir(PID_CACHE_PROC_ROOT);
+    printf("All tests passed.\n");
+    return 0;
+}
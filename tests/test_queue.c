@@ -0,0 +1,333 @@
+// tests/test_queue.c
+//
+// Exercises the MPSC ring behind BufferInQueue/BufferOutQueue: ordering,
+// full/drop accounting, batch enqueue, blocking dequeue, blocking enqueue
+// on a full ring, draining a closed queue and concurrent producers.
+//
+// Usage:
+// - In AOSP: `mm` in tests/ and run test_queue on the device or host.
+// - On host: gcc -I.. test_queue.c ../queue.c ../dlog.c -lpthread -o test_queue
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "queue.h"
+
+#define PRODUCERS 4
+#define PER_PRODUCER 20000
+
+static void make_msg(char *buf, size_t size, int producer, int seq)
+{
+    snprintf(buf, size, "DnsRet:success,domain:p%d.example.com,UID:%d,PID:%d;1.1.1.1;",
+             producer, producer, seq);
+}
+
+static void *producer_main(void *arg)
+{
+    int producer = (int)(long)arg;
+    char msg[128];
+    for (int seq = 0; seq < PER_PRODUCER; seq++)
+    {
+        make_msg(msg, sizeof(msg), producer, seq);
+        while (BufferInQueue((const uint8 *)msg, strlen(msg)) == BUF_FULL)
+        {
+            // consumer is behind; retry
+        }
+    }
+    return NULL;
+}
+
+static void test_basic(void)
+{
+    char msg[128];
+    struct List_Node *node = NULL;
+    QUEUE_STATS_T stats;
+    ERROR_MESSAGE_T ret;
+
+    ret = QueueInit(4);
+    assert(ret == SUCCESS);
+    assert(IsEmptyQueue() == TRUE);
+    ret = BufferOutQueue(&node);
+    assert(ret == BUF_EMPTY);
+
+    ret = BufferInQueue((const uint8 *)"short", 5);
+    assert(ret == DATA_INVALID);
+    for (int i = 0; i < 4; i++)
+    {
+        make_msg(msg, sizeof(msg), 0, i);
+        ret = BufferInQueue((const uint8 *)msg, strlen(msg));
+        assert(ret == SUCCESS);
+    }
+    make_msg(msg, sizeof(msg), 0, 4);
+    ret = BufferInQueue((const uint8 *)msg, strlen(msg));
+    assert(ret == BUF_FULL);
+    assert(GetQueueSize() == 4);
+
+    for (int i = 0; i < 4; i++)
+    {
+        ret = BufferOutQueue(&node);
+        assert(ret == SUCCESS);
+        make_msg(msg, sizeof(msg), 0, i);
+        assert(node->len == strlen(msg));
+        assert(strcmp((const char *)node->data, msg) == 0);
+        BufferReleaseNode(node);
+    }
+    assert(IsEmptyQueue() == TRUE);
+
+    GetQueueStats(&stats);
+    assert(stats.capacity == 4);
+    assert(stats.enqueued == 4 && stats.dequeued == 4);
+    assert(stats.dropped == 1);
+    assert(stats.high_water == 4);
+    bufferDestroy();
+}
+
+static void test_batch(void)
+{
+    char msgs[6][128];
+    const uint8 *data[6];
+    uint32 len[6];
+    struct List_Node *node = NULL;
+    QUEUE_STATS_T stats;
+    ERROR_MESSAGE_T ret;
+
+    ret = QueueInit(4);
+    assert(ret == SUCCESS);
+    for (int i = 0; i < 6; i++)
+    {
+        make_msg(msgs[i], sizeof(msgs[i]), 1, i);
+        data[i] = (const uint8 *)msgs[i];
+        len[i] = strlen(msgs[i]);
+    }
+    len[1] = 3; // invalid, skipped without taking a slot
+    int queued = BufferInQueueBatch(data, len, 6);
+    assert(queued == 4);
+    GetQueueStats(&stats);
+    assert(stats.dropped == 1);
+
+    int expect[] = {0, 2, 3, 4};
+    for (int i = 0; i < 4; i++)
+    {
+        ret = BufferOutQueue(&node);
+        assert(ret == SUCCESS);
+        assert(strcmp((const char *)node->data, msgs[expect[i]]) == 0);
+        BufferReleaseNode(node);
+    }
+    bufferDestroy();
+}
+
+static long long now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void *delayed_producer_main(void *arg)
+{
+    (void)arg;
+    char msg[128];
+    ERROR_MESSAGE_T ret;
+    usleep(50 * 1000);
+    make_msg(msg, sizeof(msg), 2, 0);
+    ret = BufferInQueue((const uint8 *)msg, strlen(msg));
+    assert(ret == SUCCESS);
+    return NULL;
+}
+
+static void test_wait(void)
+{
+    pthread_t thread;
+    struct List_Node *node = NULL;
+    long long start;
+    ERROR_MESSAGE_T ret;
+
+    ret = QueueInit(8);
+    assert(ret == SUCCESS);
+
+    // timeout with nothing queued
+    start = now_ms();
+    ret = BufferOutQueueWait(&node, 30);
+    assert(ret == BUF_EMPTY);
+    assert(now_ms() - start >= 25);
+    ret = BufferOutQueueWait(&node, 0);
+    assert(ret == BUF_EMPTY);
+
+    // a sleeping consumer is woken by the producer
+    pthread_create(&thread, NULL, delayed_producer_main, NULL);
+    start = now_ms();
+    ret = BufferOutQueueWait(&node, 5000);
+    assert(ret == SUCCESS);
+    assert(now_ms() - start < 5000);
+    BufferReleaseNode(node);
+    pthread_join(thread, NULL);
+    bufferDestroy();
+}
+
+static RING_QUEUE_T *wait_ring;
+
+static void *blocked_producer_main(void *arg)
+{
+    char msg[128];
+    ERROR_MESSAGE_T ret;
+    make_msg(msg, sizeof(msg), 3, (int)(long)arg);
+    ret = RingQueuePushWait(wait_ring, (const uint8 *)msg, strlen(msg), -1);
+    assert(ret == SUCCESS);
+    return NULL;
+}
+
+static void test_push_wait(void)
+{
+    pthread_t threads[2];
+    char msg[128];
+    struct List_Node *node = NULL;
+    QUEUE_STATS_T stats;
+    long long start;
+    ERROR_MESSAGE_T ret;
+
+    wait_ring = RingQueueCreate(2);
+    assert(wait_ring != NULL);
+    make_msg(msg, sizeof(msg), 3, 0);
+    for (int i = 0; i < 2; i++)
+    {
+        ret = RingQueuePushWait(wait_ring, (const uint8 *)msg, strlen(msg), 0);
+        assert(ret == SUCCESS);
+    }
+
+    // a full ring times out and counts the drop
+    start = now_ms();
+    ret = RingQueuePushWait(wait_ring, (const uint8 *)msg, strlen(msg), 30);
+    assert(ret == BUF_FULL);
+    assert(now_ms() - start >= 25);
+    RingQueueGetStats(wait_ring, &stats);
+    assert(stats.dropped == 1);
+
+    // two sleeping producers both get through as the consumer releases slots
+    for (long i = 0; i < 2; i++)
+    {
+        pthread_create(&threads[i], NULL, blocked_producer_main, (void *)(i + 1));
+    }
+    usleep(50 * 1000);
+    assert(RingQueueSize(wait_ring) == 2);
+    for (int i = 0; i < 4; i++)
+    {
+        ret = RingQueuePopWait(wait_ring, &node, 5000);
+        assert(ret == SUCCESS);
+        RingQueueRelease(wait_ring, node);
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    RingQueueGetStats(wait_ring, &stats);
+    assert(stats.enqueued == 4 && stats.dropped == 1);
+    RingQueueDestroy(wait_ring);
+}
+
+static void *delayed_close_main(void *arg)
+{
+    (void)arg;
+    usleep(50 * 1000);
+    BufferCloseQueue();
+    return NULL;
+}
+
+static void test_close(void)
+{
+    pthread_t thread;
+    char msg[128];
+    struct List_Node *node = NULL;
+    long long start;
+    ERROR_MESSAGE_T ret;
+
+    ret = QueueInit(8);
+    assert(ret == SUCCESS);
+    assert(IsClosedQueue() == FALSE);
+
+    // a consumer sleeping without a timeout is woken by the close
+    pthread_create(&thread, NULL, delayed_close_main, NULL);
+    start = now_ms();
+    ret = BufferOutQueueWait(&node, -1);
+    assert(ret == BUF_EMPTY);
+    assert(now_ms() - start < 5000);
+    pthread_join(thread, NULL);
+    assert(IsClosedQueue() == TRUE);
+    bufferDestroy();
+
+    // data queued before the close is still drained, then the wait returns at once
+    ret = QueueInit(8);
+    assert(ret == SUCCESS);
+    for (int i = 0; i < 2; i++)
+    {
+        make_msg(msg, sizeof(msg), 4, i);
+        ret = BufferInQueue((const uint8 *)msg, strlen(msg));
+        assert(ret == SUCCESS);
+    }
+    BufferCloseQueue();
+    for (int i = 0; i < 2; i++)
+    {
+        ret = BufferOutQueueWait(&node, -1);
+        assert(ret == SUCCESS);
+        make_msg(msg, sizeof(msg), 4, i);
+        assert(strcmp((const char *)node->data, msg) == 0);
+        BufferReleaseNode(node);
+    }
+    start = now_ms();
+    ret = BufferOutQueueWait(&node, 5000);
+    assert(ret == BUF_EMPTY);
+    assert(now_ms() - start < 1000);
+    bufferDestroy();
+}
+
+static void test_concurrent(void)
+{
+    pthread_t threads[PRODUCERS];
+    int next_seq[PRODUCERS] = {0};
+    struct List_Node *node = NULL;
+    int received = 0;
+    ERROR_MESSAGE_T ret;
+
+    ret = QueueInit(256);
+    assert(ret == SUCCESS);
+    for (long i = 0; i < PRODUCERS; i++)
+    {
+        pthread_create(&threads[i], NULL, producer_main, (void *)i);
+    }
+    while (received < PRODUCERS * PER_PRODUCER)
+    {
+        ret = BufferOutQueueWait(&node, -1);
+        assert(ret == SUCCESS);
+        int producer = -1, uid = -1, seq = -1;
+        int fields = sscanf((const char *)node->data, "DnsRet:success,domain:p%d.example.com,UID:%d,PID:%d;",
+                            &producer, &uid, &seq);
+        assert(fields == 3);
+        // per-producer FIFO order must hold
+        assert(producer >= 0 && producer < PRODUCERS);
+        assert(seq == next_seq[producer]);
+        next_seq[producer]++;
+        BufferReleaseNode(node);
+        received++;
+    }
+    for (int i = 0; i < PRODUCERS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    assert(IsEmptyQueue() == TRUE);
+    bufferDestroy();
+}
+
+int main(void)
+{
+    printf("Running test_queue\n");
+    test_basic();
+    test_batch();
+    test_wait();
+    test_push_wait();
+    test_close();
+    test_concurrent();
+    printf("All tests passed.\n");
+    return 0;
+}
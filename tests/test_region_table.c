@@ -0,0 +1,277 @@
+// tests/test_region_table.c
+//
+// Builds region tables from small synthetic xdb files and checks them against
+// a linear scan of the segments: merging of adjacent domestic segments, holes
+// between segments, segments crossing /16 boundaries, the first and last
+// IPv4 addresses, and rebuilding the table after the file is replaced.
+//
+// Usage:
+// - In AOSP: `mm` in tests/ and run test_region_table on the device or host.
+// - On host: gcc -I.. -DREGION_TABLE_CHECK_INTERVAL=0 test_region_table.c ../region_table.c ../file_watch.c ../xdb_searcher.c ../dlog.c -o test_region_table
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "region_table.h"
+#include "xdb_searcher.h"
+
+#ifdef __ANDROID__
+#define DB_PATH "/data/local/tmp/test_region_table.xdb"
+#else
+#define DB_PATH "/tmp/test_region_table.xdb"
+#endif
+
+#define IP(a, b, c, d) (((uint32)(a) << 24) | ((uint32)(b) << 16) | ((uint32)(c) << 8) | (uint32)(d))
+#define CN_GD "中国|0|广东省|深圳市|电信"
+#define CN_BJ "中国|0|北京|北京市|联通"
+#define US "美国|0|加利福尼亚|0|0"
+#define LAN "0|0|0|内网IP|内网IP"
+
+typedef struct segment
+{
+    uint32 sip;
+    uint32 eip;
+    const char *region;
+} segment_t;
+
+static void put_uint(unsigned char *buf, uint32 value)
+{
+    buf[0] = (unsigned char)value;
+    buf[1] = (unsigned char)(value >> 8);
+    buf[2] = (unsigned char)(value >> 16);
+    buf[3] = (unsigned char)(value >> 24);
+}
+
+// 按xdb格式写出：头部、空的向量索引、地区字符串、segment索引，先写临时文件再rename
+static void write_xdb(const segment_t *segments, int count)
+{
+    size_t data_ptr = xdb_header_info_length + xdb_vector_index_length;
+    size_t data_len = 0;
+    for (int i = 0; i < count; i++)
+    {
+        data_len += strlen(segments[i].region);
+    }
+    size_t index_ptr = data_ptr + data_len;
+    size_t size = index_ptr + (size_t)count * xdb_segment_index_size;
+    unsigned char *buf = (unsigned char *)calloc(1, size);
+    assert(buf != NULL);
+
+    put_uint(buf + 8, (uint32)index_ptr);
+    put_uint(buf + 12, (uint32)(index_ptr + (size_t)(count - 1) * xdb_segment_index_size));
+    for (int i = 0; i < count; i++)
+    {
+        unsigned char *segment = buf + index_ptr + (size_t)i * xdb_segment_index_size;
+        size_t len = strlen(segments[i].region);
+        memcpy(buf + data_ptr, segments[i].region, len);
+        put_uint(segment, segments[i].sip);
+        put_uint(segment + 4, segments[i].eip);
+        segment[8] = (unsigned char)len;
+        segment[9] = (unsigned char)(len >> 8);
+        put_uint(segment + 10, (uint32)data_ptr);
+        data_ptr += len;
+    }
+
+    FILE *file = fopen(DB_PATH ".tmp", "wb");
+    assert(file != NULL);
+    size_t written = fwrite(buf, 1, size, file);
+    assert(written == size);
+    fclose(file);
+    int ret = rename(DB_PATH ".tmp", DB_PATH);
+    assert(ret == 0);
+    free(buf);
+}
+
+// segment按地址升序，二分找包含ip的segment
+static char expected_region(const segment_t *segments, int count, uint32 ip)
+{
+    int lo = 0, hi = count - 1;
+    while (lo <= hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (ip < segments[mid].sip)
+        {
+            hi = mid - 1;
+        }
+        else if (ip > segments[mid].eip)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            return strstr(segments[mid].region, "中国") != NULL;
+        }
+    }
+    return 0; // 空洞按查不到处理
+}
+
+static void check_ip(const segment_t *segments, int count, uint32 ip)
+{
+    char is_china = -1;
+    int ret = region_table_lookup(ip, &is_china);
+    assert(ret == 0);
+    assert(is_china == expected_region(segments, count, ip));
+}
+
+// 每个segment两端、所有/16边界和随机地址都与逐段查找的结果一致
+static void check_all(const segment_t *segments, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        check_ip(segments, count, segments[i].sip - 1);
+        check_ip(segments, count, segments[i].sip);
+        check_ip(segments, count, segments[i].eip);
+        check_ip(segments, count, segments[i].eip + 1);
+    }
+    for (uint32 prefix = 0; prefix < REGION_TABLE_PREFIX_COUNT; prefix++)
+    {
+        check_ip(segments, count, prefix << 16);
+        check_ip(segments, count, (prefix << 16) - 1);
+    }
+    srand(1);
+    for (int i = 0; i < 100000; i++)
+    {
+        check_ip(segments, count, ((uint32)rand() << 16) ^ (uint32)rand());
+    }
+}
+
+static void test_merge_and_holes(void)
+{
+    const segment_t segments[] = {
+        {IP(0, 0, 0, 0), IP(0, 255, 255, 255), LAN},
+        {IP(1, 0, 0, 0), IP(1, 0, 0, 255), CN_GD},
+        {IP(1, 0, 1, 0), IP(1, 0, 3, 255), CN_BJ},        // 与上一段合并
+        {IP(1, 0, 8, 0), IP(1, 0, 8, 255), CN_GD},        // 前面是空洞
+        {IP(2, 0, 255, 0), IP(2, 1, 0, 255), CN_BJ},      // 跨/16边界
+        {IP(2, 1, 1, 0), IP(2, 1, 1, 255), US},           // 与后面的空洞合并
+        {IP(223, 255, 255, 0), IP(255, 255, 255, 255), CN_GD},
+    };
+    const uint32 starts[] = {
+        IP(0, 0, 0, 0), IP(1, 0, 0, 0), IP(1, 0, 4, 0), IP(1, 0, 8, 0),
+        IP(1, 0, 9, 0), IP(2, 0, 255, 0), IP(2, 1, 1, 0), IP(223, 255, 255, 0),
+    };
+    const int count = (int)(sizeof(segments) / sizeof(segments[0]));
+    const uint32 ranges = (uint32)(sizeof(starts) / sizeof(starts[0]));
+
+    write_xdb(segments, count);
+    region_table_t *table = region_table_build(DB_PATH);
+    assert(table != NULL);
+    assert(table->count == ranges);
+    for (uint32 i = 0; i < ranges; i++)
+    {
+        assert(table->starts[i] == starts[i]);
+        assert(((table->domestic[i >> 3] >> (i & 7)) & 1) == (i % 2));
+    }
+    region_table_free(table);
+
+    int ret = region_table_init(DB_PATH);
+    assert(ret == 0);
+    check_all(segments, count);
+    region_table_deinit();
+}
+
+// 首尾地址不在任何segment中
+static void test_uncovered_ends(void)
+{
+    const segment_t segments[] = {
+        {IP(10, 0, 0, 0), IP(10, 0, 0, 255), CN_GD},
+        {IP(10, 0, 1, 0), IP(10, 0, 1, 255), US},
+    };
+    const int count = (int)(sizeof(segments) / sizeof(segments[0]));
+
+    write_xdb(segments, count);
+    int ret = region_table_init(DB_PATH);
+    assert(ret == 0);
+    check_all(segments, count);
+    region_table_deinit();
+}
+
+// 随机长度的segment，夹杂空洞，覆盖整个地址空间
+static void test_random(void)
+{
+    static segment_t segments[4096];
+    const char *regions[] = {CN_GD, CN_BJ, US, LAN};
+    unsigned long long next = 0;
+    int count = 0;
+
+    srand(2);
+    while (next <= 0xFFFFFFFFULL && count < (int)(sizeof(segments) / sizeof(segments[0])))
+    {
+        unsigned long long length = 1 + (unsigned long long)rand() % (1ULL << (rand() % 24 + 1));
+        if (rand() % 4 == 0)
+        {
+            next += length; // 留出空洞
+        }
+        if (next > 0xFFFFFFFFULL)
+        {
+            break;
+        }
+        unsigned long long eip = next + length - 1;
+        if (eip > 0xFFFFFFFFULL)
+        {
+            eip = 0xFFFFFFFFULL;
+        }
+        segments[count].sip = (uint32)next;
+        segments[count].eip = (uint32)eip;
+        segments[count].region = regions[rand() % 4];
+        count++;
+        next = eip + 1;
+    }
+
+    write_xdb(segments, count);
+    int ret = region_table_init(DB_PATH);
+    assert(ret == 0);
+    check_all(segments, count);
+    region_table_deinit();
+}
+
+static void test_reload(void)
+{
+    const segment_t before[] = {
+        {IP(1, 0, 0, 0), IP(1, 0, 0, 255), CN_GD},
+    };
+    const segment_t after[] = {
+        {IP(1, 0, 0, 0), IP(1, 0, 0, 255), US},
+        {IP(5, 0, 0, 0), IP(5, 255, 255, 255), CN_BJ},
+    };
+    char is_china = -1;
+    int ret;
+
+    write_xdb(before, 1);
+    ret = region_table_init(DB_PATH);
+    assert(ret == 0);
+    region_table_check_reload(); // 文件没有变化
+    ret = region_table_lookup(IP(1, 0, 0, 1), &is_china);
+    assert(ret == 0 && is_china == 1);
+
+    write_xdb(after, 2);
+    region_table_check_reload();
+    check_all(after, 2);
+
+    // 新文件无法解析时保留旧表
+    FILE *file = fopen(DB_PATH ".tmp", "wb");
+    assert(file != NULL);
+    fputs("not an xdb", file);
+    fclose(file);
+    ret = rename(DB_PATH ".tmp", DB_PATH);
+    assert(ret == 0);
+    region_table_check_reload();
+    ret = region_table_lookup(IP(5, 1, 2, 3), &is_china);
+    assert(ret == 0 && is_china == 1);
+
+    region_table_deinit();
+    ret = region_table_lookup(IP(5, 1, 2, 3), &is_china);
+    assert(ret == 1);
+}
+
+int main(void)
+{
+    printf("Running test_region_table\n");
+    test_merge_and_holes();
+    test_uncovered_ends();
+    test_random();
+    test_reload();
+    remove(DB_PATH);
+    printf("All tests passed.\n");
+    return 0;
+}
@@ -0,0 +1,103 @@
+// tests/test_rule_ipset.cpp
+//
+// Checks how runs of address-only rules are compiled into ipsets.
+//
+// Usage:
+// - In AOSP: `mm` in tests/ and run test_rule_ipset on the device or host.
+// - On host: g++ -std=c++17 -I.. test_rule_ipset.cpp ../rule_ipset.cpp -o test_rule_ipset
+
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "rule_ipset.h"
+
+static void test_run_is_compiled() {
+    std::vector<std::string> lines = {
+        "-N oem_out",
+        "-A OUTPUT -d 1.1.1.1 -j DROP",
+        "-A OUTPUT -d 2.2.2.0/24 -j DROP",
+        "-A OUTPUT -d 3.3.3.3/32 -j DROP",
+        "-A OUTPUT -p tcp -d 4.4.4.4 -j DROP",
+    };
+    std::vector<IpsetRun> runs = find_ipset_runs(lines, "filter", 3);
+    assert(runs.size() == 1);
+    assert(runs[0].first == 1 && runs[0].count == 3);
+    assert(runs[0].members == std::vector<std::string>({"1.1.1.1", "2.2.2.0/24", "3.3.3.3/32"}));
+    assert(runs[0].name.compare(0, 6, IPSET_NAME_PREFIX) == 0 && runs[0].name.size() == 14);
+    assert(runs[0].rule == "-A OUTPUT -m set --match-set " + runs[0].name + " dst -j DROP");
+
+    // the name depends on the table, the run ordinal and the template, not on the addresses
+    std::vector<IpsetRun> again = find_ipset_runs({lines[2], lines[3], lines[1]}, "filter", 3);
+    assert(again.size() == 1 && again[0].name == runs[0].name);
+    assert(find_ipset_runs({lines[2], lines[3], lines[1]}, "mangle", 3)[0].name != runs[0].name);
+    assert(find_ipset_runs(lines, "filter", 3, 1)[0].name != runs[0].name);
+}
+
+// two runs with the same template must not share a set, or the second
+// set_ipset would replace the members of the first
+static void test_same_template_runs() {
+    std::vector<std::string> lines = {
+        "-A OUTPUT -d 1.1.1.1 -j DROP",
+        "-A OUTPUT -d 2.2.2.2 -j DROP",
+        "-A OUTPUT -p udp --dport 53 -j ACCEPT",
+        "-A OUTPUT -d 3.3.3.3 -j DROP",
+        "-A OUTPUT -d 4.4.4.4 -j DROP",
+    };
+    std::vector<IpsetRun> runs = find_ipset_runs(lines, "filter", 2);
+    assert(runs.size() == 2);
+    assert(runs[0].name != runs[1].name);
+    assert(runs[0].members == std::vector<std::string>({"1.1.1.1", "2.2.2.2"}));
+    assert(runs[1].members == std::vector<std::string>({"3.3.3.3", "4.4.4.4"}));
+    assert(runs[0].rule == "-A OUTPUT -m set --match-set " + runs[0].name + " dst -j DROP");
+    assert(runs[1].rule == "-A OUTPUT -m set --match-set " + runs[1].name + " dst -j DROP");
+
+    // the same run in a later batch of the same table
+    std::vector<IpsetRun> next = find_ipset_runs({lines[0], lines[1]}, "filter", 2, runs.size());
+    assert(next.size() == 1);
+    assert(next[0].name != runs[0].name && next[0].name != runs[1].name);
+}
+
+static void test_stateful_not_compiled() {
+    const char* matches[] = {
+        "-m limit --limit 5/s", "-m quota --quota 1000", "-m recent --rcheck",
+        "-m connlimit --connlimit-above 4", "--match statistic --mode nth --every 2",
+    };
+    for (const char* match : matches) {
+        std::vector<std::string> lines;
+        for (int i = 1; i <= 4; i++) {
+            lines.push_back("-A INPUT -s 10.0.0." + std::to_string(i) + " " + match + " -j ACCEPT");
+        }
+        assert(find_ipset_runs(lines, "filter", 2).empty());
+    }
+}
+
+static void test_runs_are_split() {
+    std::vector<std::string> lines = {
+        "-A INPUT -s 1.1.1.1 -j DROP",
+        "-A INPUT -s 2.2.2.2 -j DROP",
+        "-A INPUT -d 3.3.3.3 -j DROP",
+        "-A INPUT -d 4.4.4.4 -j DROP",
+        "-A INPUT ! -d 5.5.5.5 -j DROP",
+        "-A INPUT -d 0.0.0.0/0 -j DROP",
+        "-A INPUT -d 6.6.6.6 -j DROP",
+        "-A INPUT -d 7.7.7.7 -s 8.8.8.8 -j DROP",
+        "-A INPUT -d 9.9.9.9 -j DROP",
+    };
+    std::vector<IpsetRun> runs = find_ipset_runs(lines, "filter", 2);
+    assert(runs.size() == 2);
+    assert(runs[0].first == 0 && runs[0].count == 2);
+    assert(runs[1].first == 2 && runs[1].count == 2);
+    assert(runs[0].name != runs[1].name);
+    assert(find_ipset_runs(lines, "filter", 0).empty());
+}
+
+int main() {
+    std::cout << "Running test_rule_ipset\n";
+    test_run_is_compiled();
+    test_runs_are_split();
+    test_same_template_runs();
+    test_stateful_not_compiled();
+    std::cout << "All tests passed.\n";
+    return 0;
+}
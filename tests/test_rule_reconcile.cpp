@@ -0,0 +1,103 @@
+// tests/test_rule_reconcile.cpp
+//
+// Checks the rule normalization and the delta computed by reconcile mode (-R).
+//
+// Usage:
+// - In AOSP: `mm` in tests/ and run test_rule_reconcile on the device or host.
+// - On host: g++ -std=c++17 -I.. test_rule_reconcile.cpp ../rule_reconcile.cpp -o test_rule_reconcile
+
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "rule_reconcile.h"
+
+static void test_canonical_rule() {
+    assert(canonical_rule("-p tcp --dport 80 -s 1.2.3.4 -j DROP") ==
+           "-s 1.2.3.4/32 -p tcp -m tcp --dport 80 -j DROP");
+    assert(canonical_rule("--protocol UDP -m udp --destination-port 53  --jump ACCEPT") ==
+           "-p udp -m udp --dport 53 -j ACCEPT");
+    assert(canonical_rule("! -d 10.0.0.0/8 -o wlan0 -j REJECT") ==
+           "! -d 10.0.0.0/8 -o wlan0 -j REJECT --reject-with icmp-port-unreachable");
+    assert(canonical_rule("-s 0.0.0.0/0 -m comment --comment \"oem fw\" -j oem_in") ==
+           "-m comment --comment oem fw -j oem_in");
+}
+
+static const char* kLive =
+    "-P INPUT ACCEPT\n"
+    "-P OUTPUT ACCEPT\n"
+    "-N oem_in\n"
+    "-A INPUT -j bw_INPUT\n"
+    "-A INPUT -j oem_in\n"
+    "-A INPUT -s 9.9.9.9/32 -j DROP\n"
+    "-A oem_in -s 1.1.1.1/32 -j DROP\n"
+    "-A oem_in -p tcp -m tcp --dport 23 -j DROP\n";
+
+static void test_up_to_date() {
+    std::vector<std::string> desired = {
+        "-D INPUT -j oem_missing",
+        "-N oem_in",
+        "-A oem_in -s 1.1.1.1 -j DROP",
+        "-A oem_in -p tcp --dport 23 -j DROP",
+        "-A INPUT -j oem_in",
+    };
+    std::string delta;
+    bool ok = reconcile_table(desired, kLive, &delta);
+    assert(ok);
+    assert(delta.empty());
+}
+
+static void test_append_tail_and_new_chain() {
+    std::vector<std::string> desired = {
+        "-N oem_in",
+        "-A oem_in -s 1.1.1.1 -j DROP",
+        "-A oem_in -p tcp --dport 23 -j DROP",
+        "-A oem_in -s 2.2.2.2 -j DROP",
+        "-N oem_out",
+        "-A oem_out -d 3.3.3.3 -j DROP",
+        "-A INPUT -j oem_in",
+        "-I OUTPUT -j oem_out",
+        "-D INPUT -s 9.9.9.9 -j DROP",
+    };
+    std::string delta;
+    bool ok = reconcile_table(desired, kLive, &delta);
+    assert(ok);
+    assert(delta ==
+           "-N oem_out\n"
+           "-A oem_in -s 2.2.2.2 -j DROP\n"
+           "-A oem_out -d 3.3.3.3 -j DROP\n"
+           "-D INPUT -s 9.9.9.9 -j DROP\n"
+           "-I OUTPUT -j oem_out\n");
+}
+
+static void test_rebuild_changed_chain() {
+    std::vector<std::string> desired = {
+        "-N oem_in",
+        "-A oem_in -p tcp --dport 23 -j DROP",
+        "-A INPUT -j oem_in",
+    };
+    std::string delta;
+    bool ok = reconcile_table(desired, kLive, &delta);
+    assert(ok);
+    assert(delta ==
+           "-F oem_in\n"
+           "-A oem_in -p tcp --dport 23 -j DROP\n");
+}
+
+static void test_unsupported_command() {
+    std::vector<std::string> desired = {"-X oem_in", "-N oem_in"};
+    std::string delta;
+    bool ok = reconcile_table(desired, kLive, &delta);
+    assert(!ok);
+}
+
+int main() {
+    std::cout << "Running test_rule_reconcile\n";
+    test_canonical_rule();
+    test_up_to_date();
+    test_append_tail_and_new_chain();
+    test_rebuild_changed_chain();
+    test_unsupported_command();
+    std::cout << "All tests passed.\n";
+    return 0;
+}
@@ -0,0 +1,117 @@
+/**
+ * @file host_main.c
+ * @brief 在普通Linux主机上运行DNS上报处理流程，不连接netd，日志写入selog_stub
+ * @note 只用于压测，参数与ioemnetd中对应的参数相同
+ * @version 0.1
+ * @date 2025-09-01
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dlog.h"
+#include "dns_client.h"
+#include "enforce.h"
+
+static void PrintHelpInfo(void)
+{
+    printf("Usage: ioemnetd_host -d <db_path> -l <sink_path> [options]\n");
+    printf(" -d <file_path> : Specify the path to the file containing DNS database.\n");
+    printf(" -l <path> : Specify the file or directory selog_stub appends records to.\n");
+    printf(" -r <region> : Specify the region to filter IP addresses. (0 for china; 1 for other country)\n");
+    printf(" -b <count> : Specify the max number of DNS reports received per syscall. (default 32)\n");
+    printf(" -s <bytes> : Specify the receive buffer size of the DNS report socket. (default: system)\n");
+    printf(" -q <count> : Specify the capacity of the DNS report queue, rounded up to a power of 2. (default 1024)\n");
+    printf(" -w <count> : Specify the number of DNS report worker threads. (default 1, max 16)\n");
+    printf(" -m <mode> : Specify the DNS database search mode: file, vector, buffer or mmap. (default vector)\n");
+    printf(" -e local : Push matched IPs into the in-memory enforcement backend. (default off)\n");
+    printf(" -g <ms> : Collapse identical DNS events within <ms> milliseconds into one record, 0 to disable. (default 0)\n");
+    printf(" -o <policy> : Specify what to do when the log queue is full: drop-oldest, drop-newest or block. (default drop-oldest)\n");
+    printf(" -p <file_path> : Specify the path to the package list used to resolve UIDs.\n");
+    printf(" -u <path> : Specify the control socket answering stats, histograms and cache, off to disable.\n");
+    printf(" -v <level> : Specify the diagnostic log level: verbose, debug, info, warn, error or none. (default info)\n");
+    printf(" -h : Show this help message.\n");
+}
+
+static void PraseCommandLine(int argc, char **argv)
+{
+    char *db_path = NULL;
+    char *log_path = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            db_path = argv[++i];
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            log_path = argv[++i];
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            set_region((char)atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            set_recv_batch(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            set_recv_buffer_size(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc) {
+            set_queue_capacity(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            set_worker_count(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            set_xdb_mode(argv[++i]);
+        } else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc && strcmp(argv[i + 1], "local") == 0) {
+            i++;
+            set_enforce_backend(enforce_local_backend());
+        } else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+            set_aggregate_window(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            set_log_overflow_policy(argv[++i]);
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            set_package_list_path(argv[++i]);
+        } else if (strcmp(argv[i], "-u") == 0 && i + 1 < argc) {
+            set_control_socket_path(argv[++i]);
+        } else if (strcmp(argv[i], "-v") == 0 && i + 1 < argc) {
+            int level;
+            if (dlog_level_parse(argv[++i], &level) != 0) {
+                PrintHelpInfo();
+                exit(EXIT_FAILURE);
+            }
+            dlog_set_level(level);
+        } else if (strcmp(argv[i], "-h") == 0) {
+            PrintHelpInfo();
+            exit(EXIT_SUCCESS);
+        } else {
+            PrintHelpInfo();
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (db_path == NULL || log_path == NULL)
+    {
+        PrintHelpInfo();
+        exit(EXIT_FAILURE);
+    }
+    set_db_path(db_path);
+    set_log_path(log_path);
+}
+
+int main(int argc, char **argv)
+{
+    PraseCommandLine(argc, argv);
+    if (dns_client_init() != 0)
+    {
+        fprintf(stderr, "Failed to initialize DNS client\n");
+        return EXIT_FAILURE;
+    }
+    signal(SIGINT, Stop_And_Exit);
+    signal(SIGTERM, Stop_And_Exit);
+
+    if (dns_client_start() != 0)
+    {
+        fprintf(stderr, "Failed to start DNS client\n");
+        dns_client_shutdown();
+        return EXIT_FAILURE;
+    }
+    dns_client_wait_stop();
+    dns_client_shutdown();
+    return EXIT_SUCCESS;
+}
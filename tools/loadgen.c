@@ -0,0 +1,645 @@
+/**
+ * @file loadgen.c
+ * @brief DNS上报压测工具：按给定速率和分布发送上报，或回放抓取的上报，
+ *        统计守护进程的吞吐、丢包和到Selog写入为止的端到端延迟
+ * @note 指定-o时在每条上报的域名前加上"lg<发送时的单调时钟纳秒>."，
+ *       再从selog_stub的输出中找回，所以带标记的上报不会被合并
+ * @version 0.1
+ * @date 2025-09-01
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#include <arpa/inet.h>
+#include <errno.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOADGEN_DEFAULT_PORT 19330   // 与dns_client.c中的LISTEN_PORT相同
+#define LOADGEN_MAX_MESSAGE 1024     // 与QUEUE_SLOT_SIZE相同，更长的上报会被守护进程丢弃
+#define LOADGEN_MAX_IPS 32           // 单条上报最多的IP数
+#define LOADGEN_BURST 64             // 不限速时每次检查时间前发送的条数
+#define LOADGEN_LATENCY_TAG "lg"     // 延迟标记前缀
+#define LOADGEN_CONTROL_RESPONSE 16384
+
+typedef struct trace_entry
+{
+    uint64_t offset_ns; // 相对抓取开始的时间，没有时间戳时为0
+    char *message;
+} trace_entry_t;
+
+typedef struct daemon_counters
+{
+    uint64_t received;
+    uint64_t too_long;
+    uint64_t queue_full;
+    uint64_t kernel_dropped;
+    uint64_t processed;
+    uint64_t malformed;
+    uint64_t logged;
+    uint64_t events_dropped;
+    uint64_t dispatch_dropped;
+    uint64_t log_dropped;
+} daemon_counters_t;
+
+static const char *target_addr = "127.0.0.1";
+static int target_port = LOADGEN_DEFAULT_PORT;
+static double rate = 10000;       // 每秒条数，0表示不限速
+static double duration_s = 10;
+static int domain_count = 1000;
+static int uid_count = 50;
+static int max_ips = 4;
+static double skew = 1.0;         // Zipf指数，0表示均匀分布
+static int malformed_pct = 0;
+static int report_pid = 0;
+static uint64_t seed = 1;
+static const char *trace_path = NULL;
+static double trace_speed = 1.0;
+static const char *sink_path = NULL;
+static const char *control_path = NULL;
+static int drain_ms = 1000;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_until_ns(uint64_t deadline)
+{
+    struct timespec ts;
+    ts.tv_sec = (time_t)(deadline / 1000000000ULL);
+    ts.tv_nsec = (long)(deadline % 1000000000ULL);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    {
+    }
+}
+
+static uint64_t next_random(void)
+{
+    // xorshift64*，固定种子时每次运行发送的序列相同
+    seed ^= seed >> 12;
+    seed ^= seed << 25;
+    seed ^= seed >> 27;
+    return seed * 2685821657736338717ULL;
+}
+
+static uint32_t mix32(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+/**
+ * @brief 生成Zipf分布的累积概率表，第k个取值的概率正比于1/(k+1)^s
+ */
+static double *zipf_build(int n, double s)
+{
+    double *cdf = malloc(sizeof(double) * (size_t)n);
+    double sum = 0;
+    if (cdf == NULL)
+    {
+        return NULL;
+    }
+    for (int k = 0; k < n; k++)
+    {
+        sum += 1.0 / pow(k + 1, s);
+        cdf[k] = sum;
+    }
+    for (int k = 0; k < n; k++)
+    {
+        cdf[k] /= sum;
+    }
+    return cdf;
+}
+
+static int zipf_sample(const double *cdf, int n)
+{
+    double u = (double)(next_random() >> 11) / (double)(1ULL << 53);
+    int lo = 0;
+    int hi = n - 1;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (cdf[mid] < u)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * @brief 生成一条上报，同一个域名每次解析出相同的IP
+ */
+static int build_message(char *buf, size_t cap, int domain, int uid)
+{
+    int ip_count = 1 + (int)(mix32((uint32_t)domain) % (uint32_t)max_ips);
+    int len;
+
+    if ((int)(next_random() % 100) < malformed_pct)
+    {
+        return snprintf(buf, cap, "DnsRet:success,domain:www.site%d.com;", domain);
+    }
+    len = snprintf(buf, cap, "DnsRet:success,domain:www.site%d.com,UID:%d,PID:%d;", domain, 10000 + uid, report_pid);
+    for (int i = 0; i < ip_count && len < (int)cap; i++)
+    {
+        uint32_t ip = mix32((uint32_t)domain * LOADGEN_MAX_IPS + (uint32_t)i + 1);
+        len += snprintf(buf + len, cap - (size_t)len, "%s%u.%u.%u.%u", i ? "," : "", ip >> 24, (ip >> 16) & 0xFF,
+                        (ip >> 8) & 0xFF, ip & 0xFF);
+    }
+    if (len < (int)cap)
+    {
+        len += snprintf(buf + len, cap - (size_t)len, ";");
+    }
+    return len < (int)cap ? len : (int)cap - 1;
+}
+
+/**
+ * @brief 在"domain:"之后插入延迟标记，没有域名字段的上报原样发送
+ */
+static int tag_message(const char *message, char *buf, size_t cap, uint64_t send_ns)
+{
+    const char *domain = strstr(message, "domain:");
+    int len;
+    if (domain == NULL)
+    {
+        len = snprintf(buf, cap, "%s", message);
+    }
+    else
+    {
+        domain += strlen("domain:");
+        len = snprintf(buf, cap, "%.*s" LOADGEN_LATENCY_TAG "%llu.%s", (int)(domain - message), message,
+                       (unsigned long long)send_ns, domain);
+    }
+    return len < (int)cap ? len : (int)cap - 1;
+}
+
+/**
+ * @brief 读取抓取的上报，每行一条；行首可带相对开始时间的微秒数和一个空格，
+ *        全部带时间戳时按原始节奏回放
+ */
+static trace_entry_t *trace_load(const char *path, int *count, int *timed)
+{
+    FILE *file = fopen(path, "r");
+    char line[LOADGEN_MAX_MESSAGE * 2];
+    trace_entry_t *entries = NULL;
+    int capacity = 0;
+
+    *count = 0;
+    *timed = 1;
+    if (file == NULL)
+    {
+        fprintf(stderr, "Cannot open trace %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        char *message = line;
+        uint64_t offset_ns = 0;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#')
+        {
+            continue;
+        }
+        if (line[0] >= '0' && line[0] <= '9')
+        {
+            char *end;
+            offset_ns = strtoull(line, &end, 10) * 1000ULL;
+            message = end + strspn(end, " \t");
+        }
+        else
+        {
+            *timed = 0;
+        }
+        if (*count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 1024;
+            trace_entry_t *grown = realloc(entries, sizeof(trace_entry_t) * (size_t)capacity);
+            if (grown == NULL)
+            {
+                break;
+            }
+            entries = grown;
+        }
+        entries[*count].offset_ns = offset_ns;
+        entries[*count].message = strdup(message);
+        (*count)++;
+    }
+    fclose(file);
+    if (*count == 0)
+    {
+        fprintf(stderr, "Trace %s has no messages\n", path);
+        free(entries);
+        return NULL;
+    }
+    return entries;
+}
+
+static int control_query(const char *path, const char *request, char *response, size_t cap)
+{
+    struct sockaddr_un addr;
+    size_t got = 0;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd < 0)
+    {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        write(fd, request, strlen(request)) != (ssize_t)strlen(request))
+    {
+        close(fd);
+        return -1;
+    }
+    while (got + 1 < cap)
+    {
+        ssize_t n = read(fd, response + got, cap - 1 - got);
+        if (n <= 0)
+        {
+            break;
+        }
+        got += (size_t)n;
+    }
+    response[got] = '\0';
+    close(fd);
+    return 0;
+}
+
+static uint64_t control_value(const char *response, const char *key)
+{
+    size_t key_len = strlen(key);
+    for (const char *line = response; line != NULL && *line != '\0';)
+    {
+        if (strncmp(line, key, key_len) == 0 && line[key_len] == ' ')
+        {
+            return strtoull(line + key_len + 1, NULL, 10);
+        }
+        line = strchr(line, '\n');
+        line = line ? line + 1 : NULL;
+    }
+    return 0;
+}
+
+static int read_counters(daemon_counters_t *counters)
+{
+    char response[LOADGEN_CONTROL_RESPONSE];
+    if (control_path == NULL || control_query(control_path, "stats\n", response, sizeof(response)) != 0)
+    {
+        return -1;
+    }
+    counters->received = control_value(response, "counters.packets_received");
+    counters->too_long = control_value(response, "counters.packets_too_long");
+    counters->queue_full = control_value(response, "counters.packets_queue_full");
+    counters->kernel_dropped = control_value(response, "counters.packets_kernel_dropped");
+    counters->processed = control_value(response, "counters.messages_processed");
+    counters->malformed = control_value(response, "counters.messages_malformed");
+    counters->logged = control_value(response, "counters.events_logged");
+    counters->events_dropped = control_value(response, "counters.events_dropped");
+    counters->dispatch_dropped = control_value(response, "dispatch_queue.dropped");
+    counters->log_dropped = control_value(response, "log_writer.dropped_oldest") +
+                            control_value(response, "log_writer.dropped_newest");
+    return 0;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t percentile(const uint64_t *sorted, size_t count, double pct)
+{
+    size_t index = (size_t)ceil(pct / 100.0 * (double)count);
+    return sorted[index > 0 ? index - 1 : 0];
+}
+
+/**
+ * @brief 从selog_stub输出的offset处开始，找回带标记的记录计算延迟
+ */
+static void report_sink(off_t offset, uint64_t start_ns, double seconds)
+{
+    FILE *file = fopen(sink_path, "r");
+    char *line = NULL;
+    size_t line_cap = 0;
+    uint64_t *latencies = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    uint64_t records = 0;
+
+    if (file == NULL || fseeko(file, offset, SEEK_SET) != 0)
+    {
+        fprintf(stderr, "Cannot read sink %s: %s\n", sink_path, strerror(errno));
+        if (file != NULL)
+        {
+            fclose(file);
+        }
+        return;
+    }
+    while (getline(&line, &line_cap, file) > 0)
+    {
+        uint64_t write_ns = strtoull(line, NULL, 10);
+        const char *tag = strstr(line, "\"Domain\":\"" LOADGEN_LATENCY_TAG);
+        records++;
+        if (tag == NULL)
+        {
+            continue;
+        }
+        uint64_t send_ns = strtoull(tag + strlen("\"Domain\":\"" LOADGEN_LATENCY_TAG), NULL, 10);
+        if (send_ns < start_ns || write_ns < send_ns)
+        {
+            continue; // 之前运行留下的记录
+        }
+        if (count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 4096;
+            uint64_t *grown = realloc(latencies, sizeof(uint64_t) * capacity);
+            if (grown == NULL)
+            {
+                break;
+            }
+            latencies = grown;
+        }
+        latencies[count++] = write_ns - send_ns;
+    }
+    free(line);
+    fclose(file);
+
+    printf("sink: %llu records, %zu tagged (%.0f/s acknowledged)\n", (unsigned long long)records, count,
+           count / seconds);
+    if (count > 0)
+    {
+        qsort(latencies, count, sizeof(uint64_t), compare_u64);
+        printf("end-to-end latency us: p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+               percentile(latencies, count, 50) / 1e3, percentile(latencies, count, 90) / 1e3,
+               percentile(latencies, count, 99) / 1e3, percentile(latencies, count, 99.9) / 1e3,
+               latencies[count - 1] / 1e3);
+    }
+    free(latencies);
+}
+
+static void PrintHelpInfo(void)
+{
+    printf("Usage: ioemnetd_loadgen [options]\n");
+    printf(" -a <addr> : Specify the daemon address. (default 127.0.0.1)\n");
+    printf(" -P <port> : Specify the daemon port. (default %d)\n", LOADGEN_DEFAULT_PORT);
+    printf(" -r <rate> : Specify the reports sent per second, 0 for as fast as possible. (default 10000)\n");
+    printf(" -t <seconds> : Specify how long to send. (default 10)\n");
+    printf(" -n <count> : Specify the number of distinct domains. (default 1000)\n");
+    printf(" -U <count> : Specify the number of distinct UIDs. (default 50)\n");
+    printf(" -i <count> : Specify the max number of IPs per report, 1 to %d. (default 4)\n", LOADGEN_MAX_IPS);
+    printf(" -z <s> : Specify the Zipf exponent of the domain and UID distribution, 0 for uniform. (default 1.0)\n");
+    printf(" -m <percent> : Specify the percentage of malformed reports. (default 0)\n");
+    printf(" -p <pid> : Specify the PID carried in reports. (default: this process)\n");
+    printf(" -S <seed> : Specify the random seed. (default 1)\n");
+    printf(" -f <file> : Replay reports from a trace, one per line, optionally prefixed by a microsecond offset.\n");
+    printf(" -x <factor> : Speed up a timed trace by <factor>. (default 1)\n");
+    printf(" -o <file> : Tag reports and read the selog_stub output to measure end-to-end latency.\n");
+    printf(" -c <path> : Read drop counters from the daemon control socket.\n");
+    printf(" -d <ms> : Specify how long to wait for the daemon to drain after sending. (default 1000)\n");
+    printf(" -h : Show this help message.\n");
+}
+
+static void PraseCommandLine(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-a") == 0 && i + 1 < argc) {
+            target_addr = argv[++i];
+        } else if (strcmp(argv[i], "-P") == 0 && i + 1 < argc) {
+            target_port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            rate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            duration_s = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            domain_count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-U") == 0 && i + 1 < argc) {
+            uid_count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            max_ips = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-z") == 0 && i + 1 < argc) {
+            skew = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            malformed_pct = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            report_pid = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (strcmp(argv[i], "-x") == 0 && i + 1 < argc) {
+            trace_speed = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            sink_path = argv[++i];
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            control_path = argv[++i];
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            drain_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-h") == 0) {
+            PrintHelpInfo();
+            exit(EXIT_SUCCESS);
+        } else {
+            PrintHelpInfo();
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (rate < 0 || duration_s <= 0 || domain_count <= 0 || uid_count <= 0 || max_ips < 1 ||
+        max_ips > LOADGEN_MAX_IPS || skew < 0 || malformed_pct < 0 || malformed_pct > 100 || trace_speed <= 0)
+    {
+        PrintHelpInfo();
+        exit(EXIT_FAILURE);
+    }
+    if (report_pid <= 0)
+    {
+        report_pid = (int)getpid(); // 守护进程能在/proc中查到进程名
+    }
+    if (seed == 0)
+    {
+        seed = 1;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    struct sockaddr_in addr;
+    trace_entry_t *trace = NULL;
+    int trace_count = 0;
+    int trace_timed = 0;
+    double *domain_cdf;
+    double *uid_cdf;
+    daemon_counters_t before;
+    daemon_counters_t after;
+    int have_counters;
+    off_t sink_offset = 0;
+    char message[LOADGEN_MAX_MESSAGE];
+    char tagged[LOADGEN_MAX_MESSAGE + 32];
+    uint64_t sent = 0;
+    uint64_t send_errors = 0;
+    uint64_t start_ns;
+    uint64_t end_ns;
+    uint64_t loop_start_ns;
+    int fd;
+
+    PraseCommandLine(argc, argv);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)target_port);
+    if (inet_pton(AF_INET, target_addr, &addr.sin_addr) != 1)
+    {
+        fprintf(stderr, "Invalid address %s\n", target_addr);
+        return EXIT_FAILURE;
+    }
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+    {
+        perror("socket");
+        return EXIT_FAILURE;
+    }
+    if (trace_path != NULL)
+    {
+        trace = trace_load(trace_path, &trace_count, &trace_timed);
+        if (trace == NULL)
+        {
+            return EXIT_FAILURE;
+        }
+    }
+    domain_cdf = zipf_build(domain_count, skew);
+    uid_cdf = zipf_build(uid_count, skew);
+    if (domain_cdf == NULL || uid_cdf == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    if (sink_path != NULL)
+    {
+        struct stat st;
+        sink_offset = (stat(sink_path, &st) == 0) ? st.st_size : 0;
+    }
+    have_counters = (read_counters(&before) == 0);
+    if (control_path != NULL && !have_counters)
+    {
+        fprintf(stderr, "Cannot query control socket %s, drop counters are not reported\n", control_path);
+    }
+
+    start_ns = now_ns();
+    end_ns = start_ns + (uint64_t)(duration_s * 1e9);
+    loop_start_ns = start_ns;
+    for (uint64_t now = start_ns; now < end_ns; now = now_ns())
+    {
+        uint64_t due;
+        uint64_t next_ns = 0;
+
+        // 先算出到现在为止应发出的条数，一次发完再睡到下一条的时间
+        if (trace != NULL && trace_timed)
+        {
+            due = sent + 1;
+            next_ns = loop_start_ns + (uint64_t)(trace[sent % (uint64_t)trace_count].offset_ns / trace_speed);
+            if (next_ns > now)
+            {
+                sleep_until_ns(next_ns);
+            }
+        }
+        else if (rate > 0)
+        {
+            due = (uint64_t)((double)(now - start_ns) * rate / 1e9) + 1;
+            next_ns = start_ns + (uint64_t)((double)due * 1e9 / rate);
+        }
+        else
+        {
+            due = sent + LOADGEN_BURST;
+        }
+        for (; sent < due; sent++)
+        {
+            const char *payload = message;
+            int len;
+            if (trace != NULL)
+            {
+                snprintf(message, sizeof(message), "%s", trace[sent % (uint64_t)trace_count].message);
+                len = (int)strlen(message);
+                if (trace_timed && sent % (uint64_t)trace_count == (uint64_t)trace_count - 1)
+                {
+                    // 下一轮回放从当前时间重新计时
+                    loop_start_ns = now_ns();
+                }
+            }
+            else
+            {
+                len = build_message(message, sizeof(message), zipf_sample(domain_cdf, domain_count),
+                                    zipf_sample(uid_cdf, uid_count));
+            }
+            if (sink_path != NULL)
+            {
+                len = tag_message(message, tagged, sizeof(tagged), now_ns());
+                payload = tagged;
+            }
+            if (sendto(fd, payload, (size_t)len, 0, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+            {
+                send_errors++;
+            }
+        }
+        if (next_ns > 0 && !(trace != NULL && trace_timed))
+        {
+            sleep_until_ns(next_ns < end_ns ? next_ns : end_ns);
+        }
+    }
+    double seconds = (double)(now_ns() - start_ns) / 1e9;
+    printf("sent: %llu reports in %.2fs (%.0f/s), %llu send errors\n", (unsigned long long)sent, seconds,
+           sent / seconds, (unsigned long long)send_errors);
+
+    usleep((useconds_t)drain_ms * 1000);
+    if (have_counters && read_counters(&after) == 0)
+    {
+        printf("daemon: received %llu, processed %llu, logged %llu\n",
+               (unsigned long long)(after.received - before.received),
+               (unsigned long long)(after.processed - before.processed),
+               (unsigned long long)(after.logged - before.logged));
+        printf("drops: queue full %llu, dispatch queue %llu, kernel %llu, too long %llu, malformed %llu, "
+               "log queue %llu, events %llu, unaccounted %lld\n",
+               (unsigned long long)(after.queue_full - before.queue_full),
+               (unsigned long long)(after.dispatch_dropped - before.dispatch_dropped),
+               (unsigned long long)(after.kernel_dropped - before.kernel_dropped),
+               (unsigned long long)(after.too_long - before.too_long),
+               (unsigned long long)(after.malformed - before.malformed),
+               (unsigned long long)(after.log_dropped - before.log_dropped),
+               (unsigned long long)(after.events_dropped - before.events_dropped),
+               (long long)(sent - send_errors) - (long long)(after.received - before.received) -
+                   (long long)(after.kernel_dropped - before.kernel_dropped));
+    }
+    if (sink_path != NULL)
+    {
+        report_sink(sink_offset, start_ns, seconds);
+    }
+
+    close(fd);
+    free(domain_cdf);
+    free(uid_cdf);
+    for (int i = 0; i < trace_count; i++)
+    {
+        free(trace[i].message);
+    }
+    free(trace);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,150 @@
+/**
+ * @file selog_stub.c
+ * @brief 主机上代替libselog的日志接收端
+ * @note 每条日志追加一行"<单调时钟纳秒> <聚合计数> <日志内容>"到SELOG_CFG_PATH，
+ *       路径是目录时写到其中的selog_stub.log；loadgen据此统计端到端延迟
+ * @version 0.1
+ * @date 2025-09-01
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#include <limits.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "selog.h"
+
+#define SELOG_STUB_FILE_NAME "selog_stub.log" // 路径是目录时使用的文件名
+
+typedef struct selog_stub
+{
+    pthread_mutex_t mutex;
+    char path[PATH_MAX];
+    FILE *file;
+} selog_stub_t;
+
+static selog_stub_t stub = {PTHREAD_MUTEX_INITIALIZER, {0}, NULL};
+
+int _Selog_Conf_SetCommon(selog_handle lhs, int option, ...)
+{
+    va_list ap;
+    (void)lhs;
+    if (option != SELOG_CFG_PATH)
+    {
+        return SELOG_SUCESS; // 其余配置对接收端没有意义
+    }
+    va_start(ap, option);
+    const char *path = va_arg(ap, const char *);
+    va_end(ap);
+    if (path == NULL)
+    {
+        return SELOG_PARAM_ERROR;
+    }
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISDIR(st.st_mode))
+    {
+        snprintf(stub.path, sizeof(stub.path), "%s/%s", path, SELOG_STUB_FILE_NAME);
+    }
+    else
+    {
+        snprintf(stub.path, sizeof(stub.path), "%s", path);
+    }
+    return SELOG_SUCESS;
+}
+
+SELOG_S32 Selog_CreateHandle(selog_handle *lhs, Selog_ModeType runMode, SELOG_S8 *pAppName)
+{
+    (void)runMode;
+    (void)pAppName;
+    if (lhs == NULL)
+    {
+        return SELOG_PARAM_ERROR;
+    }
+    *lhs = &stub;
+    return SELOG_SUCESS;
+}
+
+SELOG_S32 Selog_Init(selog_handle lhs)
+{
+    if (lhs != &stub)
+    {
+        return SELOG_HANDLE_ERROR;
+    }
+    pthread_mutex_lock(&stub.mutex);
+    if (stub.file == NULL && stub.path[0] != '\0')
+    {
+        stub.file = fopen(stub.path, "a");
+    }
+    pthread_mutex_unlock(&stub.mutex);
+    if (stub.file == NULL)
+    {
+        fprintf(stderr, "selog_stub: cannot open %s, records are discarded\n", stub.path);
+    }
+    return SELOG_SUCESS;
+}
+
+SELOG_S32 Selog_Deinit(selog_handle lhs)
+{
+    if (lhs != &stub)
+    {
+        return SELOG_HANDLE_ERROR;
+    }
+    pthread_mutex_lock(&stub.mutex);
+    if (stub.file != NULL)
+    {
+        fclose(stub.file);
+        stub.file = NULL;
+    }
+    pthread_mutex_unlock(&stub.mutex);
+    return SELOG_SUCESS;
+}
+
+SELOG_S32 Selog_Write(selog_handle lhs, Selog_WriteStructType logInfo, SELOG_S8 *logs, SELOG_U32 logLen)
+{
+    struct timespec ts;
+    if (lhs != &stub || logs == NULL)
+    {
+        return (lhs != &stub) ? SELOG_HANDLE_ERROR : SELOG_PARAM_ERROR;
+    }
+    if (logLen > SELOG_SINGLE_LOG_SIZE)
+    {
+        return SELOG_SIZE_OVER;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    pthread_mutex_lock(&stub.mutex);
+    if (stub.file != NULL)
+    {
+        // 每条都刷新，loadgen在守护进程运行时就能读到
+        fprintf(stub.file, "%llu %u %.*s\n", (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec,
+                logInfo.aggregation_count, (int)logLen, logs);
+        fflush(stub.file);
+    }
+    pthread_mutex_unlock(&stub.mutex);
+    return SELOG_SUCESS;
+}
+
+SELOG_S32 Selog_Read(selog_handle lhs, SELOG_S32 logNum, Selog_ReadStructType *logPtr)
+{
+    (void)lhs;
+    (void)logNum;
+    (void)logPtr;
+    return SELOG_READ_NOT_SUPPORT;
+}
+
+SELOG_S32 Selog_AuditlogRead(selog_handle lhs, SELOG_S32 logLen, Selog_AuditlogReadStructType *logPtr)
+{
+    (void)lhs;
+    (void)logLen;
+    (void)logPtr;
+    return SELOG_READ_NOT_SUPPORT;
+}
+
+SELOG_S32 Selog_SetDebugLevel(Selog_DebugLevelType level)
+{
+    (void)level;
+    return SELOG_SUCESS;
+}
@@ -9,8 +9,15 @@
 #include "sys/time.h"
 #include "xdb_searcher.h"
 
+#ifdef XDB_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 // internal function prototype define
-XDB_PRIVATE(int) read(xdb_searcher_t *, long offset, char *, size_t length);
+XDB_PRIVATE(int) xdb_read(xdb_searcher_t *, long offset, char *, size_t length);
 
 XDB_PRIVATE(int) xdb_new_base(xdb_searcher_t *xdb, const char *db_path, const xdb_vector_index_t *v_index, const xdb_content_t *c_buffer) {
     memset(xdb, 0x00, sizeof(xdb_searcher_t));
@@ -47,12 +54,59 @@ XDB_PUBLIC(int) xdb_new_with_buffer(xdb_searcher_t *xdb, const xdb_content_t *c_
     return xdb_new_base(xdb, NULL, NULL, c_buffer);
 }
 
+XDB_PUBLIC(int) xdb_new_with_mmap(xdb_searcher_t *xdb, const char *db_path) {
+#ifdef XDB_LINUX
+    struct stat st;
+    void *addr;
+    int fd;
+
+    memset(xdb, 0x00, sizeof(xdb_searcher_t));
+    fd = open(db_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return 1;
+    }
+
+    if (fstat(fd, &st) != 0 || st.st_size < xdb_header_info_length + xdb_vector_index_length) {
+        close(fd);
+        return 2;
+    }
+
+    // prefault the whole file, the mapping stays valid after the fd is closed
+    addr = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return 3;
+    }
+
+    // binary search jumps around the segment index, readahead only wastes memory
+    madvise(addr, (size_t) st.st_size, MADV_RANDOM);
+
+    xdb->mmap_content.length = (unsigned int) st.st_size;
+    xdb->mmap_content.buffer = (char *) addr;
+    xdb->content = &xdb->mmap_content;
+    return 0;
+#else
+    (void) xdb;
+    (void) db_path;
+    return 1;
+#endif
+}
+
 XDB_PUBLIC(void) xdb_close(void *ptr) {
     xdb_searcher_t *xdb = (xdb_searcher_t *) ptr;
     if (xdb->handle != NULL) {
         fclose(xdb->handle);
         xdb->handle = NULL;
     }
+
+#ifdef XDB_LINUX
+    if (xdb->mmap_content.buffer != NULL) {
+        munmap(xdb->mmap_content.buffer, xdb->mmap_content.length);
+        xdb->mmap_content.buffer = NULL;
+        xdb->mmap_content.length = 0;
+        xdb->content = NULL;
+    }
+#endif
 }
 
 // --- xdb searcher search api define
@@ -71,6 +125,7 @@ XDB_PUBLIC(int) xdb_search(xdb_searcher_t *xdb, unsigned int ip, char *region_bu
     int il0, il1, idx, err, l, h, m, data_len;
     unsigned int s_ptr, e_ptr, p, sip, eip, data_ptr;
     char vector_buffer[xdb_vector_index_size], segment_buffer[xdb_segment_index_size];
+    const char *segment;
 
     // reset the io counter
     xdb->io_count = 0;
@@ -86,7 +141,7 @@ XDB_PUBLIC(int) xdb_search(xdb_searcher_t *xdb, unsigned int ip, char *region_bu
         s_ptr = xdb_get_uint(xdb->content->buffer, xdb_header_info_length + idx);
         e_ptr = xdb_get_uint(xdb->content->buffer, xdb_header_info_length + idx + 4);
     } else {
-        err = read(xdb, xdb_header_info_length + idx, vector_buffer, sizeof(vector_buffer));
+        err = xdb_read(xdb, xdb_header_info_length + idx, vector_buffer, sizeof(vector_buffer));
         if (err != 0) {
             return 10 + err;
         }
@@ -103,23 +158,28 @@ XDB_PUBLIC(int) xdb_search(xdb_searcher_t *xdb, unsigned int ip, char *region_bu
         m = (l + h) >> 1;
         p = s_ptr + m * xdb_segment_index_size;
 
-        // read the segment index item
-        err = read(xdb, p, segment_buffer, sizeof(segment_buffer));
-        if (err != 0) {
-            return 20 + err;
+        // read the segment index item, decode it in place for the content buffer
+        if (xdb->content != NULL) {
+            segment = xdb->content->buffer + p;
+        } else {
+            err = xdb_read(xdb, p, segment_buffer, sizeof(segment_buffer));
+            if (err != 0) {
+                return 20 + err;
+            }
+            segment = segment_buffer;
         }
 
         // decode the data fields as needed
-        sip = xdb_get_uint(segment_buffer, 0);
+        sip = xdb_get_uint(segment, 0);
         if (ip < sip) {
             h = m - 1;
         } else {
-            eip = xdb_get_uint(segment_buffer, 4);
+            eip = xdb_get_uint(segment, 4);
             if (ip > eip) {
                 l = m + 1;
             } else {
-                data_len = xdb_get_ushort(segment_buffer, 8);
-                data_ptr = xdb_get_uint(segment_buffer, 10);
+                data_len = xdb_get_ushort(segment, 8);
+                data_ptr = xdb_get_uint(segment, 10);
                 break;
             }
         }
@@ -136,7 +196,7 @@ XDB_PUBLIC(int) xdb_search(xdb_searcher_t *xdb, unsigned int ip, char *region_bu
         return 1;
     }
 
-    err = read(xdb, data_ptr, region_buffer, data_len);
+    err = xdb_read(xdb, data_ptr, region_buffer, data_len);
     if (err != 0) {
         return 30 + err;
     }
@@ -146,7 +206,7 @@ XDB_PUBLIC(int) xdb_search(xdb_searcher_t *xdb, unsigned int ip, char *region_bu
     return 0;
 }
 
-XDB_PRIVATE(int) read(xdb_searcher_t *xdb, long offset, char *buffer, size_t length) {
+XDB_PRIVATE(int) xdb_read(xdb_searcher_t *xdb, long offset, char *buffer, size_t length) {
     // check the xdb content cache first
     if (xdb->content != NULL) {
         memcpy(buffer, xdb->content->buffer + offset, length);
@@ -107,6 +107,10 @@ struct xdb_searcher_entry {
     // content buffer.
     // cache the whole xdb content.
     const xdb_content_t *content;
+
+    // read-only mapping of the whole xdb file owned by this searcher,
+    // content points to it when created with xdb_new_with_mmap.
+    xdb_content_t mmap_content;
 };
 typedef struct xdb_searcher_entry xdb_searcher_t;
 
@@ -117,6 +121,10 @@ XDB_PUBLIC(int) xdb_new_with_vector_index(xdb_searcher_t *, const char *, const
 
 XDB_PUBLIC(int) xdb_new_with_buffer(xdb_searcher_t *, const xdb_content_t *);
 
+// map the whole xdb file read-only so the search runs on plain memory reads
+// with no syscall, the pages are shared through the page cache.
+XDB_PUBLIC(int) xdb_new_with_mmap(xdb_searcher_t *, const char *);
+
 XDB_PUBLIC(void) xdb_close(void *);
 
 // xdb searcher search api define